@@ -116,6 +116,30 @@ static struct wlr_backend *attempt_headless_backend(
 		wlr_headless_add_output(backend, 1280, 720);
 	}
 
+	const char *clock = getenv("WLR_HEADLESS_CLOCK");
+	if (clock != NULL && strcmp(clock, "fast-forward") == 0) {
+		wlr_headless_backend_set_clock_mode(backend,
+			WLR_HEADLESS_CLOCK_FAST_FORWARD, NULL);
+	} else if (clock != NULL && strcmp(clock, "realtime") != 0) {
+		wlr_log(L_ERROR, "Unknown WLR_HEADLESS_CLOCK value: %s", clock);
+	}
+
+	const char *replay_path = getenv("WLR_HEADLESS_REPLAY_INPUT");
+	if (replay_path != NULL) {
+		double speed = 1;
+		const char *speed_str = getenv("WLR_HEADLESS_REPLAY_SPEED");
+		if (speed_str != NULL) {
+			char *end;
+			speed = strtod(speed_str, &end);
+			if (*end || !(speed > 0)) {
+				wlr_log(L_ERROR, "WLR_HEADLESS_REPLAY_SPEED specified with "
+					"invalid number, ignoring");
+				speed = 1;
+			}
+		}
+		wlr_headless_backend_replay_input(backend, replay_path, speed);
+	}
+
 	return backend;
 }
 
@@ -1,5 +1,10 @@
-#include "util/signal.h"
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
 #include <wlr/interfaces/wlr_input_device.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/egl.h>
@@ -7,6 +12,8 @@
 #include <wlr/util/log.h>
 #include "backend/headless.h"
 #include "glapi.h"
+#include "util/signal.h"
+#include "util/time.h"
 
 static bool backend_start(struct wlr_backend *wlr_backend) {
 	struct wlr_headless_backend *backend =
@@ -15,7 +22,8 @@ static bool backend_start(struct wlr_backend *wlr_backend) {
 
 	struct wlr_headless_output *output;
 	wl_list_for_each(output, &backend->outputs, link) {
-		wl_event_source_timer_update(output->frame_timer, output->frame_delay);
+		reset_headless_vblank(output);
+		schedule_headless_vblank(output);
 		wlr_output_update_enabled(&output->wlr_output, true);
 		wlr_signal_emit_safe(&backend->backend.events.new_output,
 			&output->wlr_output);
@@ -29,6 +37,8 @@ static bool backend_start(struct wlr_backend *wlr_backend) {
 	}
 
 	backend->started = true;
+	start_headless_replay(backend);
+	wake_headless_clock(backend);
 	return true;
 }
 
@@ -41,6 +51,8 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 
 	wl_list_remove(&backend->display_destroy.link);
 
+	destroy_headless_replay(backend);
+
 	struct wlr_headless_output *output, *output_tmp;
 	wl_list_for_each_safe(output, output_tmp, &backend->outputs, link) {
 		wlr_output_destroy(&output->wlr_output);
@@ -54,6 +66,13 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 
 	wlr_signal_emit_safe(&wlr_backend->events.destroy, backend);
 
+	if (backend->clock_source != NULL) {
+		wl_event_source_remove(backend->clock_source);
+	}
+	if (backend->clock_fd >= 0) {
+		close(backend->clock_fd);
+	}
+
 	wlr_renderer_destroy(backend->renderer);
 	wlr_egl_finish(&backend->egl);
 	free(backend);
@@ -90,6 +109,7 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_display *display,
 	}
 	wlr_backend_init(&backend->backend, &backend_impl);
 	backend->display = display;
+	backend->clock_fd = -1;
 	wl_list_init(&backend->outputs);
 	wl_list_init(&backend->input_devices);
 
@@ -125,3 +145,142 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_display *display,
 bool wlr_backend_is_headless(struct wlr_backend *backend) {
 	return backend->impl == &backend_impl;
 }
+
+void wlr_headless_backend_get_time(struct wlr_backend *wlr_backend,
+		struct timespec *now) {
+	assert(wlr_backend_is_headless(wlr_backend));
+	struct wlr_headless_backend *backend =
+		(struct wlr_headless_backend *)wlr_backend;
+	if (backend->clock_mode == WLR_HEADLESS_CLOCK_REALTIME) {
+		clock_gettime(CLOCK_MONOTONIC, now);
+	} else {
+		*now = backend->virtual_time;
+	}
+}
+
+/**
+ * Moves the virtual clock to the earliest upcoming vblank and emits a frame
+ * event for the output it belongs to. Returns false if there is no output to
+ * drive.
+ */
+static bool backend_advance_clock(struct wlr_headless_backend *backend) {
+	struct wlr_headless_output *next = NULL;
+	struct timespec next_vblank;
+	struct wlr_headless_output *output;
+	wl_list_for_each(output, &backend->outputs, link) {
+		if (!output->wlr_output.enabled) {
+			continue;
+		}
+		struct timespec vblank;
+		get_headless_next_vblank(output, &vblank);
+		if (next == NULL ||
+				timespec_to_nsec(&vblank) < timespec_to_nsec(&next_vblank)) {
+			next = output;
+			next_vblank = vblank;
+		}
+	}
+	if (next == NULL) {
+		return false;
+	}
+
+	backend->virtual_time = next_vblank;
+	// Input due before this vblank is handled before the frame is rendered
+	update_headless_replay(backend);
+	next->vblank_seq++;
+	wlr_output_send_frame(&next->wlr_output);
+	return true;
+}
+
+void wlr_headless_backend_step(struct wlr_backend *wlr_backend,
+		unsigned int frames) {
+	assert(wlr_backend_is_headless(wlr_backend));
+	struct wlr_headless_backend *backend =
+		(struct wlr_headless_backend *)wlr_backend;
+	assert(backend->clock_mode != WLR_HEADLESS_CLOCK_REALTIME);
+	if (!backend->started) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < frames; ++i) {
+		if (!backend_advance_clock(backend)) {
+			break;
+		}
+	}
+}
+
+static int handle_clock_event(int fd, uint32_t mask, void *data) {
+	struct wlr_headless_backend *backend = data;
+
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) < 0) {
+		wlr_log_errno(L_ERROR, "Failed to read from headless clock eventfd");
+		return 0;
+	}
+
+	// Only advance by one vblank per event loop iteration, so that clients
+	// get a chance to commit before the next frame
+	if (backend->clock_mode == WLR_HEADLESS_CLOCK_FAST_FORWARD &&
+			backend->started && backend_advance_clock(backend)) {
+		wake_headless_clock(backend);
+	}
+	return 0;
+}
+
+void wake_headless_clock(struct wlr_headless_backend *backend) {
+	if (backend->clock_mode != WLR_HEADLESS_CLOCK_FAST_FORWARD ||
+			backend->clock_fd < 0) {
+		return;
+	}
+
+	uint64_t one = 1;
+	if (write(backend->clock_fd, &one, sizeof(one)) < 0) {
+		wlr_log_errno(L_ERROR, "Failed to write to headless clock eventfd");
+	}
+}
+
+bool wlr_headless_backend_set_clock_mode(struct wlr_backend *wlr_backend,
+		enum wlr_headless_clock_mode mode, const struct timespec *start) {
+	assert(wlr_backend_is_headless(wlr_backend));
+	struct wlr_headless_backend *backend =
+		(struct wlr_headless_backend *)wlr_backend;
+
+	if (mode == WLR_HEADLESS_CLOCK_FAST_FORWARD && backend->clock_fd < 0) {
+		backend->clock_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (backend->clock_fd < 0) {
+			wlr_log_errno(L_ERROR, "Failed to create headless clock eventfd");
+			return false;
+		}
+
+		struct wl_event_loop *ev = wl_display_get_event_loop(backend->display);
+		backend->clock_source = wl_event_loop_add_fd(ev, backend->clock_fd,
+			WL_EVENT_READABLE, handle_clock_event, backend);
+		if (backend->clock_source == NULL) {
+			wlr_log(L_ERROR, "Failed to add headless clock event source");
+			close(backend->clock_fd);
+			backend->clock_fd = -1;
+			return false;
+		}
+	}
+
+	if (mode != WLR_HEADLESS_CLOCK_REALTIME) {
+		if (start != NULL) {
+			backend->virtual_time = *start;
+		} else {
+			backend->virtual_time = (struct timespec){ 0 };
+		}
+	}
+	backend->clock_mode = mode;
+
+	struct wlr_headless_output *output;
+	wl_list_for_each(output, &backend->outputs, link) {
+		reset_headless_vblank(output);
+		if (backend->started) {
+			schedule_headless_vblank(output);
+		}
+	}
+
+	if (backend->started) {
+		wake_headless_clock(backend);
+	}
+	return true;
+}
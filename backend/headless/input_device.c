@@ -15,11 +15,9 @@ bool wlr_input_device_is_headless(struct wlr_input_device *wlr_dev) {
 	return wlr_dev->impl == &input_device_impl;
 }
 
-struct wlr_input_device *wlr_headless_add_input_device(
-		struct wlr_backend *wlr_backend, enum wlr_input_device_type type) {
-	struct wlr_headless_backend *backend =
-		(struct wlr_headless_backend *)wlr_backend;
-
+struct wlr_input_device *headless_add_input_device(
+		struct wlr_headless_backend *backend, enum wlr_input_device_type type,
+		const char *name) {
 	struct wlr_headless_input_device *device =
 		calloc(1, sizeof(struct wlr_headless_input_device));
 	if (device == NULL) {
@@ -29,7 +27,6 @@ struct wlr_input_device *wlr_headless_add_input_device(
 
 	int vendor = 0;
 	int product = 0;
-	const char *name = "headless";
 	struct wlr_input_device *wlr_device = &device->wlr_input_device;
 	wlr_input_device_init(wlr_device, type, &input_device_impl, name, vendor,
 		product);
@@ -88,3 +85,10 @@ error:
 	free(device);
 	return NULL;
 }
+
+struct wlr_input_device *wlr_headless_add_input_device(
+		struct wlr_backend *wlr_backend, enum wlr_input_device_type type) {
+	struct wlr_headless_backend *backend =
+		(struct wlr_headless_backend *)wlr_backend;
+	return headless_add_input_device(backend, type, "headless");
+}
@@ -0,0 +1,557 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/interfaces/wlr_input_device.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/util/log.h>
+#include "backend/headless.h"
+#include "types/wlr_input_recorder.h"
+#include "util/signal.h"
+#include "util/time.h"
+
+struct wlr_headless_replay {
+	struct wlr_headless_backend *backend;
+	double speed;
+
+	uint8_t *data;
+	size_t size, pos; // pos is the offset of the next record
+	int64_t next_nsec; // recording time of the next record
+
+	bool started;
+	int64_t start_nsec; // clock time at which the replay started
+
+	// indexed by recorded device ID, NULL once removed
+	struct wlr_input_device **devices;
+	size_t devices_len;
+
+	struct wl_event_source *timer; // only used with the realtime clock
+};
+
+static int64_t backend_now_nsec(struct wlr_headless_backend *backend) {
+	struct timespec now;
+	wlr_headless_backend_get_time(&backend->backend, &now);
+	return timespec_to_nsec(&now);
+}
+
+static bool record_is_valid(const struct input_record_header *header) {
+	return header->type > 0 && header->type < INPUT_RECORD_TYPE_COUNT;
+}
+
+/**
+ * Checks that the recording is well-formed, so that records can be emitted
+ * without further bound checks.
+ */
+static bool validate_recording(const uint8_t *data, size_t size) {
+	size_t magic_len = strlen(INPUT_RECORDING_MAGIC);
+	uint32_t version;
+	if (size < magic_len + sizeof(version) ||
+			memcmp(data, INPUT_RECORDING_MAGIC, magic_len) != 0) {
+		wlr_log(L_ERROR, "Not an input recording");
+		return false;
+	}
+	memcpy(&version, data + magic_len, sizeof(version));
+	if (version != INPUT_RECORDING_VERSION) {
+		wlr_log(L_ERROR, "Unsupported input recording version %u", version);
+		return false;
+	}
+
+	size_t pos = magic_len + sizeof(version);
+	while (pos < size) {
+		struct input_record_header header;
+		if (size - pos < sizeof(header)) {
+			goto truncated;
+		}
+		memcpy(&header, data + pos, sizeof(header));
+		pos += sizeof(header);
+		if (!record_is_valid(&header)) {
+			wlr_log(L_ERROR, "Invalid input record type %u", header.type);
+			return false;
+		}
+
+		size_t payload_size = input_record_payload_size(header.type);
+		if (size - pos < payload_size) {
+			goto truncated;
+		}
+		if (header.type == INPUT_RECORD_DEVICE_ADDED) {
+			struct input_record_device_added added;
+			memcpy(&added, data + pos, sizeof(added));
+			if (size - pos - payload_size < added.name_len) {
+				goto truncated;
+			}
+			payload_size += added.name_len;
+		}
+		pos += payload_size;
+	}
+	return true;
+
+truncated:
+	wlr_log(L_ERROR, "Input recording is truncated");
+	return false;
+}
+
+static size_t first_record_offset(void) {
+	return strlen(INPUT_RECORDING_MAGIC) + sizeof(uint32_t);
+}
+
+static void replay_add_device(struct wlr_headless_replay *replay,
+		uint16_t id, const uint8_t *payload) {
+	struct input_record_device_added added;
+	memcpy(&added, payload, sizeof(added));
+	if (added.type > WLR_INPUT_DEVICE_TABLET_PAD) {
+		wlr_log(L_ERROR, "Invalid replayed device type %u", added.type);
+		return;
+	}
+
+	if (id >= replay->devices_len) {
+		size_t len = (size_t)id + 1;
+		struct wlr_input_device **devices =
+			realloc(replay->devices, len * sizeof(*devices));
+		if (devices == NULL) {
+			wlr_log(L_ERROR, "Allocation failed");
+			return;
+		}
+		memset(devices + replay->devices_len, 0,
+			(len - replay->devices_len) * sizeof(*devices));
+		replay->devices = devices;
+		replay->devices_len = len;
+	}
+	if (replay->devices[id] != NULL) {
+		wlr_log(L_ERROR, "Replayed device %u added twice", id);
+		return;
+	}
+
+	char *name = strndup((const char *)payload + sizeof(added),
+		added.name_len);
+	if (name == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return;
+	}
+	replay->devices[id] =
+		headless_add_input_device(replay->backend, added.type, name);
+	free(name);
+}
+
+static void replay_remove_device(struct wlr_headless_replay *replay,
+		uint16_t id) {
+	if (id >= replay->devices_len || replay->devices[id] == NULL) {
+		return;
+	}
+	struct wlr_input_device *device = replay->devices[id];
+	replay->devices[id] = NULL;
+	wl_list_remove(&device->link);
+	wlr_input_device_destroy(device);
+}
+
+static struct wlr_input_device *replay_get_device(
+		struct wlr_headless_replay *replay, uint16_t id,
+		enum wlr_input_device_type type) {
+	if (id >= replay->devices_len || replay->devices[id] == NULL ||
+			replay->devices[id]->type != type) {
+		return NULL;
+	}
+	return replay->devices[id];
+}
+
+static void replay_emit(struct wlr_headless_replay *replay,
+		const struct input_record_header *header, const uint8_t *payload,
+		uint32_t time_msec) {
+	struct wlr_input_device *dev;
+	switch ((enum input_record_type)header->type) {
+	case INPUT_RECORD_DEVICE_ADDED:
+		replay_add_device(replay, header->device, payload);
+		break;
+	case INPUT_RECORD_DEVICE_REMOVED:
+		replay_remove_device(replay, header->device);
+		break;
+	case INPUT_RECORD_POINTER_MOTION:;
+		struct input_record_pointer_motion motion;
+		memcpy(&motion, payload, sizeof(motion));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_POINTER);
+		if (dev != NULL) {
+			struct wlr_event_pointer_motion event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.delta_x = motion.delta_x,
+				.delta_y = motion.delta_y,
+			};
+			wlr_signal_emit_safe(&dev->pointer->events.motion, &event);
+		}
+		break;
+	case INPUT_RECORD_POINTER_MOTION_ABSOLUTE:;
+		struct input_record_pointer_motion_absolute absolute;
+		memcpy(&absolute, payload, sizeof(absolute));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_POINTER);
+		if (dev != NULL) {
+			struct wlr_event_pointer_motion_absolute event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.x = absolute.x,
+				.y = absolute.y,
+			};
+			wlr_signal_emit_safe(&dev->pointer->events.motion_absolute,
+				&event);
+		}
+		break;
+	case INPUT_RECORD_POINTER_BUTTON:;
+		struct input_record_button button;
+		memcpy(&button, payload, sizeof(button));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_POINTER);
+		if (dev != NULL) {
+			struct wlr_event_pointer_button event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.button = button.button,
+				.state = button.state,
+			};
+			wlr_signal_emit_safe(&dev->pointer->events.button, &event);
+		}
+		break;
+	case INPUT_RECORD_POINTER_AXIS:;
+		struct input_record_pointer_axis axis;
+		memcpy(&axis, payload, sizeof(axis));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_POINTER);
+		if (dev != NULL) {
+			struct wlr_event_pointer_axis event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.source = axis.source,
+				.orientation = axis.orientation,
+				.delta = axis.delta,
+				.delta_discrete = axis.delta_discrete,
+			};
+			wlr_signal_emit_safe(&dev->pointer->events.axis, &event);
+		}
+		break;
+	case INPUT_RECORD_KEYBOARD_KEY:;
+		struct input_record_keyboard_key key;
+		memcpy(&key, payload, sizeof(key));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_KEYBOARD);
+		if (dev != NULL) {
+			struct wlr_event_keyboard_key event = {
+				.time_msec = time_msec,
+				.keycode = key.keycode,
+				.update_state = key.update_state,
+				.state = key.state,
+			};
+			wlr_keyboard_notify_key(dev->keyboard, &event);
+		}
+		break;
+	case INPUT_RECORD_TOUCH_DOWN:
+	case INPUT_RECORD_TOUCH_MOTION:;
+		struct input_record_touch touch;
+		memcpy(&touch, payload, sizeof(touch));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_TOUCH);
+		if (dev == NULL) {
+			break;
+		}
+		if (header->type == INPUT_RECORD_TOUCH_DOWN) {
+			struct wlr_event_touch_down event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.touch_id = touch.touch_id,
+				.x = touch.x,
+				.y = touch.y,
+			};
+			wlr_signal_emit_safe(&dev->touch->events.down, &event);
+		} else {
+			struct wlr_event_touch_motion event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.touch_id = touch.touch_id,
+				.x = touch.x,
+				.y = touch.y,
+			};
+			wlr_signal_emit_safe(&dev->touch->events.motion, &event);
+		}
+		break;
+	case INPUT_RECORD_TOUCH_UP:
+	case INPUT_RECORD_TOUCH_CANCEL:
+		memcpy(&touch, payload, sizeof(touch));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_TOUCH);
+		if (dev == NULL) {
+			break;
+		}
+		if (header->type == INPUT_RECORD_TOUCH_UP) {
+			struct wlr_event_touch_up event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.touch_id = touch.touch_id,
+			};
+			wlr_signal_emit_safe(&dev->touch->events.up, &event);
+		} else {
+			struct wlr_event_touch_cancel event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.touch_id = touch.touch_id,
+			};
+			wlr_signal_emit_safe(&dev->touch->events.cancel, &event);
+		}
+		break;
+	case INPUT_RECORD_TABLET_TOOL_AXIS:;
+		struct input_record_tablet_tool_axis tool_axis;
+		memcpy(&tool_axis, payload, sizeof(tool_axis));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_TABLET_TOOL);
+		if (dev != NULL) {
+			struct wlr_event_tablet_tool_axis event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.updated_axes = tool_axis.updated_axes,
+				.x = tool_axis.x,
+				.y = tool_axis.y,
+				.pressure = tool_axis.pressure,
+				.distance = tool_axis.distance,
+				.tilt_x = tool_axis.tilt_x,
+				.tilt_y = tool_axis.tilt_y,
+				.rotation = tool_axis.rotation,
+				.slider = tool_axis.slider,
+				.wheel_delta = tool_axis.wheel_delta,
+			};
+			wlr_signal_emit_safe(&dev->tablet_tool->events.axis, &event);
+		}
+		break;
+	case INPUT_RECORD_TABLET_TOOL_PROXIMITY:
+	case INPUT_RECORD_TABLET_TOOL_TIP:;
+		struct input_record_tablet_tool_state tool_state;
+		memcpy(&tool_state, payload, sizeof(tool_state));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_TABLET_TOOL);
+		if (dev == NULL) {
+			break;
+		}
+		if (header->type == INPUT_RECORD_TABLET_TOOL_PROXIMITY) {
+			struct wlr_event_tablet_tool_proximity event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.x = tool_state.x,
+				.y = tool_state.y,
+				.state = tool_state.state,
+			};
+			wlr_signal_emit_safe(&dev->tablet_tool->events.proximity, &event);
+		} else {
+			struct wlr_event_tablet_tool_tip event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.x = tool_state.x,
+				.y = tool_state.y,
+				.state = tool_state.state,
+			};
+			wlr_signal_emit_safe(&dev->tablet_tool->events.tip, &event);
+		}
+		break;
+	case INPUT_RECORD_TABLET_TOOL_BUTTON:
+		memcpy(&button, payload, sizeof(button));
+		dev = replay_get_device(replay, header->device,
+			WLR_INPUT_DEVICE_TABLET_TOOL);
+		if (dev != NULL) {
+			struct wlr_event_tablet_tool_button event = {
+				.device = dev,
+				.time_msec = time_msec,
+				.button = button.button,
+				.state = button.state,
+			};
+			wlr_signal_emit_safe(&dev->tablet_tool->events.button, &event);
+		}
+		break;
+	case INPUT_RECORD_TYPE_COUNT:
+		break;
+	}
+}
+
+static bool replay_peek(struct wlr_headless_replay *replay,
+		struct input_record_header *header) {
+	if (replay->pos >= replay->size) {
+		return false;
+	}
+	memcpy(header, replay->data + replay->pos, sizeof(*header));
+	return true;
+}
+
+static int64_t replay_due_nsec(struct wlr_headless_replay *replay,
+		const struct input_record_header *header) {
+	int64_t record_nsec = replay->next_nsec + (int64_t)header->delta_usec * 1000;
+	return replay->start_nsec + (int64_t)(record_nsec / replay->speed);
+}
+
+void update_headless_replay(struct wlr_headless_backend *backend) {
+	struct wlr_headless_replay *replay = backend->replay;
+	if (replay == NULL || !replay->started) {
+		return;
+	}
+
+	int64_t now_nsec = backend_now_nsec(backend);
+	uint32_t time_msec = now_nsec / 1000000;
+	uint64_t serial = backend->replay_serial;
+	struct input_record_header header;
+	while (replay_peek(replay, &header)) {
+		int64_t due_nsec = replay_due_nsec(replay, &header);
+		if (due_nsec > now_nsec) {
+			if (replay->timer != NULL) {
+				int64_t delay_ms = (due_nsec - now_nsec + 999999) / 1000000;
+				wl_event_source_timer_update(replay->timer, delay_ms);
+			}
+			return;
+		}
+
+		const uint8_t *payload = replay->data + replay->pos + sizeof(header);
+		replay->pos += sizeof(header) + input_record_payload_size(header.type);
+		if (header.type == INPUT_RECORD_DEVICE_ADDED) {
+			struct input_record_device_added added;
+			memcpy(&added, payload, sizeof(added));
+			replay->pos += added.name_len;
+		}
+		replay->next_nsec += (int64_t)header.delta_usec * 1000;
+
+		replay_emit(replay, &header, payload, time_msec);
+		if (backend->replay_serial != serial) {
+			// Listeners stopped or replaced the replay, which freed it
+			return;
+		}
+	}
+
+	wlr_log(L_INFO, "Input replay finished after %.3f s",
+		(now_nsec - replay->start_nsec) / 1e9);
+	destroy_headless_replay(backend);
+}
+
+static int handle_replay_timer(void *data) {
+	struct wlr_headless_backend *backend = data;
+	update_headless_replay(backend);
+	return 0;
+}
+
+void start_headless_replay(struct wlr_headless_backend *backend) {
+	struct wlr_headless_replay *replay = backend->replay;
+	if (replay == NULL || replay->started) {
+		return;
+	}
+
+	if (backend->clock_mode == WLR_HEADLESS_CLOCK_REALTIME) {
+		struct wl_event_loop *ev = wl_display_get_event_loop(backend->display);
+		replay->timer = wl_event_loop_add_timer(ev, handle_replay_timer,
+			backend);
+		if (replay->timer == NULL) {
+			wlr_log(L_ERROR, "Failed to create input replay timer");
+			destroy_headless_replay(backend);
+			return;
+		}
+	}
+
+	replay->started = true;
+	replay->start_nsec = backend_now_nsec(backend);
+	update_headless_replay(backend);
+}
+
+void destroy_headless_replay(struct wlr_headless_backend *backend) {
+	struct wlr_headless_replay *replay = backend->replay;
+	if (replay == NULL) {
+		return;
+	}
+	backend->replay = NULL;
+	backend->replay_serial++;
+	if (replay->timer != NULL) {
+		wl_event_source_remove(replay->timer);
+	}
+	for (size_t i = 0; i < replay->devices_len; ++i) {
+		replay_remove_device(replay, i);
+	}
+	free(replay->devices);
+	free(replay->data);
+	free(replay);
+}
+
+static uint8_t *read_file(const char *path, size_t *size) {
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		wlr_log_errno(L_ERROR, "Failed to open input recording '%s'", path);
+		return NULL;
+	}
+
+	uint8_t *data = NULL;
+	size_t len = 0, cap = 0;
+	while (true) {
+		if (len == cap) {
+			cap = cap > 0 ? 2 * cap : 64 * 1024;
+			uint8_t *new_data = realloc(data, cap);
+			if (new_data == NULL) {
+				wlr_log(L_ERROR, "Allocation failed");
+				goto error;
+			}
+			data = new_data;
+		}
+		size_t n = fread(data + len, 1, cap - len, f);
+		len += n;
+		if (n == 0) {
+			break;
+		}
+	}
+	if (ferror(f)) {
+		wlr_log(L_ERROR, "Failed to read input recording '%s'", path);
+		goto error;
+	}
+
+	fclose(f);
+	*size = len;
+	return data;
+
+error:
+	free(data);
+	fclose(f);
+	return NULL;
+}
+
+bool wlr_headless_backend_replay_input(struct wlr_backend *wlr_backend,
+		const char *path, double speed) {
+	assert(wlr_backend_is_headless(wlr_backend));
+	assert(speed > 0);
+	struct wlr_headless_backend *backend =
+		(struct wlr_headless_backend *)wlr_backend;
+
+	size_t size;
+	uint8_t *data = read_file(path, &size);
+	if (data == NULL) {
+		return false;
+	}
+	if (!validate_recording(data, size)) {
+		free(data);
+		return false;
+	}
+
+	struct wlr_headless_replay *replay =
+		calloc(1, sizeof(struct wlr_headless_replay));
+	if (replay == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		free(data);
+		return false;
+	}
+	replay->backend = backend;
+	replay->speed = speed;
+	replay->data = data;
+	replay->size = size;
+	replay->pos = first_record_offset();
+
+	destroy_headless_replay(backend);
+	backend->replay = replay;
+	wlr_log(L_INFO, "Replaying input from '%s' at %.2fx speed", path, speed);
+
+	if (backend->started) {
+		start_headless_replay(backend);
+	}
+	return true;
+}
+
+bool wlr_headless_backend_is_replaying(struct wlr_backend *wlr_backend) {
+	assert(wlr_backend_is_headless(wlr_backend));
+	struct wlr_headless_backend *backend =
+		(struct wlr_headless_backend *)wlr_backend;
+	return backend->replay != NULL;
+}
@@ -1,11 +1,21 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_matrix.h>
 #include <wlr/util/log.h>
 #include "backend/headless.h"
 #include "util/signal.h"
+#include "util/time.h"
 
 static EGLSurface egl_create_surface(struct wlr_egl *egl, unsigned int width,
 		unsigned int height) {
@@ -19,6 +29,116 @@ static EGLSurface egl_create_surface(struct wlr_egl *egl, unsigned int width,
 	return surf;
 }
 
+/**
+ * Returns the time elapsed between vblank 0 and vblank `seq`, in nanoseconds.
+ * Computed from the sequence number rather than accumulated, so that
+ * timestamps don't drift.
+ */
+static int64_t vblank_offset(int32_t refresh, uint64_t seq) {
+	// refresh is in mHz, so a period is nsec_mhz / refresh nanoseconds
+	const int64_t nsec_mhz = 1000000000000;
+	uint64_t q = seq / refresh, r = seq % refresh;
+	return q * nsec_mhz + r * nsec_mhz / refresh;
+}
+
+void get_headless_next_vblank(struct wlr_headless_output *output,
+		struct timespec *when) {
+	int64_t nsec = timespec_to_nsec(&output->vblank_base) +
+		vblank_offset(output->wlr_output.refresh, output->vblank_seq);
+	timespec_from_nsec(when, nsec);
+}
+
+void reset_headless_vblank(struct wlr_headless_output *output) {
+	wlr_headless_backend_get_time(&output->backend->backend,
+		&output->vblank_base);
+	output->vblank_seq = 1;
+}
+
+void schedule_headless_vblank(struct wlr_headless_output *output) {
+	if (output->backend->clock_mode != WLR_HEADLESS_CLOCK_REALTIME) {
+		// Disarm the timer, the virtual clock drives frames
+		wl_event_source_timer_update(output->frame_timer, 0);
+		return;
+	}
+
+	struct timespec now, next;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	get_headless_next_vblank(output, &next);
+	int64_t delay = timespec_to_nsec(&next) - timespec_to_nsec(&now);
+	if (delay < 0) {
+		// We missed some vblanks, skip them
+		int64_t period = vblank_offset(output->wlr_output.refresh, 1);
+		output->vblank_seq += -delay / period + 1;
+		get_headless_next_vblank(output, &next);
+		delay = timespec_to_nsec(&next) - timespec_to_nsec(&now);
+	}
+
+	// The timer has a millisecond granularity, round up and never pass zero
+	// since it would disarm the timer
+	int delay_ms = (delay + 999999) / 1000000;
+	if (delay_ms < 1) {
+		delay_ms = 1;
+	}
+	wl_event_source_timer_update(output->frame_timer, delay_ms);
+}
+
+static int signal_frame(void *data) {
+	struct wlr_headless_output *output = data;
+	output->vblank_seq++;
+	wlr_output_send_frame(&output->wlr_output);
+	schedule_headless_vblank(output);
+	return 0;
+}
+
+static void output_destroy_buffers(struct wlr_headless_output *output) {
+	for (size_t i = 0; i < WLR_HEADLESS_MAX_BUFFERS; ++i) {
+		struct wlr_headless_buffer *buffer = &output->buffers[i];
+		if (buffer->fbo != 0) {
+			glDeleteFramebuffers(1, &buffer->fbo);
+		}
+		if (buffer->tex != 0) {
+			glDeleteTextures(1, &buffer->tex);
+		}
+	}
+	memset(output->buffers, 0, sizeof(output->buffers));
+	output->back = output->front = 0;
+	output->seq = 0;
+}
+
+/**
+ * Creates `n_buffers` framebuffers of the given size. The EGL context must be
+ * current.
+ */
+static bool output_create_buffers(struct wlr_headless_output *output,
+		int32_t width, int32_t height) {
+	output_destroy_buffers(output);
+
+	for (size_t i = 0; i < output->n_buffers; ++i) {
+		struct wlr_headless_buffer *buffer = &output->buffers[i];
+
+		glGenTextures(1, &buffer->tex);
+		glBindTexture(GL_TEXTURE_2D, buffer->tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+			GL_UNSIGNED_BYTE, NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &buffer->fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, buffer->fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, buffer->tex, 0);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			wlr_log(L_ERROR, "Failed to create framebuffer (status 0x%x)",
+				status);
+			output_destroy_buffers(output);
+			return false;
+		}
+	}
+	return true;
+}
+
 static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
 		int32_t height, int32_t refresh) {
 	struct wlr_headless_output *output =
@@ -29,18 +149,22 @@ static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
 		refresh = HEADLESS_DEFAULT_REFRESH;
 	}
 
-	wlr_egl_destroy_surface(&backend->egl, output->egl_surface);
+	if (!wlr_egl_make_current(&backend->egl, output->egl_surface, NULL)) {
+		return false;
+	}
 
-	output->egl_surface = egl_create_surface(&backend->egl, width, height);
-	if (output->egl_surface == EGL_NO_SURFACE) {
-		wlr_log(L_ERROR, "Failed to recreate EGL surface");
+	if (!output_create_buffers(output, width, height)) {
+		wlr_log(L_ERROR, "Failed to recreate headless swapchain");
 		wlr_output_destroy(wlr_output);
 		return false;
 	}
 
-	output->frame_delay = 1000000 / refresh;
-
 	wlr_output_update_custom_mode(&output->wlr_output, width, height, refresh);
+
+	reset_headless_vblank(output);
+	if (backend->started) {
+		schedule_headless_vblank(output);
+	}
 	return true;
 }
 
@@ -51,26 +175,117 @@ static void output_transform(struct wlr_output *wlr_output,
 	output->wlr_output.transform = transform;
 }
 
+/**
+ * Framebuffer of the render thread calling, see wlr_output_render_thread.
+ * Framebuffers aren't shared between EGL contexts, unlike the textures they
+ * draw to. A render thread keeps its context until it exits.
+ */
+static _Thread_local GLuint thread_fbo;
+
+static bool bind_thread_framebuffer(struct wlr_headless_buffer *buffer) {
+	if (thread_fbo == 0) {
+		glGenFramebuffers(1, &thread_fbo);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, thread_fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+		buffer->tex, 0);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		wlr_log(L_ERROR, "Failed to bind framebuffer (status 0x%x)", status);
+		return false;
+	}
+	return true;
+}
+
 static bool output_make_current(struct wlr_output *wlr_output, int *buffer_age) {
 	struct wlr_headless_output *output =
 		(struct wlr_headless_output *)wlr_output;
-	return wlr_egl_make_current(&output->backend->egl, output->egl_surface,
-		buffer_age);
+	if (!wlr_egl_make_current(&output->backend->egl, output->egl_surface,
+			NULL)) {
+		return false;
+	}
+
+	struct wlr_headless_buffer *back = &output->buffers[output->back];
+	if (eglGetCurrentContext() == output->backend->egl.context) {
+		glBindFramebuffer(GL_FRAMEBUFFER, back->fbo);
+	} else if (!bind_thread_framebuffer(back)) {
+		return false;
+	}
+
+	if (buffer_age != NULL) {
+		// Same semantics as EGL_EXT_buffer_age: 0 means undefined contents,
+		// 1 means the buffer holds the last presented frame, and so on
+		*buffer_age = back->seq == 0 ? 0 : (int)(output->seq - back->seq + 1);
+	}
+	return true;
+}
+
+static void output_update_present_time(struct wlr_headless_output *output) {
+	if (output->backend->clock_mode == WLR_HEADLESS_CLOCK_REALTIME) {
+		// Make sure the frame is complete so that present timestamps are
+		// comparable to a real scanout
+		glFinish();
+		clock_gettime(CLOCK_MONOTONIC, &output->last_present);
+	} else {
+		// With a virtual clock, the frame is shown at the next vblank
+		get_headless_next_vblank(output, &output->last_present);
+	}
 }
 
 static bool output_swap_buffers(struct wlr_output *wlr_output,
 		pixman_region32_t *damage) {
-	return true; // No-op
+	struct wlr_headless_output *output =
+		(struct wlr_headless_output *)wlr_output;
+
+	output_update_present_time(output);
+
+	wlr_buffer_unref(output->scanout_buffer);
+	output->scanout_buffer = NULL;
+
+	output->seq++;
+	output->buffers[output->back].seq = output->seq;
+	output->front = output->back;
+	output->back = (output->back + 1) % output->n_buffers;
+	return true;
+}
+
+static bool output_present_buffer(struct wlr_output *wlr_output,
+		struct wlr_buffer *buffer) {
+	struct wlr_headless_output *output =
+		(struct wlr_headless_output *)wlr_output;
+
+	// Keep the buffer alive while it's on screen, like a real scanout would
+	wlr_buffer_ref(buffer);
+	wlr_buffer_unref(output->scanout_buffer);
+	output->scanout_buffer = buffer;
+
+	output_update_present_time(output);
+
+	// None of the swapchain buffers holds a recent frame anymore
+	for (size_t i = 0; i < output->n_buffers; ++i) {
+		output->buffers[i].seq = 0;
+	}
+	output->seq++;
+	return true;
 }
 
 static void output_destroy(struct wlr_output *wlr_output) {
 	struct wlr_headless_output *output =
 		(struct wlr_headless_output *)wlr_output;
 
+	wlr_buffer_unref(output->scanout_buffer);
+
 	wl_list_remove(&output->link);
 
-	wl_event_source_remove(output->frame_timer);
+	if (output->frame_timer != NULL) {
+		wl_event_source_remove(output->frame_timer);
+	}
 
+	if (wlr_egl_make_current(&output->backend->egl, output->egl_surface,
+			NULL)) {
+		output_destroy_buffers(output);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
 	wlr_egl_destroy_surface(&output->backend->egl, output->egl_surface);
 	free(output);
 }
@@ -81,17 +296,101 @@ static const struct wlr_output_impl output_impl = {
 	.destroy = output_destroy,
 	.make_current = output_make_current,
 	.swap_buffers = output_swap_buffers,
+	.present_buffer = output_present_buffer,
 };
 
 bool wlr_output_is_headless(struct wlr_output *wlr_output) {
 	return wlr_output->impl == &output_impl;
 }
 
-static int signal_frame(void *data) {
-	struct wlr_headless_output *output = data;
-	wlr_output_send_frame(&output->wlr_output);
-	wl_event_source_timer_update(output->frame_timer, output->frame_delay);
-	return 0;
+static struct wlr_headless_output *headless_output_from_output(
+		struct wlr_output *wlr_output) {
+	assert(wlr_output_is_headless(wlr_output));
+	return (struct wlr_headless_output *)wlr_output;
+}
+
+bool wlr_headless_output_set_buffer_count(struct wlr_output *wlr_output,
+		size_t count) {
+	struct wlr_headless_output *output =
+		headless_output_from_output(wlr_output);
+	if (count < 1 || count > WLR_HEADLESS_MAX_BUFFERS) {
+		wlr_log(L_ERROR, "Invalid headless buffer count %zu", count);
+		return false;
+	}
+	if (count == output->n_buffers) {
+		return true;
+	}
+
+	if (!wlr_egl_make_current(&output->backend->egl, output->egl_surface,
+			NULL)) {
+		return false;
+	}
+
+	size_t prev_count = output->n_buffers;
+	output->n_buffers = count;
+	if (!output_create_buffers(output, wlr_output->width,
+			wlr_output->height)) {
+		output->n_buffers = prev_count;
+		output_create_buffers(output, wlr_output->width, wlr_output->height);
+		return false;
+	}
+
+	wlr_output_damage_whole(wlr_output);
+	return true;
+}
+
+bool wlr_headless_output_get_last_present(struct wlr_output *wlr_output,
+		struct timespec *when) {
+	struct wlr_headless_output *output =
+		headless_output_from_output(wlr_output);
+	if (output->seq == 0) {
+		return false;
+	}
+	*when = output->last_present;
+	return true;
+}
+
+bool wlr_headless_output_read_presented_pixels(struct wlr_output *wlr_output,
+		enum wl_shm_format fmt, uint32_t stride, uint32_t width,
+		uint32_t height, void *data) {
+	struct wlr_headless_output *output =
+		headless_output_from_output(wlr_output);
+	struct wlr_headless_backend *backend = output->backend;
+	if (output->seq == 0) {
+		return false;
+	}
+
+	if (!wlr_egl_make_current(&backend->egl, output->egl_surface, NULL)) {
+		return false;
+	}
+
+	// The renderer reads from the bound framebuffer and needs a viewport
+	if (output->scanout_buffer != NULL) {
+		// The back buffer contents are undefined after a direct scanout, use
+		// it to resolve the client buffer
+		glBindFramebuffer(GL_FRAMEBUFFER, output->buffers[output->back].fbo);
+		wlr_renderer_begin(backend->renderer, wlr_output->width,
+			wlr_output->height);
+		// The client buffer is in the output's transform
+		struct wlr_box box = { 0 };
+		wlr_output_transformed_resolution(wlr_output, &box.width,
+			&box.height);
+		float matrix[9];
+		wlr_matrix_project_box(matrix, &box,
+			wlr_output_transform_invert(wlr_output->transform), 0,
+			wlr_output->transform_matrix);
+		wlr_render_texture_with_matrix(backend->renderer,
+			output->scanout_buffer->texture, matrix, 1.0f);
+	} else {
+		glBindFramebuffer(GL_FRAMEBUFFER, output->buffers[output->front].fbo);
+		wlr_renderer_begin(backend->renderer, wlr_output->width,
+			wlr_output->height);
+	}
+	bool ok = wlr_renderer_read_pixels(backend->renderer, fmt, NULL, stride,
+		width, height, 0, 0, 0, 0, data);
+	wlr_renderer_end(backend->renderer);
+	glBindFramebuffer(GL_FRAMEBUFFER, output->buffers[output->back].fbo);
+	return ok;
 }
 
 struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
@@ -106,24 +405,33 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		return NULL;
 	}
 	output->backend = backend;
+	output->n_buffers = HEADLESS_DEFAULT_BUFFERS;
+	wl_list_init(&output->link);
 	wlr_output_init(&output->wlr_output, &backend->backend, &output_impl,
 		backend->display);
 	struct wlr_output *wlr_output = &output->wlr_output;
 
-	output->egl_surface = egl_create_surface(&backend->egl, width, height);
+	struct wl_event_loop *ev = wl_display_get_event_loop(backend->display);
+	output->frame_timer = wl_event_loop_add_timer(ev, signal_frame, output);
+
+	// Rendering happens in the swapchain framebuffers, the surface is only
+	// needed to make the context current
+	output->egl_surface = egl_create_surface(&backend->egl, 1, 1);
 	if (output->egl_surface == EGL_NO_SURFACE) {
 		wlr_log(L_ERROR, "Failed to create EGL surface");
 		goto error;
 	}
 
-	output_set_custom_mode(wlr_output, width, height, 0);
+	if (!output_set_custom_mode(wlr_output, width, height, 0)) {
+		// The output has already been destroyed
+		return NULL;
+	}
 	strncpy(wlr_output->make, "headless", sizeof(wlr_output->make));
 	strncpy(wlr_output->model, "headless", sizeof(wlr_output->model));
 	snprintf(wlr_output->name, sizeof(wlr_output->name), "HEADLESS-%d",
 		wl_list_length(&backend->outputs) + 1);
 
-	if (!wlr_egl_make_current(&output->backend->egl, output->egl_surface,
-			NULL)) {
+	if (!output_make_current(wlr_output, NULL)) {
 		goto error;
 	}
 
@@ -131,15 +439,15 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 	wlr_renderer_clear(backend->renderer, (float[]){ 1.0, 1.0, 1.0, 1.0 });
 	wlr_renderer_end(backend->renderer);
 
-	struct wl_event_loop *ev = wl_display_get_event_loop(backend->display);
-	output->frame_timer = wl_event_loop_add_timer(ev, signal_frame, output);
-
+	wl_list_remove(&output->link);
 	wl_list_insert(&backend->outputs, &output->link);
 
 	if (backend->started) {
-		wl_event_source_timer_update(output->frame_timer, output->frame_delay);
+		reset_headless_vblank(output);
+		schedule_headless_vblank(output);
 		wlr_output_update_enabled(wlr_output, true);
 		wlr_signal_emit_safe(&backend->backend.events.new_output, wlr_output);
+		wake_headless_clock(backend);
 	}
 
 	return wlr_output;
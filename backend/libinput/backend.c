@@ -1,10 +1,13 @@
+#define _POSIX_C_SOURCE 199309L
 #include <assert.h>
 #include <libinput.h>
 #include <stdlib.h>
+#include <time.h>
 #include <wlr/backend/interface.h>
 #include <wlr/backend/session.h>
 #include <wlr/util/log.h>
 #include "backend/libinput.h"
+#include "types/wlr_input_latency.h"
 #include "util/signal.h"
 
 static int libinput_open_restricted(const char *path,
@@ -30,9 +33,13 @@ static int handle_libinput_readable(int fd, uint32_t mask, void *_backend) {
 		// TODO: some kind of abort?
 		return 0;
 	}
+	struct timespec arrival;
+	clock_gettime(CLOCK_MONOTONIC, &arrival);
 	struct libinput_event *event;
 	while ((event = libinput_get_event(backend->libinput_context))) {
+		input_latency_begin_event(&arrival);
 		handle_libinput_event(backend, event);
+		input_latency_end_event();
 		libinput_event_destroy(event);
 	}
 	return 0;
@@ -81,11 +88,18 @@ static bool backend_start(struct wlr_backend *_backend) {
 		}
 	}
 
-	struct wl_event_loop *event_loop =
-		wl_display_get_event_loop(backend->display);
 	if (backend->input_event) {
 		wl_event_source_remove(backend->input_event);
+		backend->input_event = NULL;
+	}
+	stop_libinput_thread(backend);
+	if (backend->use_thread && start_libinput_thread(backend)) {
+		wlr_log(L_DEBUG, "libinput successfully initialized");
+		return true;
 	}
+
+	struct wl_event_loop *event_loop =
+		wl_display_get_event_loop(backend->display);
 	backend->input_event = wl_event_loop_add_fd(event_loop, libinput_fd,
 			WL_EVENT_READABLE, handle_libinput_readable, backend);
 	if (!backend->input_event) {
@@ -103,6 +117,8 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 	struct wlr_libinput_backend *backend =
 		(struct wlr_libinput_backend *)wlr_backend;
 
+	stop_libinput_thread(backend);
+
 	for (size_t i = 0; i < backend->wlr_device_lists.length; i++) {
 		struct wl_list *wlr_devices = backend->wlr_device_lists.items[i];
 		struct wlr_input_device *wlr_dev, *next;
@@ -143,11 +159,13 @@ static void session_signal(struct wl_listener *listener, void *data) {
 		return;
 	}
 
+	lock_libinput(backend);
 	if (session->active) {
 		libinput_resume(backend->libinput_context);
 	} else {
 		libinput_suspend(backend->libinput_context);
 	}
+	unlock_libinput(backend);
 }
 
 static void handle_display_destroy(struct wl_listener *listener, void *data) {
@@ -175,6 +193,9 @@ struct wlr_backend *wlr_libinput_backend_create(struct wl_display *display,
 	backend->session = session;
 	backend->display = display;
 
+	const char *use_thread = getenv("WLR_LIBINPUT_THREAD");
+	backend->use_thread = use_thread != NULL && strcmp(use_thread, "1") == 0;
+
 	backend->session_signal.notify = session_signal;
 	wl_signal_add(&session->session_signal, &backend->session_signal);
 
@@ -187,6 +208,14 @@ error_backend:
 	return NULL;
 }
 
+void wlr_libinput_backend_set_input_thread(struct wlr_backend *wlr_backend,
+		bool enabled) {
+	assert(wlr_backend_is_libinput(wlr_backend));
+	struct wlr_libinput_backend *backend =
+		(struct wlr_libinput_backend *)wlr_backend;
+	backend->use_thread = enabled;
+}
+
 struct libinput_device *wlr_libinput_get_device_handle(struct wlr_input_device *_dev) {
 	struct wlr_libinput_input_device *dev = (struct wlr_libinput_input_device *)_dev;
 	return dev->handle;
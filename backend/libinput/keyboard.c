@@ -15,7 +15,12 @@ struct wlr_libinput_keyboard {
 static void keyboard_set_leds(struct wlr_keyboard *wlr_kb, uint32_t leds) {
 	struct wlr_libinput_keyboard *wlr_libinput_kb =
 		(struct wlr_libinput_keyboard *)wlr_kb;
+	// Keymaps, and thus LEDs, can be changed at any time by the compositor
+	struct wlr_libinput_backend *backend = libinput_get_user_data(
+		libinput_device_get_context(wlr_libinput_kb->libinput_dev));
+	lock_libinput(backend);
 	libinput_device_led_update(wlr_libinput_kb->libinput_dev, leds);
+	unlock_libinput(backend);
 }
 
 static void keyboard_destroy(struct wlr_keyboard *wlr_kb) {
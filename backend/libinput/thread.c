@@ -0,0 +1,263 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <libinput.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "backend/libinput.h"
+#include "types/wlr_input_latency.h"
+
+#define INPUT_THREAD_RING_SIZE 1024 // must be a power of two
+
+/**
+ * libinput is read on a dedicated thread, so that input keeps being drained
+ * from the kernel while the main thread is busy, e.g. rendering. Events are
+ * handed over through a single-producer single-consumer ring and handled on
+ * the main thread, in order.
+ *
+ * libinput itself isn't thread-safe: the context is only used with `lock`
+ * held. The reader thread holds it while dispatching, the main thread while
+ * handling events and for any other libinput call.
+ */
+struct wlr_libinput_thread {
+	struct wlr_libinput_backend *backend;
+	pthread_t thread;
+	pthread_mutex_t lock; // recursive
+
+	int notify_fd; // wakes up the main thread when events are queued
+	int control_fd; // wakes up the reader thread
+	struct wl_event_source *notify_source;
+
+	atomic_bool stop;
+	// Set by the reader thread when it waits for the main thread to make room
+	atomic_bool ring_full;
+
+	struct libinput_event *ring[INPUT_THREAD_RING_SIZE];
+	// When the reader thread got each event, on CLOCK_MONOTONIC
+	struct timespec arrival[INPUT_THREAD_RING_SIZE];
+	atomic_size_t head; // written by the reader thread
+	atomic_size_t tail; // written by the main thread
+};
+
+static void write_eventfd(int fd) {
+	uint64_t one = 1;
+	if (write(fd, &one, sizeof(one)) < 0) {
+		wlr_log_errno(L_ERROR, "Failed to write to libinput thread eventfd");
+	}
+}
+
+static void read_eventfd(int fd) {
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		wlr_log_errno(L_ERROR, "Failed to read from libinput thread eventfd");
+	}
+}
+
+/**
+ * Moves events from libinput to the ring. Returns true if any was queued.
+ * Events which don't fit are left in libinput's queue, until the main thread
+ * makes room.
+ */
+static bool queue_events(struct wlr_libinput_thread *thread) {
+	struct libinput *context = thread->backend->libinput_context;
+	size_t head = atomic_load_explicit(&thread->head, memory_order_relaxed);
+	bool queued = false;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	while (true) {
+		size_t tail =
+			atomic_load_explicit(&thread->tail, memory_order_acquire);
+		if (head - tail == INPUT_THREAD_RING_SIZE) {
+			atomic_store(&thread->ring_full, true);
+			// The main thread may have emptied the ring before seeing the flag
+			if (atomic_load(&thread->tail) == tail) {
+				break;
+			}
+			atomic_store(&thread->ring_full, false);
+			continue;
+		}
+
+		struct libinput_event *event = libinput_get_event(context);
+		if (event == NULL) {
+			break;
+		}
+		thread->ring[head & (INPUT_THREAD_RING_SIZE - 1)] = event;
+		thread->arrival[head & (INPUT_THREAD_RING_SIZE - 1)] = now;
+		head++;
+		atomic_store_explicit(&thread->head, head, memory_order_release);
+		queued = true;
+	}
+	return queued;
+}
+
+static void *input_thread_run(void *data) {
+	struct wlr_libinput_thread *thread = data;
+	struct libinput *context = thread->backend->libinput_context;
+
+	struct pollfd fds[] = {
+		{ .fd = thread->control_fd, .events = POLLIN },
+		{ .fd = libinput_get_fd(context), .events = POLLIN },
+	};
+	while (!atomic_load(&thread->stop)) {
+		// Stop reading from the kernel while the ring is full
+		nfds_t nfds = atomic_load(&thread->ring_full) ? 1 : 2;
+		if (poll(fds, nfds, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			wlr_log_errno(L_ERROR, "Failed to poll libinput");
+			break;
+		}
+		if (fds[0].revents & POLLIN) {
+			read_eventfd(thread->control_fd);
+		}
+		if (atomic_load(&thread->stop)) {
+			break;
+		}
+
+		pthread_mutex_lock(&thread->lock);
+		if (libinput_dispatch(context) != 0) {
+			wlr_log(L_ERROR, "Failed to dispatch libinput");
+		}
+		bool queued = queue_events(thread);
+		pthread_mutex_unlock(&thread->lock);
+
+		if (queued) {
+			write_eventfd(thread->notify_fd);
+		}
+	}
+	return NULL;
+}
+
+static int handle_notify(int fd, uint32_t mask, void *data) {
+	struct wlr_libinput_thread *thread = data;
+	read_eventfd(fd);
+
+	pthread_mutex_lock(&thread->lock);
+	size_t tail = atomic_load_explicit(&thread->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&thread->head, memory_order_acquire);
+	while (tail != head) {
+		size_t i = tail & (INPUT_THREAD_RING_SIZE - 1);
+		struct libinput_event *event = thread->ring[i];
+		input_latency_begin_event(&thread->arrival[i]);
+		handle_libinput_event(thread->backend, event);
+		input_latency_end_event();
+		libinput_event_destroy(event);
+		tail++;
+	}
+	atomic_store_explicit(&thread->tail, tail, memory_order_release);
+	pthread_mutex_unlock(&thread->lock);
+
+	if (atomic_exchange(&thread->ring_full, false)) {
+		write_eventfd(thread->control_fd);
+	}
+	return 0;
+}
+
+bool start_libinput_thread(struct wlr_libinput_backend *backend) {
+	struct wlr_libinput_thread *thread =
+		calloc(1, sizeof(struct wlr_libinput_thread));
+	if (thread == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return false;
+	}
+	thread->backend = backend;
+	atomic_init(&thread->stop, false);
+	atomic_init(&thread->ring_full, false);
+	atomic_init(&thread->head, 0);
+	atomic_init(&thread->tail, 0);
+
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	// The main thread may call back into libinput while handling an event
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	int ret = pthread_mutex_init(&thread->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	if (ret != 0) {
+		wlr_log(L_ERROR, "Failed to create libinput thread lock");
+		free(thread);
+		return false;
+	}
+
+	thread->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	thread->control_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (thread->notify_fd < 0 || thread->control_fd < 0) {
+		wlr_log_errno(L_ERROR, "Failed to create libinput thread eventfd");
+		goto error_fds;
+	}
+
+	struct wl_event_loop *event_loop =
+		wl_display_get_event_loop(backend->display);
+	thread->notify_source = wl_event_loop_add_fd(event_loop,
+		thread->notify_fd, WL_EVENT_READABLE, handle_notify, thread);
+	if (thread->notify_source == NULL) {
+		wlr_log(L_ERROR, "Failed to create input event on event loop");
+		goto error_fds;
+	}
+
+	ret = pthread_create(&thread->thread, NULL, input_thread_run, thread);
+	if (ret != 0) {
+		wlr_log(L_ERROR, "Failed to start libinput thread: %s", strerror(ret));
+		wl_event_source_remove(thread->notify_source);
+		goto error_fds;
+	}
+	backend->thread = thread;
+
+	wlr_log(L_DEBUG, "Reading libinput events on a dedicated thread");
+	return true;
+
+error_fds:
+	if (thread->notify_fd >= 0) {
+		close(thread->notify_fd);
+	}
+	if (thread->control_fd >= 0) {
+		close(thread->control_fd);
+	}
+	pthread_mutex_destroy(&thread->lock);
+	free(thread);
+	return false;
+}
+
+void stop_libinput_thread(struct wlr_libinput_backend *backend) {
+	struct wlr_libinput_thread *thread = backend->thread;
+	if (thread == NULL) {
+		return;
+	}
+
+	atomic_store(&thread->stop, true);
+	write_eventfd(thread->control_fd);
+	pthread_join(thread->thread, NULL);
+	backend->thread = NULL;
+
+	// Events still in the ring are dropped, like those left in libinput
+	size_t tail = atomic_load(&thread->tail);
+	size_t head = atomic_load(&thread->head);
+	for (; tail != head; ++tail) {
+		libinput_event_destroy(
+			thread->ring[tail & (INPUT_THREAD_RING_SIZE - 1)]);
+	}
+
+	wl_event_source_remove(thread->notify_source);
+	close(thread->notify_fd);
+	close(thread->control_fd);
+	pthread_mutex_destroy(&thread->lock);
+	free(thread);
+}
+
+void lock_libinput(struct wlr_libinput_backend *backend) {
+	if (backend->thread != NULL) {
+		pthread_mutex_lock(&backend->thread->lock);
+	}
+}
+
+void unlock_libinput(struct wlr_libinput_backend *backend) {
+	if (backend->thread != NULL) {
+		pthread_mutex_unlock(&backend->thread->lock);
+	}
+}
@@ -1,9 +1,11 @@
+#define _POSIX_C_SOURCE 199309L
 #include <assert.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 #include <wayland-server.h>
 #include <wlr/backend/interface.h>
 #include <wlr/interfaces/wlr_input_device.h>
@@ -12,6 +14,7 @@
 #include <wlr/render/gles2.h>
 #include <wlr/util/log.h>
 #include "backend/wayland.h"
+#include "types/wlr_input_latency.h"
 #include "util/signal.h"
 #include "xdg-shell-unstable-v6-client-protocol.h"
 
@@ -24,6 +27,9 @@ static int dispatch_events(int fd, uint32_t mask, void *data) {
 		return 0;
 	}
 
+	struct timespec arrival;
+	clock_gettime(CLOCK_MONOTONIC, &arrival);
+	input_latency_begin_event(&arrival);
 	if (mask & WL_EVENT_READABLE) {
 		count = wl_display_dispatch(backend->remote_display);
 	}
@@ -31,6 +37,7 @@ static int dispatch_events(int fd, uint32_t mask, void *data) {
 		count = wl_display_dispatch_pending(backend->remote_display);
 		wl_display_flush(backend->remote_display);
 	}
+	input_latency_end_event();
 	return count;
 }
 
@@ -20,6 +20,7 @@
 #include <xcb/xkb.h>
 #endif
 #include "backend/x11.h"
+#include "types/wlr_input_latency.h"
 #include "util/signal.h"
 
 struct wlr_x11_output *get_x11_output_from_window_id(struct wlr_x11_backend *x11,
@@ -79,9 +80,13 @@ static int x11_event(int fd, uint32_t mask, void *data) {
 		return 0;
 	}
 
+	struct timespec arrival;
+	clock_gettime(CLOCK_MONOTONIC, &arrival);
 	xcb_generic_event_t *e;
 	while ((e = xcb_poll_for_event(x11->xcb_conn))) {
+		input_latency_begin_event(&arrival);
 		handle_x11_event(x11, e);
+		input_latency_end_event();
 		free(e);
 	}
 
@@ -0,0 +1,253 @@
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_damage.h>
+#include <wlr/util/log.h>
+
+/**
+ * Checks that software cursors are repainted correctly when the output buffers
+ * are reused with a buffer age of 2, on the headless backend.
+ *
+ * A scene made of a background and a rectangle is rendered like a compositor
+ * would, repainting only the damaged region. The cursor moves on every frame
+ * and the rectangle changes color from time to time. After each frame, the
+ * presented pixels are compared with the expected image. The check also fails
+ * if the output never repaints a frame with only the scene damage, ie. if
+ * `wlr_output_damage_restore_cursors` is never taken.
+ *
+ * Usage: cursor-damage-check [-n frames]
+ */
+
+#define OUTPUT_WIDTH 128
+#define OUTPUT_HEIGHT 96
+#define CURSOR_SIZE 16
+
+static const float background_color[4] = { 0.0, 0.0, 0.0, 1.0 };
+static const float rect_colors[2][4] = {
+	{ 1.0, 0.0, 0.0, 1.0 },
+	{ 0.0, 0.0, 1.0, 1.0 },
+};
+static const struct wlr_box rect_box = {
+	.x = 40, .y = 24, .width = 48, .height = 40,
+};
+static const uint8_t cursor_rgba[4] = { 0, 255, 0, 255 };
+
+struct check_state {
+	struct wlr_output *output;
+	struct wlr_output_damage *damage;
+	struct wlr_output_cursor *cursor;
+	struct wl_listener frame;
+
+	int cursor_x, cursor_y;
+	int rect_color;
+
+	int frames_rendered;
+	int frames_restored;
+	bool failed;
+};
+
+static void render_scene(struct check_state *state, pixman_region32_t *damage) {
+	struct wlr_output *output = state->output;
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+
+	wlr_renderer_begin(renderer, output->width, output->height);
+
+	int n_rects;
+	pixman_box32_t *rects = pixman_region32_rectangles(damage, &n_rects);
+	for (int i = 0; i < n_rects; ++i) {
+		struct wlr_box box = {
+			.x = rects[i].x1,
+			.y = rects[i].y1,
+			.width = rects[i].x2 - rects[i].x1,
+			.height = rects[i].y2 - rects[i].y1,
+		};
+		wlr_renderer_scissor(renderer, &box);
+		wlr_renderer_clear(renderer, background_color);
+		wlr_render_rect(renderer, &rect_box, rect_colors[state->rect_color],
+			output->transform_matrix);
+	}
+	wlr_renderer_scissor(renderer, NULL);
+
+	wlr_renderer_end(renderer);
+}
+
+static void damage_handle_frame(struct wl_listener *listener, void *data) {
+	struct check_state *state = wl_container_of(listener, state, frame);
+
+	bool needs_swap;
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	if (!wlr_output_damage_make_current(state->damage, &needs_swap, &damage)) {
+		state->failed = true;
+		goto damage_finish;
+	}
+	if (!needs_swap) {
+		goto damage_finish;
+	}
+
+	if (wlr_output_damage_restore_cursors(state->damage, &damage)) {
+		state->frames_restored++;
+	}
+	render_scene(state, &damage);
+	if (!wlr_output_damage_swap_buffers(state->damage, NULL, &damage)) {
+		state->failed = true;
+	}
+	state->frames_rendered++;
+
+damage_finish:
+	pixman_region32_fini(&damage);
+}
+
+static void expected_pixel(struct check_state *state, int x, int y,
+		uint8_t rgba[static 4]) {
+	if (x >= state->cursor_x && x < state->cursor_x + CURSOR_SIZE &&
+			y >= state->cursor_y && y < state->cursor_y + CURSOR_SIZE) {
+		memcpy(rgba, cursor_rgba, 4);
+		return;
+	}
+
+	const float *color = background_color;
+	if (wlr_box_contains_point(&rect_box, x + 0.5, y + 0.5)) {
+		color = rect_colors[state->rect_color];
+	}
+	for (int i = 0; i < 4; ++i) {
+		rgba[i] = color[i] * 255;
+	}
+}
+
+static bool check_presented_pixels(struct check_state *state, int frame) {
+	uint8_t *data = calloc(OUTPUT_WIDTH * OUTPUT_HEIGHT, 4);
+	if (data == NULL) {
+		return false;
+	}
+	if (!wlr_headless_output_read_presented_pixels(state->output,
+			WL_SHM_FORMAT_ABGR8888, OUTPUT_WIDTH * 4, OUTPUT_WIDTH,
+			OUTPUT_HEIGHT, data)) {
+		fprintf(stderr, "frame %d: failed to read pixels\n", frame);
+		free(data);
+		return false;
+	}
+
+	bool ok = true;
+	for (int y = 0; y < OUTPUT_HEIGHT && ok; ++y) {
+		for (int x = 0; x < OUTPUT_WIDTH; ++x) {
+			const uint8_t *p = &data[(y * OUTPUT_WIDTH + x) * 4];
+			uint8_t expected[4];
+			expected_pixel(state, x, y, expected);
+			if (memcmp(p, expected, 4) != 0) {
+				fprintf(stderr, "frame %d: pixel (%d, %d) is "
+					"%02x%02x%02x%02x, expected %02x%02x%02x%02x\n", frame,
+					x, y, p[0], p[1], p[2], p[3], expected[0], expected[1],
+					expected[2], expected[3]);
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	free(data);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	int n_frames = 64;
+
+	int c;
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			n_frames = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n frames]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	wlr_log_init(L_ERROR, NULL);
+
+	struct wl_display *display = wl_display_create();
+	struct wlr_backend *backend = wlr_headless_backend_create(display, NULL);
+	if (backend == NULL ||
+			!wlr_headless_backend_set_clock_mode(backend,
+				WLR_HEADLESS_CLOCK_MANUAL, NULL)) {
+		fprintf(stderr, "failed to create the headless backend\n");
+		return EXIT_FAILURE;
+	}
+
+	struct check_state state = { 0 };
+	state.output = wlr_headless_add_output(backend, OUTPUT_WIDTH,
+		OUTPUT_HEIGHT);
+	if (state.output == NULL ||
+			!wlr_headless_output_set_buffer_count(state.output, 2)) {
+		fprintf(stderr, "failed to create the headless output\n");
+		return EXIT_FAILURE;
+	}
+
+	state.damage = wlr_output_damage_create(state.output);
+	state.frame.notify = damage_handle_frame;
+	wl_signal_add(&state.damage->events.frame, &state.frame);
+
+	uint8_t pixels[CURSOR_SIZE * CURSOR_SIZE * 4];
+	for (size_t i = 0; i < CURSOR_SIZE * CURSOR_SIZE; ++i) {
+		// ARGB8888 in little endian
+		pixels[i * 4 + 0] = cursor_rgba[2];
+		pixels[i * 4 + 1] = cursor_rgba[1];
+		pixels[i * 4 + 2] = cursor_rgba[0];
+		pixels[i * 4 + 3] = cursor_rgba[3];
+	}
+	state.cursor = wlr_output_cursor_create(state.output);
+	if (state.cursor == NULL || !wlr_output_cursor_set_image(state.cursor,
+			pixels, CURSOR_SIZE * 4, CURSOR_SIZE, CURSOR_SIZE, 0, 0)) {
+		fprintf(stderr, "failed to create the cursor\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!wlr_backend_start(backend)) {
+		fprintf(stderr, "failed to start the backend\n");
+		return EXIT_FAILURE;
+	}
+	wlr_output_damage_add_whole(state.damage);
+
+	int ret = EXIT_SUCCESS;
+	for (int i = 0; i < n_frames; ++i) {
+		// The cursor sweeps across the rectangle edges and the output edges
+		state.cursor_x = (i * 7) % (OUTPUT_WIDTH + CURSOR_SIZE) - CURSOR_SIZE;
+		state.cursor_y = (i * 5) % (OUTPUT_HEIGHT + CURSOR_SIZE) - CURSOR_SIZE;
+		wlr_output_cursor_move(state.cursor, state.cursor_x, state.cursor_y);
+
+		if (i % 5 == 3) {
+			state.rect_color = !state.rect_color;
+			struct wlr_box box = rect_box;
+			wlr_output_damage_add_box(state.damage, &box);
+		}
+
+		wlr_headless_backend_step(backend, 1);
+		if (state.failed || !check_presented_pixels(&state, i)) {
+			ret = EXIT_FAILURE;
+			break;
+		}
+	}
+
+	if (ret == EXIT_SUCCESS && n_frames > 4 && state.frames_restored == 0) {
+		fprintf(stderr, "software cursors were never restored\n");
+		ret = EXIT_FAILURE;
+	}
+	printf("%d frames rendered, %d with restored cursors\n",
+		state.frames_rendered, state.frames_restored);
+
+	wl_list_remove(&state.frame.link);
+	wlr_backend_destroy(backend);
+	wl_display_destroy(display);
+	return ret;
+}
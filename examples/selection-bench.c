@@ -0,0 +1,360 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client-protocol.h>
+#include <wayland-client.h>
+#include <xcb/xcb.h>
+
+/**
+ * Measures the throughput of clipboard transfers from Wayland to X11, through
+ * the compositor's Xwayland window manager.
+ *
+ * The Wayland side sets the clipboard selection with a data source serving
+ * `size` bytes, and the X11 side requests it as UTF8_STRING, following INCR
+ * transfers, until all the data has been received.
+ *
+ * Usage: selection-bench [-s MiB] [-n iterations]
+ */
+
+#define MIME_TYPE "text/plain;charset=utf-8"
+#define WRITE_CHUNK_SIZE (64 * 1024)
+
+static struct wl_seat *seat = NULL;
+static struct wl_data_device_manager *data_device_manager = NULL;
+
+static size_t size = 64 * 1024 * 1024;
+static int iterations = 3;
+
+// Wayland side
+static int source_fd = -1;
+static size_t source_written = 0;
+static bool source_cancelled = false;
+static uint32_t serial = 0;
+
+// X11 side
+static xcb_connection_t *xcb_conn = NULL;
+static xcb_window_t window;
+static xcb_atom_t clipboard_atom, utf8_string_atom, incr_atom, property_atom;
+static bool incr = false;
+static bool transfer_done = false;
+static bool transfer_failed = false;
+static size_t received = 0;
+
+static void data_source_handle_target(void *data,
+		struct wl_data_source *source, const char *mime_type) {
+	// No-op
+}
+
+static void data_source_handle_send(void *data, struct wl_data_source *source,
+		const char *mime_type, int32_t fd) {
+	if (source_fd >= 0) {
+		close(source_fd);
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	source_fd = fd;
+	source_written = 0;
+}
+
+static void data_source_handle_cancelled(void *data,
+		struct wl_data_source *source) {
+	source_cancelled = true;
+}
+
+static const struct wl_data_source_listener data_source_listener = {
+	.target = data_source_handle_target,
+	.send = data_source_handle_send,
+	.cancelled = data_source_handle_cancelled,
+};
+
+static void callback_handle_done(void *data, struct wl_callback *callback,
+		uint32_t callback_data) {
+	serial = callback_data;
+	wl_callback_destroy(callback);
+}
+
+static const struct wl_callback_listener callback_listener = {
+	.done = callback_handle_done,
+};
+
+static void handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	if (strcmp(interface, wl_seat_interface.name) == 0 && seat == NULL) {
+		seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+	} else if (strcmp(interface, wl_data_device_manager_interface.name) == 0) {
+		data_device_manager = wl_registry_bind(registry, name,
+			&wl_data_device_manager_interface, 1);
+	}
+}
+
+static void handle_global_remove(void *data, struct wl_registry *registry,
+		uint32_t name) {
+	// Who cares?
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = handle_global,
+	.global_remove = handle_global_remove,
+};
+
+static void write_source(void) {
+	static char chunk[WRITE_CHUNK_SIZE];
+	if (chunk[0] == '\0') {
+		memset(chunk, 'a', sizeof(chunk));
+	}
+
+	while (source_written < size) {
+		size_t len = size - source_written;
+		if (len > sizeof(chunk)) {
+			len = sizeof(chunk);
+		}
+		ssize_t n = write(source_fd, chunk, len);
+		if (n < 0) {
+			if (errno == EAGAIN) {
+				return;
+			}
+			fprintf(stderr, "write failed: %s\n", strerror(errno));
+			break;
+		}
+		source_written += n;
+	}
+
+	close(source_fd);
+	source_fd = -1;
+}
+
+static xcb_atom_t intern_atom(const char *name) {
+	xcb_intern_atom_cookie_t cookie =
+		xcb_intern_atom(xcb_conn, 0, strlen(name), name);
+	xcb_intern_atom_reply_t *reply =
+		xcb_intern_atom_reply(xcb_conn, cookie, NULL);
+	if (reply == NULL) {
+		return XCB_ATOM_NONE;
+	}
+	xcb_atom_t atom = reply->atom;
+	free(reply);
+	return atom;
+}
+
+static void read_property(void) {
+	xcb_get_property_cookie_t cookie = xcb_get_property(xcb_conn, 1, window,
+		property_atom, XCB_GET_PROPERTY_TYPE_ANY, 0, UINT32_MAX / 4);
+	xcb_get_property_reply_t *reply =
+		xcb_get_property_reply(xcb_conn, cookie, NULL);
+	if (reply == NULL) {
+		transfer_failed = true;
+		return;
+	}
+
+	if (reply->type == incr_atom) {
+		// Deleting the property started the transfer
+		incr = true;
+	} else {
+		size_t len = xcb_get_property_value_length(reply);
+		received += len;
+		if (!incr || len == 0) {
+			transfer_done = true;
+		}
+	}
+	free(reply);
+	xcb_flush(xcb_conn);
+}
+
+static void handle_x11_events(void) {
+	xcb_generic_event_t *event;
+	while ((event = xcb_poll_for_event(xcb_conn)) != NULL) {
+		switch (event->response_type & ~0x80) {
+		case XCB_SELECTION_NOTIFY:;
+			xcb_selection_notify_event_t *notify =
+				(xcb_selection_notify_event_t *)event;
+			if (notify->property == XCB_ATOM_NONE) {
+				transfer_failed = true;
+			} else {
+				read_property();
+			}
+			break;
+		case XCB_PROPERTY_NOTIFY:;
+			xcb_property_notify_event_t *property =
+				(xcb_property_notify_event_t *)event;
+			if (incr && property->atom == property_atom &&
+					property->state == XCB_PROPERTY_NEW_VALUE) {
+				read_property();
+			}
+			break;
+		}
+		free(event);
+	}
+}
+
+static bool wait_for_owner(void) {
+	for (int i = 0; i < 100; ++i) {
+		xcb_get_selection_owner_cookie_t cookie =
+			xcb_get_selection_owner(xcb_conn, clipboard_atom);
+		xcb_get_selection_owner_reply_t *reply =
+			xcb_get_selection_owner_reply(xcb_conn, cookie, NULL);
+		xcb_window_t owner = reply != NULL ? reply->owner : XCB_WINDOW_NONE;
+		free(reply);
+		if (owner != XCB_WINDOW_NONE) {
+			return true;
+		}
+		nanosleep(&(struct timespec){ .tv_nsec = 10 * 1000 * 1000 }, NULL);
+	}
+	return false;
+}
+
+static bool run_transfer(struct wl_display *display) {
+	incr = transfer_done = transfer_failed = false;
+	received = 0;
+
+	xcb_convert_selection(xcb_conn, window, clipboard_atom, utf8_string_atom,
+		property_atom, XCB_CURRENT_TIME);
+	xcb_flush(xcb_conn);
+
+	while (true) {
+		// Replies may have queued events without the socket being readable
+		handle_x11_events();
+		if (transfer_done || transfer_failed || source_cancelled) {
+			break;
+		}
+		if (xcb_connection_has_error(xcb_conn)) {
+			fprintf(stderr, "X11 connection error\n");
+			return false;
+		}
+
+		wl_display_dispatch_pending(display);
+		wl_display_flush(display);
+
+		struct pollfd fds[] = {
+			{ .fd = wl_display_get_fd(display), .events = POLLIN },
+			{ .fd = xcb_get_file_descriptor(xcb_conn), .events = POLLIN },
+			{ .fd = source_fd, .events = POLLOUT },
+		};
+		if (poll(fds, source_fd >= 0 ? 3 : 2, -1) < 0) {
+			fprintf(stderr, "poll failed: %s\n", strerror(errno));
+			return false;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			if (wl_display_dispatch(display) < 0) {
+				return false;
+			}
+		}
+		if (source_fd >= 0 && (fds[2].revents & (POLLOUT | POLLERR))) {
+			write_source();
+		}
+	}
+
+	if (source_fd >= 0) {
+		close(source_fd);
+		source_fd = -1;
+	}
+	return transfer_done;
+}
+
+static double timespec_diff_sec(const struct timespec *a,
+		const struct timespec *b) {
+	return (a->tv_sec - b->tv_sec) + (a->tv_nsec - b->tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+	int c;
+	while ((c = getopt(argc, argv, "s:n:h")) != -1) {
+		switch (c) {
+		case 's':
+			size = strtoul(optarg, NULL, 10) * 1024 * 1024;
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-s MiB] [-n iterations]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	struct wl_display *display = wl_display_connect(NULL);
+	if (display == NULL) {
+		fprintf(stderr, "failed to create display\n");
+		return EXIT_FAILURE;
+	}
+
+	struct wl_registry *registry = wl_display_get_registry(display);
+	wl_registry_add_listener(registry, &registry_listener, NULL);
+	wl_display_roundtrip(display);
+
+	if (seat == NULL || data_device_manager == NULL) {
+		fprintf(stderr, "compositor doesn't support wl_data_device_manager\n");
+		return EXIT_FAILURE;
+	}
+
+	xcb_conn = xcb_connect(NULL, NULL);
+	if (xcb_connection_has_error(xcb_conn)) {
+		fprintf(stderr, "failed to connect to the X server\n");
+		return EXIT_FAILURE;
+	}
+
+	xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(xcb_conn)).data;
+	window = xcb_generate_id(xcb_conn);
+	uint32_t values[] = { XCB_EVENT_MASK_PROPERTY_CHANGE };
+	xcb_create_window(xcb_conn, XCB_COPY_FROM_PARENT, window, screen->root,
+		0, 0, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+		XCB_CW_EVENT_MASK, values);
+
+	clipboard_atom = intern_atom("CLIPBOARD");
+	utf8_string_atom = intern_atom("UTF8_STRING");
+	incr_atom = intern_atom("INCR");
+	property_atom = intern_atom("WLR_SELECTION_BENCH");
+
+	struct wl_data_device *data_device =
+		wl_data_device_manager_get_data_device(data_device_manager, seat);
+	struct wl_data_source *source =
+		wl_data_device_manager_create_data_source(data_device_manager);
+	wl_data_source_add_listener(source, &data_source_listener, NULL);
+	wl_data_source_offer(source, MIME_TYPE);
+
+	// The selection is only replaced by a newer serial than the current one
+	struct wl_callback *callback = wl_display_sync(display);
+	wl_callback_add_listener(callback, &callback_listener, NULL);
+	wl_display_roundtrip(display);
+	wl_data_device_set_selection(data_device, source, serial + 1);
+	wl_display_roundtrip(display);
+
+	if (!wait_for_owner()) {
+		fprintf(stderr, "the clipboard wasn't forwarded to X11\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("transferring %zu MiB, %d times\n", size / (1024 * 1024),
+		iterations);
+
+	for (int i = 0; i < iterations; ++i) {
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (!run_transfer(display)) {
+			fprintf(stderr, "transfer failed\n");
+			return EXIT_FAILURE;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		double sec = timespec_diff_sec(&end, &start);
+		printf("%d: %zu bytes in %.3f s, %.1f MiB/s\n", i, received, sec,
+			received / sec / (1024 * 1024));
+		if (received != size) {
+			fprintf(stderr, "expected %zu bytes\n", size);
+		}
+	}
+
+	wl_data_source_destroy(source);
+	wl_data_device_destroy(data_device);
+	xcb_disconnect(xcb_conn);
+	wl_display_disconnect(display);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_list.h>
+#include "rootston/view.h"
+#include "rootston/view_grid.h"
+
+/**
+ * Times the hit testing of rootston on a synthetic desktop: `n_views` random
+ * windows spread over a `width`x`height` layout, queried at random points.
+ *
+ * The grid lookup does what desktop_view_at does before testing surfaces: it
+ * fetches the cell under the point, keeps the views whose hit box contains the
+ * point and sorts them top-most first. It is compared with a linear scan of all
+ * the views in stacking order, which is what desktop_view_at used to do.
+ * Surface tests are left out, since they cost the same in both cases.
+ *
+ * Usage: view-grid-bench [-n views] [-q queries] [-w width] [-h height]
+ */
+
+static int view_stack_cmp(const void *a, const void *b) {
+	const struct roots_view *view_a = *(struct roots_view * const *)a;
+	const struct roots_view *view_b = *(struct roots_view * const *)b;
+	if (view_a->stack_serial == view_b->stack_serial) {
+		return 0;
+	}
+	return view_a->stack_serial > view_b->stack_serial ? -1 : 1;
+}
+
+static struct roots_view *grid_view_at(struct view_grid *grid,
+		struct wlr_list *candidates, double lx, double ly) {
+	struct wlr_list *views = view_grid_views_at(grid, lx, ly);
+	if (views == NULL) {
+		return NULL;
+	}
+
+	candidates->length = 0;
+	for (size_t i = 0; i < views->length; ++i) {
+		struct roots_view *view = views->items[i];
+		if (wlr_box_contains_point(&view->hit_box, lx, ly)) {
+			wlr_list_push(candidates, view);
+		}
+	}
+	wlr_list_qsort(candidates, view_stack_cmp);
+	return candidates->length > 0 ? candidates->items[0] : NULL;
+}
+
+static struct roots_view *linear_view_at(struct roots_view **views,
+		size_t n_views, double lx, double ly) {
+	// Top-most is last
+	for (size_t i = n_views; i-- > 0;) {
+		if (wlr_box_contains_point(&views[i]->hit_box, lx, ly)) {
+			return views[i];
+		}
+	}
+	return NULL;
+}
+
+static int64_t get_time_nsec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+	size_t n_views = 200, n_queries = 1000000;
+	int width = 2 * 3840, height = 2160;
+
+	int c;
+	while ((c = getopt(argc, argv, "n:q:w:h:")) != -1) {
+		switch (c) {
+		case 'n':
+			n_views = strtoul(optarg, NULL, 10);
+			break;
+		case 'q':
+			n_queries = strtoul(optarg, NULL, 10);
+			break;
+		case 'w':
+			width = atoi(optarg);
+			break;
+		case 'h':
+			height = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n views] [-q queries] "
+				"[-w width] [-h height]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (n_views == 0 || n_queries == 0 || width <= 0 || height <= 0) {
+		fprintf(stderr, "invalid arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	srand(42);
+
+	struct view_grid grid;
+	struct wlr_list candidates;
+	if (!view_grid_init(&grid) || !wlr_list_init(&candidates)) {
+		return EXIT_FAILURE;
+	}
+
+	struct roots_view **views = calloc(n_views, sizeof(struct roots_view *));
+	if (views == NULL) {
+		return EXIT_FAILURE;
+	}
+	for (size_t i = 0; i < n_views; ++i) {
+		struct roots_view *view = calloc(1, sizeof(struct roots_view));
+		if (view == NULL) {
+			return EXIT_FAILURE;
+		}
+		view->stack_serial = i + 1;
+		view->hit_box.width = 200 + rand() % 1000;
+		view->hit_box.height = 150 + rand() % 700;
+		view->hit_box.x = rand() % width - view->hit_box.width / 2;
+		view->hit_box.y = rand() % height - view->hit_box.height / 2;
+		view_grid_update_view(&grid, view, &view->hit_box);
+		views[i] = view;
+	}
+
+	double *points = calloc(2 * n_queries, sizeof(double));
+	if (points == NULL) {
+		return EXIT_FAILURE;
+	}
+	for (size_t i = 0; i < n_queries; ++i) {
+		points[2 * i] = (double)rand() / RAND_MAX * width;
+		points[2 * i + 1] = (double)rand() / RAND_MAX * height;
+	}
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < n_queries && i < 10000; ++i) {
+		double lx = points[2 * i], ly = points[2 * i + 1];
+		if (grid_view_at(&grid, &candidates, lx, ly) !=
+				linear_view_at(views, n_views, lx, ly)) {
+			mismatches++;
+		}
+	}
+	if (mismatches > 0) {
+		fprintf(stderr, "%zu lookups differ between grid and linear scan\n",
+			mismatches);
+		return EXIT_FAILURE;
+	}
+
+	size_t hits = 0;
+	int64_t start = get_time_nsec();
+	for (size_t i = 0; i < n_queries; ++i) {
+		hits += grid_view_at(&grid, &candidates,
+			points[2 * i], points[2 * i + 1]) != NULL;
+	}
+	int64_t grid_nsec = get_time_nsec() - start;
+
+	start = get_time_nsec();
+	for (size_t i = 0; i < n_queries; ++i) {
+		hits += linear_view_at(views, n_views,
+			points[2 * i], points[2 * i + 1]) != NULL;
+	}
+	int64_t linear_nsec = get_time_nsec() - start;
+
+	printf("%zu views, %zu grid cells, %zu queries (%zu hits)\n", n_views,
+		grid.n_cells, n_queries, hits / 2);
+	printf("grid:   %.1f ns/lookup\n", (double)grid_nsec / n_queries);
+	printf("linear: %.1f ns/lookup\n", (double)linear_nsec / n_queries);
+
+	for (size_t i = 0; i < n_views; ++i) {
+		free(views[i]);
+	}
+	free(views);
+	free(points);
+	wlr_list_finish(&candidates);
+	view_grid_finish(&grid);
+	return EXIT_SUCCESS;
+}
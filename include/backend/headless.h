@@ -1,10 +1,13 @@
 #ifndef BACKEND_HEADLESS_H
 #define BACKEND_HEADLESS_H
 
+#include <GLES2/gl2.h>
+#include <time.h>
 #include <wlr/backend/headless.h>
 #include <wlr/backend/interface.h>
 
 #define HEADLESS_DEFAULT_REFRESH (60 * 1000) // 60 Hz
+#define HEADLESS_DEFAULT_BUFFERS 2
 
 struct wlr_headless_backend {
 	struct wlr_backend backend;
@@ -15,6 +18,19 @@ struct wlr_headless_backend {
 	struct wl_list input_devices;
 	struct wl_listener display_destroy;
 	bool started;
+
+	enum wlr_headless_clock_mode clock_mode;
+	struct timespec virtual_time; // only used with a virtual clock
+	int clock_fd; // eventfd waking up the fast-forward loop
+	struct wl_event_source *clock_source;
+
+	struct wlr_headless_replay *replay; // NULL if not replaying input
+	uint64_t replay_serial; // incremented when a replay is destroyed
+};
+
+struct wlr_headless_buffer {
+	GLuint fbo, tex;
+	uint64_t seq; // swap sequence number of the last present, 0 if never
 };
 
 struct wlr_headless_output {
@@ -24,8 +40,18 @@ struct wlr_headless_output {
 	struct wl_list link;
 
 	void *egl_surface;
+	struct wlr_headless_buffer buffers[WLR_HEADLESS_MAX_BUFFERS];
+	size_t n_buffers;
+	size_t back; // buffer being rendered to
+	size_t front; // last presented buffer, valid if seq > 0
+	uint64_t seq; // number of swaps since the buffers were (re)created
+	struct timespec last_present;
+	// client buffer presented instead of the front buffer, if any
+	struct wlr_buffer *scanout_buffer;
+
 	struct wl_event_source *frame_timer;
-	int frame_delay; // ms
+	struct timespec vblank_base; // time of the vblank numbered 0
+	uint64_t vblank_seq; // number of the next vblank
 };
 
 struct wlr_headless_input_device {
@@ -34,4 +60,21 @@ struct wlr_headless_input_device {
 	struct wlr_headless_backend *backend;
 };
 
+void reset_headless_vblank(struct wlr_headless_output *output);
+void schedule_headless_vblank(struct wlr_headless_output *output);
+void get_headless_next_vblank(struct wlr_headless_output *output,
+	struct timespec *when);
+void wake_headless_clock(struct wlr_headless_backend *backend);
+
+struct wlr_input_device *headless_add_input_device(
+	struct wlr_headless_backend *backend, enum wlr_input_device_type type,
+	const char *name);
+void start_headless_replay(struct wlr_headless_backend *backend);
+/**
+ * Emits the replayed input events which are due at the current time of the
+ * backend's clock.
+ */
+void update_headless_replay(struct wlr_headless_backend *backend);
+void destroy_headless_replay(struct wlr_headless_backend *backend);
+
 #endif
@@ -16,6 +16,8 @@ struct wlr_libinput_backend {
 
 	struct libinput *libinput_context;
 	struct wl_event_source *input_event;
+	bool use_thread;
+	struct wlr_libinput_thread *thread; // NULL if read on the main thread
 
 	struct wl_listener display_destroy;
 	struct wl_listener session_signal;
@@ -31,6 +33,15 @@ struct wlr_libinput_input_device {
 
 uint32_t usec_to_msec(uint64_t usec);
 
+bool start_libinput_thread(struct wlr_libinput_backend *backend);
+void stop_libinput_thread(struct wlr_libinput_backend *backend);
+/**
+ * Must surround libinput calls made on the main thread outside of event
+ * handlers, if events are read on a dedicated thread.
+ */
+void lock_libinput(struct wlr_libinput_backend *backend);
+void unlock_libinput(struct wlr_libinput_backend *backend);
+
 void handle_libinput_event(struct wlr_libinput_backend *state,
 		struct libinput_event *event);
 
@@ -0,0 +1,47 @@
+#ifndef ROOTSTON_BINDINGS_H
+#define ROOTSTON_BINDINGS_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server.h>
+#include <xkbcommon/xkbcommon.h>
+
+struct roots_binding_config;
+
+struct binding_table_entry {
+	struct roots_binding_config *binding; // NULL if the slot is free
+	xkb_keysym_t *keysyms; // sorted
+	uint64_t hash;
+	size_t order; // position in the bindings list
+};
+
+/**
+ * Indexes key bindings by their modifiers and set of keysyms, so that the
+ * binding matching the pressed keys is found without testing all of them.
+ * When several bindings match, the first one in the list wins, like when
+ * walking the list.
+ */
+struct binding_table {
+	struct wl_list *bindings; // roots_binding_config::link
+	struct binding_table_entry *entries; // NULL if everything is in fallback
+	size_t n_entries; // power of two
+	// Bindings which can't be indexed, because a keysym is repeated
+	struct binding_table_entry *fallback;
+	size_t n_fallback;
+};
+
+/**
+ * Builds the table from a list of bindings. If this fails, lookups walk the
+ * list instead.
+ */
+void binding_table_init(struct binding_table *table,
+	struct wl_list *bindings);
+void binding_table_finish(struct binding_table *table);
+/**
+ * Returns the binding triggered by the pressed keysyms, which must not contain
+ * XKB_KEY_NoSymbol or duplicates, or NULL if there is none.
+ */
+struct roots_binding_config *binding_table_find(struct binding_table *table,
+	uint32_t modifiers, const xkb_keysym_t *pressed, size_t pressed_len);
+
+#endif
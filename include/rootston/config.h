@@ -3,8 +3,10 @@
 
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_output_layout.h>
+#include "rootston/bindings.h"
 
 #define ROOTS_CONFIG_DEFAULT_SEAT_NAME "seat0"
+#define ROOTS_XWAYLAND_PRESTART_DELAY 1000 // ms
 
 struct roots_output_config {
 	char *name;
@@ -55,22 +57,30 @@ struct roots_cursor_config {
 	struct wlr_box *mapped_box;
 	char *theme;
 	char *default_image;
+	bool coalesce_motion;
+	uint32_t coalesce_motion_interval; // ms, 0 to coalesce per event loop turn
 	struct wl_list link;
 };
 
 struct roots_config {
 	bool xwayland;
 	bool xwayland_lazy;
+	int xwayland_prestart_delay; // ms, -1 to wait for the first X11 client
 
 	struct wl_list outputs;
 	struct wl_list devices;
 	struct wl_list bindings;
+	struct binding_table binding_table;
 	struct wl_list keyboards;
 	struct wl_list cursors;
 
 	char *config_path;
 	char *startup_cmd;
 	bool debug_damage_tracking;
+	uint32_t input_latency_log_interval; // seconds, 0 to disable
+	size_t selection_cache_size; // bytes, 0 to disable
+	char *record_input_path;
+	bool render_threads; // render each output on its own thread
 };
 
 /**
@@ -27,9 +27,17 @@
 #include "rootston/config.h"
 #include "rootston/output.h"
 #include "rootston/view.h"
+#include "rootston/view_grid.h"
 
 struct roots_desktop {
 	struct wl_list views; // roots_view::link
+	uint32_t view_stack_serial; // of the top-most view
+
+	// Views by position, for hit testing. Views whose position or size
+	// changed are only moved in the grid on the next lookup.
+	struct view_grid view_grid;
+	struct wl_list dirty_views; // roots_view::hit_box_link
+	struct wlr_list hit_candidates;
 
 	struct wl_list outputs; // roots_output::link
 	struct timespec last_frame;
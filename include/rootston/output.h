@@ -5,6 +5,7 @@
 #include <wayland-server.h>
 #include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_output_damage.h>
+#include <wlr/types/wlr_output_render_thread.h>
 
 struct roots_desktop;
 
@@ -21,11 +22,20 @@ struct roots_output {
 
 	struct wlr_box usable_area;
 
+	// set if the output is rendered on its own thread, see render-threads
+	struct wlr_output_render_thread *render_thread;
+	bool render_thread_failed; // fall back to the main thread
+	// the frame being rendered by render_thread
+	struct wl_array render_ops; // struct roots_render_op
+	pixman_region32_t render_damage;
+	struct timespec render_when;
+
 	struct wl_listener destroy;
 	struct wl_listener mode;
 	struct wl_listener transform;
 	struct wl_listener damage_frame;
 	struct wl_listener damage_destroy;
+	struct wl_listener render_done;
 };
 
 void handle_new_output(struct wl_listener *listener, void *data);
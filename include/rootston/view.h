@@ -128,6 +128,15 @@ struct roots_view {
 	struct wlr_surface *wlr_surface;
 	struct wl_list children; // roots_view_child::link
 
+	// Hit testing, see desktop_surface_at
+	uint32_t stack_serial; // views with a higher serial are on top
+	struct wlr_box hit_box; // everything that can be hit, in layout coordinates
+	struct wl_list hit_box_link; // roots_desktop::dirty_views, if outdated
+	struct {
+		bool indexed;
+		int x1, y1, x2, y2; // cells the view is in, inclusive
+	} grid;
+
 	struct wl_listener new_subsurface;
 
 	struct {
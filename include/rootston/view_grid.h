@@ -0,0 +1,47 @@
+#ifndef ROOTSTON_VIEW_GRID_H
+#define ROOTSTON_VIEW_GRID_H
+#include <stdbool.h>
+#include <wayland-server.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_list.h>
+
+/**
+ * Size of the grid cells in layout coordinates.
+ */
+#define VIEW_GRID_CELL_SIZE 256
+
+/**
+ * A uniform grid over layout coordinates, used to find the views that may be
+ * under a point without testing all of them. Cells are created on demand, so
+ * the grid works for any layout.
+ */
+struct view_grid {
+	struct wl_list *buckets; // view_grid_cell::link
+	size_t n_buckets; // power of two
+	size_t n_cells;
+};
+
+struct view_grid_cell {
+	int x, y;
+	struct wlr_list views; // roots_view *
+	struct wl_list link;
+};
+
+struct roots_view;
+
+bool view_grid_init(struct view_grid *grid);
+void view_grid_finish(struct view_grid *grid);
+/**
+ * Adds a view to all the cells its box overlaps, or moves it there if it's
+ * already in the grid.
+ */
+void view_grid_update_view(struct view_grid *grid, struct roots_view *view,
+	const struct wlr_box *box);
+void view_grid_remove_view(struct view_grid *grid, struct roots_view *view);
+/**
+ * Returns the views whose box may contain the point, in no particular order.
+ */
+struct wlr_list *view_grid_views_at(struct view_grid *grid, double lx,
+	double ly);
+
+#endif
@@ -26,6 +26,16 @@ struct wlr_data_offer *data_source_send_offer(struct wlr_data_source *source,
 	struct wlr_seat_client *target);
 void data_source_notify_finish(struct wlr_data_source *source);
 
+struct wlr_data_source_cache *data_source_cache_create(
+	struct wl_event_loop *event_loop, size_t max_size);
+void data_source_cache_destroy(struct wlr_data_source_cache *cache);
+/**
+ * Sends the data from the cache if it has it, otherwise asks the source and
+ * caches its data on the way.
+ */
+void data_source_cache_send(struct wlr_data_source *source,
+	const char *mime_type, int32_t fd);
+
 bool seat_client_start_drag(struct wlr_seat_client *client,
 	struct wlr_data_source *source, struct wlr_surface *icon_surface,
 	struct wlr_surface *origin, uint32_t serial);
@@ -0,0 +1,29 @@
+#ifndef TYPES_WLR_INPUT_LATENCY_H
+#define TYPES_WLR_INPUT_LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <wlr/types/wlr_input_latency.h>
+
+/**
+ * Called by the seat after sending an input event to `surface`, which is NULL
+ * if no client received it. If `wait_response` is set, the event may be
+ * tracked until the surface commits.
+ */
+void input_latency_handle_event(struct wlr_input_latency *latency,
+	uint32_t time_msec, struct wlr_surface *surface, bool wait_response);
+/**
+ * Called by backends around the handling of an input event which was received
+ * at `arrival`, on CLOCK_MONOTONIC. Events sent by seats in between are timed
+ * from their arrival instead of their timestamp.
+ */
+void input_latency_begin_event(const struct timespec *arrival);
+void input_latency_end_event(void);
+/**
+ * Gets the arrival time of the input event being handled, if any. Returns
+ * false outside of input_latency_begin_event and input_latency_end_event.
+ */
+bool input_latency_get_event_arrival(struct timespec *arrival);
+
+#endif
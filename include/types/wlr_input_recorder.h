@@ -0,0 +1,136 @@
+#ifndef TYPES_WLR_INPUT_RECORDER_H
+#define TYPES_WLR_INPUT_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Input recordings start with this magic and a version number. Records
+ * follow, each made of a header and a payload whose size depends on the type.
+ * Everything is stored in host byte order.
+ */
+#define INPUT_RECORDING_MAGIC "WLRINPUT"
+#define INPUT_RECORDING_VERSION 1
+
+enum input_record_type {
+	INPUT_RECORD_DEVICE_ADDED = 1,
+	INPUT_RECORD_DEVICE_REMOVED,
+	INPUT_RECORD_POINTER_MOTION,
+	INPUT_RECORD_POINTER_MOTION_ABSOLUTE,
+	INPUT_RECORD_POINTER_BUTTON,
+	INPUT_RECORD_POINTER_AXIS,
+	INPUT_RECORD_KEYBOARD_KEY,
+	INPUT_RECORD_TOUCH_DOWN,
+	INPUT_RECORD_TOUCH_UP,
+	INPUT_RECORD_TOUCH_MOTION,
+	INPUT_RECORD_TOUCH_CANCEL,
+	INPUT_RECORD_TABLET_TOOL_AXIS,
+	INPUT_RECORD_TABLET_TOOL_PROXIMITY,
+	INPUT_RECORD_TABLET_TOOL_TIP,
+	INPUT_RECORD_TABLET_TOOL_BUTTON,
+	INPUT_RECORD_TYPE_COUNT,
+};
+
+struct input_record_header {
+	uint8_t type; // enum input_record_type
+	uint8_t reserved;
+	uint16_t device; // assigned in INPUT_RECORD_DEVICE_ADDED order
+	uint32_t delta_usec; // since the previous record
+};
+
+// Followed by name_len bytes of device name
+struct input_record_device_added {
+	uint32_t type; // enum wlr_input_device_type
+	uint32_t name_len;
+};
+
+struct input_record_pointer_motion {
+	double delta_x, delta_y;
+};
+
+struct input_record_pointer_motion_absolute {
+	double x, y;
+};
+
+struct input_record_button {
+	uint32_t button;
+	uint32_t state;
+};
+
+struct input_record_pointer_axis {
+	double delta;
+	int32_t delta_discrete;
+	uint16_t source;
+	uint16_t orientation;
+};
+
+struct input_record_keyboard_key {
+	uint32_t keycode;
+	uint8_t state;
+	uint8_t update_state;
+	uint16_t reserved;
+};
+
+struct input_record_touch {
+	double x, y; // unused for up and cancel
+	int32_t touch_id;
+	uint32_t reserved;
+};
+
+struct input_record_tablet_tool_axis {
+	double x, y;
+	double pressure;
+	double distance;
+	double tilt_x, tilt_y;
+	double rotation;
+	double slider;
+	double wheel_delta;
+	uint32_t updated_axes;
+	uint32_t reserved;
+};
+
+// Used for both proximity and tip events
+struct input_record_tablet_tool_state {
+	double x, y;
+	uint32_t state;
+	uint32_t reserved;
+};
+
+/**
+ * Returns the size of the fixed part of the payload of a record type.
+ * INPUT_RECORD_DEVICE_REMOVED has an empty payload.
+ */
+static inline size_t input_record_payload_size(enum input_record_type type) {
+	switch (type) {
+	case INPUT_RECORD_DEVICE_ADDED:
+		return sizeof(struct input_record_device_added);
+	case INPUT_RECORD_DEVICE_REMOVED:
+		return 0;
+	case INPUT_RECORD_POINTER_MOTION:
+		return sizeof(struct input_record_pointer_motion);
+	case INPUT_RECORD_POINTER_MOTION_ABSOLUTE:
+		return sizeof(struct input_record_pointer_motion_absolute);
+	case INPUT_RECORD_POINTER_BUTTON:
+	case INPUT_RECORD_TABLET_TOOL_BUTTON:
+		return sizeof(struct input_record_button);
+	case INPUT_RECORD_POINTER_AXIS:
+		return sizeof(struct input_record_pointer_axis);
+	case INPUT_RECORD_KEYBOARD_KEY:
+		return sizeof(struct input_record_keyboard_key);
+	case INPUT_RECORD_TOUCH_DOWN:
+	case INPUT_RECORD_TOUCH_UP:
+	case INPUT_RECORD_TOUCH_MOTION:
+	case INPUT_RECORD_TOUCH_CANCEL:
+		return sizeof(struct input_record_touch);
+	case INPUT_RECORD_TABLET_TOOL_AXIS:
+		return sizeof(struct input_record_tablet_tool_axis);
+	case INPUT_RECORD_TABLET_TOOL_PROXIMITY:
+	case INPUT_RECORD_TABLET_TOOL_TIP:
+		return sizeof(struct input_record_tablet_tool_state);
+	case INPUT_RECORD_TYPE_COUNT:
+		break;
+	}
+	return 0;
+}
+
+#endif
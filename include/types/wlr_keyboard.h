@@ -0,0 +1,46 @@
+#ifndef TYPES_WLR_KEYBOARD_H
+#define TYPES_WLR_KEYBOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <xkbcommon/xkbcommon.h>
+
+/**
+ * A serialized keymap in a sealed file. Keyboards with identical keymaps share
+ * the same file, so that it's only created once and clients which already
+ * received it can be recognized by its ID.
+ */
+struct wlr_keymap_file {
+	uint64_t id; // never reused
+	uint64_t hash;
+	int fd;
+	size_t size;
+	const void *data; // read-only mapping of the file
+	int refcount;
+};
+
+/**
+ * Returns a file holding the given data, shared with any previous call with
+ * the same contents.
+ */
+struct wlr_keymap_file *keymap_file_get(const char *str, size_t size);
+struct wlr_keymap_file *keymap_file_ref(struct wlr_keymap_file *file);
+void keymap_file_unref(struct wlr_keymap_file *file);
+
+/**
+ * Compiles a keymap from its text, or returns the one compiled previously from
+ * the same text. The caller owns the returned reference.
+ */
+struct xkb_keymap *keymap_cache_new_from_buffer(const char *buf, size_t size);
+/**
+ * Returns a new reference to the serialized file of a keymap, if it was
+ * compiled by the cache and already serialized.
+ */
+struct wlr_keymap_file *keymap_cache_get_file(struct xkb_keymap *keymap);
+/**
+ * Remembers the serialized file of a keymap compiled by the cache.
+ */
+void keymap_cache_set_file(struct xkb_keymap *keymap,
+	struct wlr_keymap_file *file);
+
+#endif
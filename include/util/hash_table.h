@@ -0,0 +1,52 @@
+#ifndef UTIL_HASH_TABLE_H
+#define UTIL_HASH_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct hash_table_entry {
+	uint64_t key;
+	void *value; // NULL if the slot is free
+};
+
+/**
+ * An open addressing hash table mapping integer keys, such as pointers or X11
+ * IDs, to non-NULL values.
+ */
+struct hash_table {
+	struct hash_table_entry *entries;
+	size_t cap; // power of two, or zero if nothing has been inserted yet
+	size_t len;
+};
+
+void hash_table_init(struct hash_table *table);
+void hash_table_finish(struct hash_table *table);
+/**
+ * Returns the value associated with the key, or NULL if there is none.
+ */
+void *hash_table_get(const struct hash_table *table, uint64_t key);
+/**
+ * Associates the value with the key, replacing any previous value. The value
+ * must not be NULL. Returns false on allocation failure.
+ */
+bool hash_table_set(struct hash_table *table, uint64_t key, void *value);
+/**
+ * Removes the key from the table and returns its value, or NULL if there was
+ * none.
+ */
+void *hash_table_remove(struct hash_table *table, uint64_t key);
+
+static inline uint64_t hash_table_ptr_key(const void *ptr) {
+	return (uint64_t)(uintptr_t)ptr;
+}
+
+#define HASH_BYTES_INIT 0xcbf29ce484222325
+
+/**
+ * Feeds `size` bytes to a FNV-1a hash and returns the result. Start with
+ * HASH_BYTES_INIT, and pass the previous result to hash data in pieces.
+ */
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t size);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef UTIL_TIME_H
+#define UTIL_TIME_H
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Converts a timespec to nanoseconds.
+ */
+int64_t timespec_to_nsec(const struct timespec *a);
+/**
+ * Converts nanoseconds to a timespec.
+ */
+void timespec_from_nsec(struct timespec *r, int64_t nsec);
+/**
+ * Subtracts timespec `b` from timespec `a`, and stores the difference in `r`.
+ */
+void timespec_sub(struct timespec *r, const struct timespec *a,
+	const struct timespec *b);
+
+#endif
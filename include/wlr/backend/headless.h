@@ -1,10 +1,24 @@
 #ifndef WLR_BACKEND_HEADLESS_H
 #define WLR_BACKEND_HEADLESS_H
 
+#include <stdbool.h>
+#include <time.h>
 #include <wlr/backend.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_output.h>
 
+#define WLR_HEADLESS_MAX_BUFFERS 4
+
+enum wlr_headless_clock_mode {
+	// Frames follow the monotonic system clock (default)
+	WLR_HEADLESS_CLOCK_REALTIME,
+	// Frames are only emitted by wlr_headless_backend_step
+	WLR_HEADLESS_CLOCK_MANUAL,
+	// The virtual clock jumps to the next vblank whenever the event loop is
+	// idle, so frames are emitted as fast as the compositor can render
+	WLR_HEADLESS_CLOCK_FAST_FORWARD,
+};
+
 /**
  * Creates a headless backend. A headless backend has no outputs or inputs by
  * default.
@@ -12,12 +26,54 @@
 struct wlr_backend *wlr_headless_backend_create(struct wl_display *display,
 	wlr_renderer_create_func_t create_renderer_func);
 /**
- * Create a new headless output backed by an in-memory EGL framebuffer. You can
- * read pixels from this framebuffer via wlr_renderer_read_pixels but it is
- * otherwise not displayed.
+ * Sets the clock driving the headless outputs' frame events. With a virtual
+ * clock, time starts at `start` (or zero if NULL) and vblank and present
+ * timestamps are exact multiples of each output's refresh period.
+ */
+bool wlr_headless_backend_set_clock_mode(struct wlr_backend *backend,
+	enum wlr_headless_clock_mode mode, const struct timespec *start);
+/**
+ * Advances the virtual clock through the next `frames` vblanks, across all
+ * outputs and in chronological order. A frame event is emitted for each of
+ * them. The backend must be started and use a virtual clock.
+ */
+void wlr_headless_backend_step(struct wlr_backend *backend,
+	unsigned int frames);
+/**
+ * Gets the current time of the clock driving the backend. Compositors should
+ * use it for frame timestamps to get reproducible results with a virtual
+ * clock.
+ */
+void wlr_headless_backend_get_time(struct wlr_backend *backend,
+	struct timespec *now);
+/**
+ * Create a new headless output backed by a swapchain of in-memory framebuffers.
+ * You can read pixels from the buffer being rendered via
+ * wlr_renderer_read_pixels but it is otherwise not displayed.
  */
 struct wlr_output *wlr_headless_add_output(struct wlr_backend *backend,
 	unsigned int width, unsigned int height);
+/**
+ * Sets the number of offscreen buffers the headless output cycles through,
+ * between 1 and WLR_HEADLESS_MAX_BUFFERS. The buffer age reported by
+ * wlr_output_make_current reflects this swapchain, which makes it possible to
+ * exercise damage tracking. Resets the contents of all buffers.
+ */
+bool wlr_headless_output_set_buffer_count(struct wlr_output *output,
+	size_t count);
+/**
+ * Gets the CLOCK_MONOTONIC time at which the last frame was presented. Returns
+ * false if no frame has been presented yet.
+ */
+bool wlr_headless_output_get_last_present(struct wlr_output *output,
+	struct timespec *when);
+/**
+ * Reads pixels from the last presented buffer into `data`. `stride` is in
+ * bytes. Returns false if no frame has been presented yet.
+ */
+bool wlr_headless_output_read_presented_pixels(struct wlr_output *output,
+	enum wl_shm_format fmt, uint32_t stride, uint32_t width, uint32_t height,
+	void *data);
 /**
  * Creates a new input device. The caller is responsible for manually raising
  * any event signals on the new input device if it wants to simulate input
@@ -25,6 +81,22 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *backend,
  */
 struct wlr_input_device *wlr_headless_add_input_device(
 	struct wlr_backend *backend, enum wlr_input_device_type type);
+/**
+ * Replays input recorded with wlr_input_recorder from the file at `path`. The
+ * recorded devices are added to the backend and their events are emitted with
+ * the recorded delays divided by `speed`. Devices still present at the end of
+ * the replay are removed. With a virtual clock, events are
+ * emitted as the clock goes past them, before the frame event of the vblank it
+ * advanced to, so that replays are deterministic. Replaying starts when the
+ * backend is started, or immediately if it already is, and stops any previous
+ * replay.
+ */
+bool wlr_headless_backend_replay_input(struct wlr_backend *backend,
+	const char *path, double speed);
+/**
+ * Returns true until all events of the current replay have been emitted.
+ */
+bool wlr_headless_backend_is_replaying(struct wlr_backend *backend);
 bool wlr_backend_is_headless(struct wlr_backend *backend);
 bool wlr_input_device_is_headless(struct wlr_input_device *device);
 bool wlr_output_is_headless(struct wlr_output *output);
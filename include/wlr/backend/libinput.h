@@ -9,6 +9,18 @@
 
 struct wlr_backend *wlr_libinput_backend_create(struct wl_display *display,
 		struct wlr_session *session);
+/**
+ * Reads libinput events on a dedicated thread, which drains them from the
+ * kernel while the main thread is busy. Events are still handled on the main
+ * thread and in order. Must be called before the backend is started, defaults
+ * to true if the WLR_LIBINPUT_THREAD environment variable is set to 1.
+ *
+ * libinput isn't thread-safe: with a dedicated thread, libinput devices must
+ * only be configured from the new_input signal handler or from input event
+ * handlers.
+ */
+void wlr_libinput_backend_set_input_thread(struct wlr_backend *backend,
+		bool enabled);
 /** Gets the underlying libinput_device handle for the given wlr_input_device */
 struct libinput_device *wlr_libinput_get_device_handle(
 		struct wlr_input_device *dev);
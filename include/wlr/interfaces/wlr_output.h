@@ -25,6 +25,13 @@ struct wlr_output_impl {
 	uint32_t (*get_gamma_size)(struct wlr_output *output);
 	bool (*export_dmabuf)(struct wlr_output *output,
 		struct wlr_dmabuf_attributes *attribs);
+	/**
+	 * Displays the client buffer directly instead of the rendering buffers.
+	 * On success, the next call to make_current must report a buffer age of
+	 * zero.
+	 */
+	bool (*present_buffer)(struct wlr_output *output,
+		struct wlr_buffer *buffer);
 };
 
 void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
@@ -18,6 +18,7 @@ struct wlr_egl {
 	struct {
 		bool bind_wayland_display_wl;
 		bool buffer_age_ext;
+		bool fence_sync_khr;
 		bool image_base_khr;
 		bool image_dma_buf_export_mesa;
 		bool image_dmabuf_import_ext;
@@ -95,6 +96,35 @@ bool wlr_egl_make_current(struct wlr_egl *egl, EGLSurface surface,
 
 bool wlr_egl_is_current(struct wlr_egl *egl);
 
+/**
+ * Creates a context in the share group of the main one, and uses it instead on
+ * the calling thread: `wlr_egl_make_current` and `wlr_egl_is_current` refer to
+ * it from now on. This allows another thread than the one which initialized
+ * the wlr_egl to render with the same textures. Framebuffers aren't shared, and
+ * shader programs hold uniforms, so each thread needs its own renderer.
+ */
+bool wlr_egl_bind_thread(struct wlr_egl *egl);
+
+/**
+ * Destroys the context created for the calling thread by
+ * `wlr_egl_bind_thread`.
+ */
+void wlr_egl_unbind_thread(struct wlr_egl *egl);
+
+/**
+ * Inserts a fence after the commands issued so far by the current context, so
+ * that another thread can wait for them with `wlr_egl_wait_fence` before
+ * using what they produced. If fences aren't supported, waits for the commands
+ * to complete and returns EGL_NO_SYNC_KHR.
+ */
+EGLSyncKHR wlr_egl_create_fence(struct wlr_egl *egl);
+
+/**
+ * Waits for a fence created by `wlr_egl_create_fence` to be signaled, and
+ * destroys it.
+ */
+void wlr_egl_wait_fence(struct wlr_egl *egl, EGLSyncKHR fence);
+
 bool wlr_egl_swap_buffers(struct wlr_egl *egl, EGLSurface surface,
 	pixman_region32_t *damage);
 
@@ -7,6 +7,11 @@
 struct wlr_egl;
 
 struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl);
+bool wlr_renderer_is_gles2(struct wlr_renderer *renderer);
+/**
+ * Gets the EGL instance the renderer draws with.
+ */
+struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *renderer);
 
 struct wlr_texture *wlr_gles2_texture_from_pixels(struct wlr_egl *egl,
 	enum wl_shm_format wl_fmt, uint32_t stride, uint32_t width, uint32_t height,
@@ -15,5 +20,7 @@ struct wlr_texture *wlr_gles2_texture_from_wl_drm(struct wlr_egl *egl,
 	struct wl_resource *data);
 struct wlr_texture *wlr_gles2_texture_from_dmabuf(struct wlr_egl *egl,
 	struct wlr_dmabuf_attributes *attribs);
+struct wlr_texture *wlr_gles2_texture_from_framebuffer(struct wlr_egl *egl,
+	int32_t x, int32_t y, uint32_t width, uint32_t height);
 
 #endif
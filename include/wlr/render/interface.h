@@ -46,6 +46,10 @@ struct wlr_renderer_impl {
 		struct wl_resource *data);
 	struct wlr_texture *(*texture_from_dmabuf)(struct wlr_renderer *renderer,
 		struct wlr_dmabuf_attributes *attribs);
+	struct wlr_texture *(*texture_from_framebuffer)(
+		struct wlr_renderer *renderer, const struct wlr_box *box);
+	bool (*texture_write_framebuffer)(struct wlr_renderer *renderer,
+		struct wlr_texture *texture, const struct wlr_box *box);
 	void (*destroy)(struct wlr_renderer *renderer);
 	void (*init_wl_display)(struct wlr_renderer *renderer,
 		struct wl_display *wl_display);
@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <wayland-server-protocol.h>
 #include <wlr/render/dmabuf.h>
+#include <wlr/types/wlr_box.h>
 
 struct wlr_renderer;
 struct wlr_texture_impl;
@@ -35,6 +36,22 @@ struct wlr_texture *wlr_texture_from_wl_drm(struct wlr_renderer *renderer,
 struct wlr_texture *wlr_texture_from_dmabuf(struct wlr_renderer *renderer,
 	struct wlr_dmabuf_attributes *attribs);
 
+/**
+ * Create a new texture from a region of the currently bound surface, without
+ * reading it back into main memory. `box` is in renderer coordinates, like the
+ * scissor box. Returns NULL if the renderer doesn't support it. The returned
+ * texture is immutable.
+ */
+struct wlr_texture *wlr_texture_from_framebuffer(struct wlr_renderer *renderer,
+	const struct wlr_box *box);
+
+/**
+ * Update a texture created by `wlr_texture_from_framebuffer` with a region of
+ * the currently bound surface. `box` must have the size of the texture.
+ */
+bool wlr_texture_write_framebuffer(struct wlr_renderer *renderer,
+	struct wlr_texture *texture, const struct wlr_box *box);
+
 /**
  * Get the texture width and height.
  */
@@ -6,6 +6,11 @@
 
 /**
  * A client buffer.
+ *
+ * References are taken and dropped on the main thread only. A render thread
+ * may sample `texture` while the main thread holds a reference on its behalf,
+ * see `wlr_output_render_thread`: the texture is neither updated in place nor
+ * destroyed meanwhile.
  */
 struct wlr_buffer {
 	/**
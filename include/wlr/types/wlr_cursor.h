@@ -104,6 +104,19 @@ void wlr_cursor_warp_absolute(struct wlr_cursor *cur,
 void wlr_cursor_move(struct wlr_cursor *cur, struct wlr_input_device *dev,
 	double delta_x, double delta_y);
 
+/**
+ * Enables coalescing of pointer motion events. Relative motion from a device
+ * is summed and absolute motion is replaced by the latest position, keeping the
+ * timestamp of the latest event. The result is emitted once all pending events
+ * of `loop` have been dispatched, or every `interval_ms` milliseconds if it's
+ * not zero. Pending motion is always emitted before any other event of this
+ * cursor, so the order of events is preserved.
+ *
+ * Coalescing is disabled if `loop` is NULL, which is the default.
+ */
+void wlr_cursor_set_motion_coalescing(struct wlr_cursor *cur,
+	struct wl_event_loop *loop, uint32_t interval_ms);
+
 /**
  * Set the cursor image. stride is given in bytes. If pixels is NULL, hides the
  * cursor.
@@ -55,6 +55,8 @@ struct wlr_data_source_impl {
 		enum wl_data_device_manager_dnd_action action);
 };
 
+struct wlr_data_source_cache;
+
 struct wlr_data_source {
 	const struct wlr_data_source_impl *impl;
 
@@ -71,6 +73,9 @@ struct wlr_data_source {
 	enum wl_data_device_manager_dnd_action current_dnd_action;
 	uint32_t compositor_action;
 
+	// see wlr_seat_set_selection_cache_size, private
+	struct wlr_data_source_cache *cache;
+
 	struct {
 		struct wl_signal destroy;
 	} events;
@@ -168,6 +173,17 @@ void wlr_seat_client_send_selection(struct wlr_seat_client *seat_client);
 void wlr_seat_set_selection(struct wlr_seat *seat,
 	struct wlr_data_source *source, uint32_t serial);
 
+/**
+ * Keeps the data of the seat's selections in compositor memory, so that
+ * receiving a MIME type again doesn't ask the source to send it again. At most
+ * `max_size` bytes are kept per selection, 0 disables the cache, which is the
+ * default. Applies to the selections set afterwards.
+ *
+ * Cached data is written by the compositor straight into the pipes of the
+ * clients, so SIGPIPE must be ignored before enabling the cache.
+ */
+void wlr_seat_set_selection_cache_size(struct wlr_seat *seat, size_t max_size);
+
 /**
  * Initializes the data source with the provided implementation.
  */
@@ -0,0 +1,103 @@
+#ifndef WLR_TYPES_WLR_INPUT_LATENCY_H
+#define WLR_TYPES_WLR_INPUT_LATENCY_H
+
+#include <stdint.h>
+#include <wayland-server.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_seat.h>
+
+/**
+ * Samples are counted in buckets of microseconds. Each power of two is split
+ * in `WLR_LATENCY_HISTOGRAM_SUB_BUCKETS` buckets, so values are known within
+ * 12.5%.
+ */
+#define WLR_LATENCY_HISTOGRAM_SUB_BUCKETS 8
+#define WLR_LATENCY_HISTOGRAM_BUCKETS (30 * WLR_LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+struct wlr_latency_histogram {
+	uint64_t buckets[WLR_LATENCY_HISTOGRAM_BUCKETS];
+	uint64_t count;
+	int64_t sum_nsec, max_nsec;
+};
+
+void wlr_latency_histogram_add(struct wlr_latency_histogram *hist,
+	int64_t nsec);
+void wlr_latency_histogram_reset(struct wlr_latency_histogram *hist);
+/**
+ * Returns a latency in nanoseconds which is greater than or equal to the given
+ * percentile of the samples, from 0 to 100. Returns 0 if there are no samples.
+ */
+int64_t wlr_latency_histogram_percentile(
+	const struct wlr_latency_histogram *hist, double percentile);
+
+enum wlr_input_latency_stage {
+	// From the input event timestamp until the seat sends it to a client
+	WLR_INPUT_LATENCY_DISPATCH,
+	// Until the focused surface commits in response
+	WLR_INPUT_LATENCY_COMMIT,
+	// Until the first output frame swapped after that commit
+	WLR_INPUT_LATENCY_FRAME,
+	WLR_INPUT_LATENCY_STAGE_COUNT,
+};
+
+/**
+ * Measures the latency of input events going through a seat. Events are timed
+ * from the moment the backend received them. Events which don't come from a
+ * backend, such as virtual keyboard events, are timed from the timestamp they
+ * carry instead.
+ *
+ * Dispatch latency is sampled for every event. Commit and frame latency are
+ * sampled for key presses, button presses and touch down events, which
+ * usually get a visible response: the focused surface is tracked until its
+ * next commit, then until the next frame is swapped on any output of the
+ * layout. Only one event is tracked at a time. Samples longer than a second
+ * are discarded and counted in `dropped`.
+ */
+struct wlr_input_latency {
+	struct wlr_seat *seat;
+	struct wlr_output_layout *layout;
+	struct wlr_latency_histogram stages[WLR_INPUT_LATENCY_STAGE_COUNT];
+	uint64_t dropped;
+
+	// private state
+
+	enum {
+		WLR_INPUT_LATENCY_IDLE,
+		WLR_INPUT_LATENCY_WAIT_COMMIT,
+		WLR_INPUT_LATENCY_WAIT_FRAME,
+	} state;
+	int64_t event_start_nsec; // on CLOCK_MONOTONIC
+	struct wlr_surface *surface;
+
+	struct wl_list outputs; // wlr_input_latency_output::link
+	struct wl_event_source *log_timer;
+	uint32_t log_interval_ms;
+
+	struct wl_listener surface_commit;
+	struct wl_listener surface_destroy;
+	struct wl_listener layout_add;
+	struct wl_listener layout_destroy;
+	struct wl_listener seat_destroy;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+};
+
+/**
+ * Starts measuring input latency on the seat. Frames are watched on the outputs
+ * of the layout. The tracker is destroyed with the seat.
+ */
+struct wlr_input_latency *wlr_input_latency_create(struct wlr_seat *seat,
+	struct wlr_output_layout *layout);
+void wlr_input_latency_destroy(struct wlr_input_latency *latency);
+void wlr_input_latency_reset(struct wlr_input_latency *latency);
+/**
+ * Logs percentiles of each stage every `interval_ms` milliseconds, or stops
+ * logging if zero.
+ */
+void wlr_input_latency_set_log_interval(struct wlr_input_latency *latency,
+	uint32_t interval_ms);
+void wlr_input_latency_log(struct wlr_input_latency *latency);
+
+#endif
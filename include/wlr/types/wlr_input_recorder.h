@@ -0,0 +1,45 @@
+#ifndef WLR_TYPES_WLR_INPUT_RECORDER_H
+#define WLR_TYPES_WLR_INPUT_RECORDER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <wayland-server.h>
+#include <wlr/backend.h>
+
+/**
+ * Records the events of every input device of a backend to a file, with the
+ * time elapsed between them. Recordings can be replayed with
+ * wlr_headless_backend_replay_input.
+ *
+ * Pointer, keyboard, touch and tablet tool events are recorded, tablet pads
+ * are not. Some consumers modify events in place, wlr_cursor for instance
+ * maps absolute coordinates to its output, so the recorder must be created
+ * before the backend is started and before anything else listens to its
+ * new_input signal.
+ */
+struct wlr_input_recorder {
+	struct wlr_backend *backend;
+
+	// private state
+
+	FILE *file;
+	struct wl_list devices; // wlr_input_recorder_device::link
+	uint16_t next_device_id;
+	int64_t last_record_nsec;
+
+	struct wl_listener new_input;
+	struct wl_listener backend_destroy;
+};
+
+/**
+ * Starts recording input events to the file at `path`, which is truncated.
+ * The recorder is destroyed with the backend.
+ */
+struct wlr_input_recorder *wlr_input_recorder_create(
+	struct wlr_backend *backend, const char *path);
+/**
+ * Stops recording and flushes the file.
+ */
+void wlr_input_recorder_destroy(struct wlr_input_recorder *recorder);
+
+#endif
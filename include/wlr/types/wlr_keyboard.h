@@ -31,6 +31,7 @@ enum wlr_keyboard_modifier {
 #define WLR_KEYBOARD_KEYS_CAP 32
 
 struct wlr_keyboard_impl;
+struct wlr_keymap_file;
 
 struct wlr_keyboard_modifiers {
 	xkb_mod_mask_t depressed;
@@ -44,6 +45,8 @@ struct wlr_keyboard {
 
 	int keymap_fd;
 	size_t keymap_size;
+	// shared by all keyboards with the same keymap
+	struct wlr_keymap_file *keymap_file;
 	struct xkb_keymap *keymap;
 	struct xkb_state *xkb_state;
 	xkb_led_index_t led_indexes[WLR_LED_COUNT];
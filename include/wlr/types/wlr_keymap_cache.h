@@ -0,0 +1,23 @@
+#ifndef WLR_TYPES_WLR_KEYMAP_CACHE_H
+#define WLR_TYPES_WLR_KEYMAP_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Keymaps sent by clients, e.g. by virtual keyboards, are compiled through a
+ * process-wide cache which keeps the most recently used ones. Keyboards using
+ * a cached keymap also share its serialized copy.
+ */
+struct wlr_keymap_cache_stats {
+	uint64_t hits, misses, evictions;
+	size_t entries, capacity;
+};
+
+void wlr_keymap_cache_get_stats(struct wlr_keymap_cache_stats *stats);
+/**
+ * Sets the number of keymaps kept in the cache, 0 disables it. Defaults to 16.
+ */
+void wlr_keymap_cache_set_capacity(size_t capacity);
+
+#endif
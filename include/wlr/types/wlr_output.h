@@ -6,8 +6,15 @@
 #include <time.h>
 #include <wayland-server.h>
 #include <wayland-util.h>
+#include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_linux_dmabuf.h>
 
+/**
+ * Number of frames for which the scene behind software cursors is kept: the
+ * frame being painted and up to three previous ones, for triple buffering.
+ */
+#define WLR_OUTPUT_CURSOR_BACKGROUNDS_LEN 4
+
 struct wlr_output_mode {
 	uint32_t flags; // enum wl_output_mode
 	int32_t width, height;
@@ -15,6 +22,12 @@ struct wlr_output_mode {
 	struct wl_list link;
 };
 
+struct wlr_output_cursor_background {
+	bool saved; // whether the cursor was drawn in this frame
+	struct wlr_box box; // in output-local coordinates
+	struct wlr_texture *texture; // the scene behind the cursor
+};
+
 struct wlr_output_cursor {
 	struct wlr_output *output;
 	double x, y;
@@ -32,6 +45,11 @@ struct wlr_output_cursor {
 	struct wl_listener surface_commit;
 	struct wl_listener surface_destroy;
 
+	// only when using a software cursor, indexed like the output's
+	// `cursor_backgrounds_valid`
+	struct wlr_output_cursor_background
+		backgrounds[WLR_OUTPUT_CURSOR_BACKGROUNDS_LEN];
+
 	struct {
 		struct wl_signal destroy;
 	} events;
@@ -100,6 +118,13 @@ struct wlr_output {
 	struct wl_list cursors; // wlr_output_cursor::link
 	struct wlr_output_cursor *hardware_cursor;
 
+	// circular queue telling which frames saved the scene behind all of their
+	// software cursors, see `wlr_output_restore_cursors`
+	bool cursor_backgrounds_valid[WLR_OUTPUT_CURSOR_BACKGROUNDS_LEN];
+	size_t cursor_backgrounds_idx; // frame being painted
+	// the scene behind software cursors was restored in the current buffer
+	bool cursors_restored;
+
 	// the output position in layout space reported to clients
 	int32_t lx, ly;
 
@@ -114,6 +139,7 @@ struct wlr_output_event_swap_buffers {
 	pixman_region32_t *damage;
 };
 
+struct wlr_buffer;
 struct wlr_surface;
 
 void wlr_output_enable(struct wlr_output *output, bool enable);
@@ -161,6 +187,35 @@ bool wlr_output_make_current(struct wlr_output *output, int *buffer_age);
  */
 bool wlr_output_swap_buffers(struct wlr_output *output, struct timespec *when,
 	pixman_region32_t *damage);
+/**
+ * Displays a client buffer as-is instead of the output's rendering buffers,
+ * skipping composition. The buffer must have the same size as the output's
+ * mode and must cover everything that would have been rendered. If the time
+ * of the frame isn't known, set `when` to NULL.
+ *
+ * Fails if the backend doesn't support it or if a software cursor would need
+ * to be rendered on top of the buffer, in which case the compositor should
+ * render and swap buffers as usual. The `swap_buffers` event isn't emitted.
+ *
+ * Presenting a buffer schedules a `frame` event.
+ */
+bool wlr_output_present_buffer(struct wlr_output *output,
+	struct wlr_buffer *buffer, struct timespec *when);
+/**
+ * Puts the scene saved behind software cursors back into the current buffer,
+ * so that the compositor doesn't need to render the scene under them.
+ * `buffer_age` is the one returned by `wlr_output_make_current`, and the
+ * restored region is added to `damage`.
+ *
+ * On success, the buffer holds the scene as it was when the buffer was last
+ * painted. The compositor only needs to repaint where the scene changed since
+ * then, and to call `wlr_output_swap_buffers` with a damage including the
+ * region added here, which draws the cursors at their current position. Fails
+ * if no software cursor was drawn in this buffer or if the scene behind them
+ * isn't known, in which case the compositor should render the output as usual.
+ */
+bool wlr_output_restore_cursors(struct wlr_output *output, int buffer_age,
+	pixman_region32_t *damage);
 /**
  * Manually schedules a `frame` event. If a `frame` event is already pending,
  * it is a no-op.
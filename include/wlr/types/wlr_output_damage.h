@@ -26,9 +26,23 @@ struct wlr_output_damage {
 	int max_rects; // max number of damaged rectangles
 
 	pixman_region32_t current; // in output-local coordinates
+	// the part of `current` which isn't the output's own damage, ie. where the
+	// scene needs to be rendered
+	pixman_region32_t current_scene;
+	int buffer_age; // of the current buffer, set when making it current
+	// set when software cursors were restored in the current buffer, then
+	// `cursors_damage` is swapped in addition to what the compositor rendered
+	bool cursors_restored;
+	pixman_region32_t cursors_damage;
+	// set while the frame is rendered on a render thread, then `deferred` and
+	// `deferred_scene` hold the damage of the frame and `current` the damage
+	// accumulated since
+	bool swap_deferred;
+	pixman_region32_t deferred, deferred_scene;
 
-	// circular queue for previous damage
+	// circular queues for previous damage
 	pixman_region32_t previous[WLR_OUTPUT_DAMAGE_PREVIOUS_LEN];
+	pixman_region32_t previous_scene[WLR_OUTPUT_DAMAGE_PREVIOUS_LEN];
 	size_t previous_idx;
 
 	struct {
@@ -61,6 +75,40 @@ bool wlr_output_damage_make_current(struct wlr_output_damage *output_damage,
  */
 bool wlr_output_damage_swap_buffers(struct wlr_output_damage *output_damage,
 	struct timespec *when, pixman_region32_t *damage);
+/**
+ * Hands the current frame over to a render thread, see
+ * `wlr_output_render_thread`: damage accumulated from now on belongs to the
+ * next frame. `wlr_output_damage_swap_buffers` must be called once the frame
+ * is rendered.
+ */
+void wlr_output_damage_defer_swap(struct wlr_output_damage *output_damage);
+/**
+ * Gives up on a frame handed over to a render thread which couldn't be
+ * rendered. The whole output is damaged, since the contents of the buffer are
+ * unknown.
+ */
+void wlr_output_damage_cancel_swap(struct wlr_output_damage *output_damage);
+/**
+ * Displays a client buffer directly instead of the rendering buffers, see
+ * `wlr_output_present_buffer`. If the time of the frame isn't known, set
+ * `when` to NULL.
+ *
+ * Presenting a buffer schedules a `frame` event.
+ */
+bool wlr_output_damage_present_buffer(struct wlr_output_damage *output_damage,
+	struct wlr_buffer *buffer, struct timespec *when);
+/**
+ * Restores the scene behind software cursors in the current buffer, see
+ * `wlr_output_restore_cursors`. Must be called after
+ * `wlr_output_damage_make_current`.
+ *
+ * On success, `damage` is replaced by the region where the scene changed since
+ * the buffer was last painted, which is the only one the compositor needs to
+ * repaint before calling `wlr_output_damage_swap_buffers` with it. Returns
+ * false if the output needs to be rendered as usual.
+ */
+bool wlr_output_damage_restore_cursors(struct wlr_output_damage *output_damage,
+	pixman_region32_t *damage);
 /**
  * Accumulates damage and schedules a `frame` event.
  */
@@ -71,6 +71,15 @@ bool wlr_output_layout_contains_point(struct wlr_output_layout *layout,
 bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 		struct wlr_output *reference, const struct wlr_box *target_lbox);
 
+/**
+ * Stores the outputs intersecting the target box in `outputs`, in no
+ * particular order, and returns how many there are. At most `outputs_len`
+ * outputs are stored, `outputs` can be NULL to only count them.
+ */
+size_t wlr_output_layout_outputs_in_box(struct wlr_output_layout *layout,
+		const struct wlr_box *target_lbox, struct wlr_output **outputs,
+		size_t outputs_len);
+
 /**
  * Get the closest point on this layout from the given point from the reference
  * output. If reference is NULL, gets the closest point from the entire layout.
@@ -0,0 +1,92 @@
+#ifndef WLR_TYPES_WLR_OUTPUT_RENDER_THREAD_H
+#define WLR_TYPES_WLR_OUTPUT_RENDER_THREAD_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <wayland-server.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+
+/**
+ * Renders a frame on a render thread. `renderer` belongs to the thread and the
+ * output is current.
+ */
+typedef void (*wlr_output_render_func_t)(struct wlr_output *output,
+	struct wlr_renderer *renderer, void *data);
+
+/**
+ * Renders the frames of an output on a dedicated thread, so that a slow output
+ * doesn't delay the frames of the others. Requires the GLES2 renderer.
+ *
+ * Frames are prepared on the main thread as usual: when a `frame` event is
+ * emitted, the output is made current and the damage is computed. Instead of
+ * rendering, the compositor snapshots the scene to paint and submits a function
+ * replaying it with `wlr_output_render_thread_submit`. It runs on the thread,
+ * with its own renderer and an EGL context sharing textures with the main one.
+ * Then the `done` event is emitted on the main thread, with the output current
+ * again, and the compositor swaps buffers as usual.
+ *
+ * While a frame is rendered, everything the render function uses must be left
+ * untouched: the compositor should keep references to the buffers it samples,
+ * and must not render to, reconfigure or destroy the output.
+ */
+struct wlr_output_render_thread {
+	struct wlr_output *output;
+	bool busy; // a frame is being rendered
+
+	struct {
+		struct wl_signal done; // struct wlr_output_render_thread_done_event
+		struct wl_signal destroy;
+	} events;
+
+	// private state
+
+	struct wlr_egl *egl;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	// guarded by lock
+	bool started, stop;
+	bool rendered;
+	wlr_output_render_func_t render; // set while a frame is submitted
+	void *render_data;
+	void *fence;
+
+	int notify_fd; // wakes up the main thread when a frame is rendered
+	struct wl_event_source *notify_source;
+
+	struct wl_listener output_destroy;
+};
+
+struct wlr_output_render_thread_done_event {
+	struct wlr_output_render_thread *render_thread;
+	// false if the output couldn't be made current on the thread, then the
+	// frame should be given up with `wlr_output_damage_cancel_swap`
+	bool rendered;
+};
+
+/**
+ * Starts a render thread for the output. Returns NULL if the renderer isn't
+ * supported or the thread couldn't be started.
+ */
+struct wlr_output_render_thread *wlr_output_render_thread_create(
+	struct wlr_output *output);
+/**
+ * Stops the render thread. Waits for the frame being rendered, if any, without
+ * emitting `done`.
+ */
+void wlr_output_render_thread_destroy(
+	struct wlr_output_render_thread *render_thread);
+/**
+ * Renders the current frame on the thread. The output must be current and the
+ * thread must not be busy.
+ *
+ * Whatever the main thread uploaded or rendered so far is visible to `render`.
+ * The output buffer is released from the main thread until `done` is emitted.
+ */
+void wlr_output_render_thread_submit(
+	struct wlr_output_render_thread *render_thread,
+	wlr_output_render_func_t render, void *data);
+
+#endif
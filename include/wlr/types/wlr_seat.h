@@ -24,6 +24,9 @@ struct wlr_seat_client {
 	struct wl_list data_devices;
 	struct wl_list primary_selection_devices;
 
+	// ID of the wlr_keymap_file last sent to all keyboards, 0 if none
+	uint64_t keymap_id;
+
 	struct {
 		struct wl_signal destroy;
 	} events;
@@ -169,10 +172,14 @@ struct wlr_seat_touch_state {
 	struct wlr_seat_touch_grab *default_grab;
 };
 
+struct hash_table;
+struct wlr_input_latency;
+
 struct wlr_seat {
 	struct wl_global *wl_global;
 	struct wl_display *display;
-	struct wl_list clients;
+	struct wl_list clients; // wlr_seat_client::link
+	struct hash_table *client_table; // private, wl_client -> wlr_seat_client
 	struct wl_list drag_icons; // wlr_drag_icon::link
 
 	char *name;
@@ -181,6 +188,7 @@ struct wlr_seat {
 
 	struct wlr_data_source *selection_source;
 	uint32_t selection_serial;
+	size_t selection_cache_size; // see wlr_seat_set_selection_cache_size
 
 	struct wlr_primary_selection_source *primary_selection_source;
 	uint32_t primary_selection_serial;
@@ -194,6 +202,8 @@ struct wlr_seat {
 	struct wlr_seat_keyboard_state keyboard_state;
 	struct wlr_seat_touch_state touch_state;
 
+	struct wlr_input_latency *input_latency; // see wlr_input_latency_create
+
 	struct wl_listener display_destroy;
 	struct wl_listener selection_source_destroy;
 	struct wl_listener primary_selection_source_destroy;
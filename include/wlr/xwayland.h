@@ -21,6 +21,7 @@ struct wlr_xwayland {
 	int wm_fd[2], wl_fd[2];
 
 	time_t server_start;
+	int64_t start_nsec; // CLOCK_MONOTONIC, for startup timings
 
 	/* Anything above display is reset on Xwayland restart, rest is conserved */
 
@@ -30,6 +31,9 @@ struct wlr_xwayland {
 	struct wl_listener display_destroy;
 
 	bool lazy;
+	bool prestart;
+	uint32_t prestart_delay; // ms
+	struct wl_event_source *prestart_source;
 
 	struct wl_display *wl_display;
 	struct wlr_compositor *compositor;
@@ -51,6 +55,20 @@ struct wlr_xwayland {
 	void *data;
 };
 
+/**
+ * Statistics about the X11 events handled by the window manager since
+ * Xwayland was last started. Events are handled in batches of bounded size:
+ * when a batch is full, the rest is deferred until the event loop has
+ * dispatched its other sources.
+ */
+struct wlr_xwayland_event_stats {
+	uint64_t batches;
+	uint64_t events;
+	size_t max_batch;
+	uint64_t coalesced; // superseded by the next event, not handled
+	uint64_t deferred; // batches where the rest was left to the next iteration
+};
+
 enum wlr_xwayland_surface_decorations {
 	WLR_XWAYLAND_SURFACE_DECORATIONS_ALL = 0,
 	WLR_XWAYLAND_SURFACE_DECORATIONS_NO_BORDER = 1,
@@ -96,7 +114,6 @@ struct wlr_xwayland_surface {
 	uint32_t surface_id;
 
 	struct wl_list link;
-	struct wl_list unpaired_link;
 
 	struct wlr_surface *surface;
 	int16_t x, y;
@@ -104,6 +121,8 @@ struct wlr_xwayland_surface {
 	uint16_t saved_width, saved_height;
 	bool override_redirect;
 	bool mapped;
+	// A buffer was committed, mapping waits for the window properties
+	bool map_pending;
 
 	char *title;
 	char *class;
@@ -129,6 +148,11 @@ struct wlr_xwayland_surface {
 	bool pinging;
 	struct wl_event_source *ping_timer;
 
+	struct wl_list stack_link; // wlr_xwm::stack
+	// Configure request not sent yet, the XCB_CONFIG_WINDOW_* fields to set
+	uint32_t pending_configure;
+	struct wl_list configure_link; // wlr_xwm::pending_configures
+
 	// _NET_WM_STATE
 	bool fullscreen;
 	bool maximized_vert, maximized_horz;
@@ -179,6 +203,21 @@ struct wlr_xwayland *wlr_xwayland_create(struct wl_display *wl_display,
 
 void wlr_xwayland_destroy(struct wlr_xwayland *wlr_xwayland);
 
+/**
+ * In lazy mode, starts Xwayland `delay` milliseconds after the compositor
+ * first becomes idle instead of waiting for the first X11 client to connect,
+ * so that the client doesn't have to wait for Xwayland to start. This also
+ * applies when Xwayland is restarted.
+ */
+void wlr_xwayland_prestart(struct wlr_xwayland *wlr_xwayland, uint32_t delay);
+
+/**
+ * Gets the statistics of the X11 events handled so far, all zero if Xwayland
+ * isn't running.
+ */
+void wlr_xwayland_get_event_stats(struct wlr_xwayland *wlr_xwayland,
+	struct wlr_xwayland_event_stats *stats);
+
 void wlr_xwayland_set_cursor(struct wlr_xwayland *wlr_xwayland,
 	uint8_t *pixels, uint32_t stride, uint32_t width, uint32_t height,
 	int32_t hotspot_x, int32_t hotspot_y);
@@ -3,7 +3,13 @@
 
 #include <xcb/xfixes.h>
 
+// Selections smaller than this are sent in a single property
 #define INCR_CHUNK_SIZE (64 * 1024)
+// INCR chunks start at INCR_CHUNK_SIZE and double up to this size, or to the
+// X server's maximum request length
+#define INCR_CHUNK_SIZE_MAX (8 * 1024 * 1024)
+
+#define SELECTION_BUFFER_POOL_SIZE 2
 
 #define XDND_VERSION 5
 
@@ -22,10 +28,24 @@ struct wlr_xwm_selection_transfer {
 	// when sending to x11
 	xcb_selection_request_event_t request;
 	struct wl_list outgoing_link;
+	size_t chunk_size;
+	size_t sent;
+	int64_t start_nsec;
 
 	// when receiving from x11
 	int property_start;
 	xcb_get_property_reply_t *property_reply;
+	bool incr_chunk_ready; // set by the owner, not requested yet
+	bool incr_chunk_requested;
+};
+
+/**
+ * Buffers of finished outgoing transfers, kept to avoid reallocating them for
+ * the next ones.
+ */
+struct wlr_xwm_selection_buffer_pool {
+	struct wl_array buffers[SELECTION_BUFFER_POOL_SIZE];
+	size_t len;
 };
 
 struct wlr_xwm_selection {
@@ -46,15 +66,51 @@ void xwm_selection_transfer_close_source_fd(
 void xwm_selection_transfer_destroy_property_reply(
 	struct wlr_xwm_selection_transfer *transfer);
 
-xcb_atom_t xwm_mime_type_to_atom(struct wlr_xwm *xwm, char *mime_type);
-char *xwm_mime_type_from_atom(struct wlr_xwm *xwm, xcb_atom_t atom);
+/**
+ * Returns the atom of the MIME types which have a predefined target, or
+ * XCB_ATOM_NONE if the atom needs to be interned.
+ */
+xcb_atom_t xwm_mime_type_to_known_atom(struct wlr_xwm *xwm,
+	const char *mime_type);
+/**
+ * Returns the MIME type of the predefined targets, or NULL if it's the name of
+ * the atom.
+ */
+const char *xwm_mime_type_from_known_atom(struct wlr_xwm *xwm,
+	xcb_atom_t atom);
+/**
+ * Called with the atoms of a list of MIME types, in the same order. Atoms which
+ * can't be interned are XCB_ATOM_NONE. `atoms` is NULL if the requests were
+ * discarded.
+ */
+typedef void (*xwm_atoms_handler_t)(struct wlr_xwm *xwm, xcb_atom_t *atoms,
+	size_t n, void *data);
+/**
+ * Interns the atoms of a list of MIME types without waiting for the replies.
+ * The handler is called once they have all been received, or right away if
+ * no atom needs to be interned.
+ */
+void xwm_mime_types_to_atoms(struct wlr_xwm *xwm, struct wl_array *mime_types,
+	xwm_atoms_handler_t handler, void *data);
 struct wlr_xwm_selection *xwm_get_selection(struct wlr_xwm *xwm,
 	xcb_atom_t selection_atom);
+/**
+ * Initializes `buffer` with a buffer from the pool, if any.
+ */
+void xwm_selection_buffer_get(struct wlr_xwm *xwm, struct wl_array *buffer);
+/**
+ * Returns `buffer` to the pool, or releases it if the pool is full. Pooled
+ * buffers are shrunk to INCR_CHUNK_SIZE.
+ */
+void xwm_selection_buffer_put(struct wlr_xwm *xwm, struct wl_array *buffer);
 
 void xwm_send_incr_chunk(struct wlr_xwm_selection_transfer *transfer);
 void xwm_handle_selection_request(struct wlr_xwm *xwm,
 	xcb_selection_request_event_t *req);
 
+/**
+ * Called when the owner of an incoming INCR transfer has set the next chunk.
+ */
 void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer);
 void xwm_handle_selection_notify(struct wlr_xwm *xwm,
 	xcb_selection_notify_event_t *event);
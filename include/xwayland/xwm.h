@@ -11,6 +11,7 @@
 #ifdef WLR_HAS_XCB_ERRORS
 #include <xcb/xcb_errors.h>
 #endif
+#include "util/hash_table.h"
 #include "xwayland/selection.h"
 
 /* This is in xcb/xcb_event.h, but pulling xcb-util just for a constant
@@ -89,9 +90,36 @@ enum net_wm_state_action {
 	NET_WM_STATE_TOGGLE = 2,
 };
 
+struct wlr_xwm;
+
+/**
+ * Continuation of a request, called with its reply. Exactly one of `reply` and
+ * `error` is set, or neither if the request failed without an X11 error or was
+ * discarded. The handler takes ownership of `reply`, `error` and `data`.
+ */
+typedef void (*xwm_reply_handler_t)(struct wlr_xwm *xwm, void *reply,
+	xcb_generic_error_t *error, void *data);
+
+/**
+ * A request whose reply hasn't been handled yet. Replies are handled in
+ * request order from the event loop, so that nothing in the XWM ever waits
+ * for the X server.
+ */
+struct xwm_pending_reply {
+	unsigned int sequence;
+	xcb_window_t window; // XCB_WINDOW_NONE if not tied to a window
+	xwm_reply_handler_t handler;
+	void *data;
+	struct wl_list link; // wlr_xwm::pending_replies
+};
+
+#define XWM_EVENT_BATCH_SIZE 256
+
 struct wlr_xwm {
 	struct wlr_xwayland *xwayland;
 	struct wl_event_source *event_source;
+	struct wl_event_source *event_batch_timer;
+	struct wlr_xwayland_event_stats event_stats;
 	struct wlr_seat *seat;
 	uint32_t ping_timeout;
 
@@ -103,6 +131,8 @@ struct wlr_xwm {
 	xcb_colormap_t colormap;
 	xcb_render_pictformat_t render_format_id;
 	xcb_cursor_t cursor;
+	struct wl_list cursors; // xwm_cursor::link, most recently used first
+	size_t cursors_len;
 
 	xcb_window_t selection_window;
 	struct wlr_xwm_selection clipboard_selection;
@@ -111,13 +141,32 @@ struct wlr_xwm {
 	xcb_window_t dnd_window;
 	struct wlr_xwm_selection dnd_selection;
 
+	size_t incr_chunk_size_max; // depends on the X server's max request length
+	struct wlr_xwm_selection_buffer_pool selection_buffers;
+
 	struct wlr_xwayland_surface *focus_surface;
 
 	struct wl_list surfaces; // wlr_xwayland_surface::link
-	struct wl_list unpaired_surfaces; // wlr_xwayland_surface::unpaired_link
+	struct hash_table surfaces_by_window; // xcb_window_t -> wlr_xwayland_surface
+	// wl_surface ID -> wlr_xwayland_surface waiting for it
+	struct hash_table unpaired_surfaces;
+	struct wl_list pending_replies; // xwm_pending_reply::link
+	// Mirror of the X stacking order, bottom-most first
+	struct wl_list stack; // wlr_xwayland_surface::stack_link
+	struct wl_list pending_configures; // wlr_xwayland_surface::configure_link
+	struct wl_event_source *configure_idle;
 
 	struct wlr_drag *drag;
 	struct wlr_xwayland_surface *drag_focus;
+	// While the atoms of the XdndEnter message are being interned, the
+	// position that must follow it is held back
+	struct {
+		bool pending;
+		uint32_t serial; // incremented for each XdndEnter
+		bool position;
+		uint32_t time;
+		int16_t x, y;
+	} dnd_enter;
 
 	const xcb_query_extension_reply_t *xfixes;
 #ifdef WLR_HAS_XCB_ERRORS
@@ -149,7 +198,34 @@ int xwm_handle_selection_client_message(struct wlr_xwm *xwm,
 
 void xwm_set_seat(struct wlr_xwm *xwm, struct wlr_seat *seat);
 
-char *xwm_get_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom);
+/**
+ * Calls `handler` with the reply to the request `sequence` once it's received.
+ * If `window` is set, the request is discarded when the window is destroyed.
+ * If this fails, the handler is called right away without a reply.
+ */
+void xwm_queue_reply(struct wlr_xwm *xwm, unsigned int sequence,
+	xcb_window_t window, xwm_reply_handler_t handler, void *data);
+/**
+ * Handles the replies which have already been received. Returns the number of
+ * replies handled.
+ */
+int xwm_dispatch_replies(struct wlr_xwm *xwm);
+/**
+ * Checks whether replies to requests about a window are still pending.
+ */
+bool xwm_has_pending_replies(struct wlr_xwm *xwm, xcb_window_t window);
+/**
+ * Discards the pending replies of a window, or all of them if `window` is
+ * XCB_WINDOW_NONE. Their handlers are called without a reply.
+ */
+void xwm_discard_replies(struct wlr_xwm *xwm, xcb_window_t window);
+
+/**
+ * Logs `message` at debug level, followed by the name of `atom`, which is
+ * fetched asynchronously.
+ */
+void xwm_log_atom_name(struct wlr_xwm *xwm, const char *message,
+	xcb_atom_t atom);
 bool xwm_atoms_contains(struct wlr_xwm *xwm, xcb_atom_t *atoms,
 	size_t num_atoms, enum atom_name needle);
 
@@ -2,11 +2,28 @@
 #include <stdio.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
+#include <GLES2/gl2.h>
 #include <stdlib.h>
 #include <wlr/render/egl.h>
 #include <wlr/util/log.h>
 #include "glapi.h"
 
+/**
+ * Context used instead of the wlr_egl's one on the calling thread, see
+ * wlr_egl_bind_thread. A render thread only renders with a single wlr_egl.
+ */
+static _Thread_local struct {
+	struct wlr_egl *egl;
+	EGLContext context;
+} thread_context;
+
+static EGLContext egl_get_context(struct wlr_egl *egl) {
+	if (thread_context.egl == egl) {
+		return thread_context.context;
+	}
+	return egl->context;
+}
+
 static bool egl_get_config(EGLDisplay disp, EGLint *attribs, EGLConfig *out,
 		EGLint visual_id) {
 	EGLint count = 0, matched = 0, ret;
@@ -165,6 +182,10 @@ bool wlr_egl_init(struct wlr_egl *egl, EGLenum platform, void *remote_display,
 		check_egl_ext(egl->exts_str, "EGL_EXT_image_dma_buf_import_modifiers")
 		&& eglQueryDmaBufFormatsEXT && eglQueryDmaBufModifiersEXT;
 
+	egl->exts.fence_sync_khr =
+		check_egl_ext(egl->exts_str, "EGL_KHR_fence_sync") &&
+		eglCreateSyncKHR && eglDestroySyncKHR && eglClientWaitSyncKHR;
+
 	egl->exts.image_dma_buf_export_mesa =
 		check_egl_ext(egl->exts_str, "EGL_MESA_image_dma_buf_export") &&
 		eglExportDMABUFImageQueryMESA && eglExportDMABUFImageMESA;
@@ -301,7 +322,8 @@ static int egl_get_buffer_age(struct wlr_egl *egl, EGLSurface surface) {
 
 bool wlr_egl_make_current(struct wlr_egl *egl, EGLSurface surface,
 		int *buffer_age) {
-	if (!eglMakeCurrent(egl->display, surface, surface, egl->context)) {
+	if (!eglMakeCurrent(egl->display, surface, surface,
+			egl_get_context(egl))) {
 		wlr_log(L_ERROR, "eglMakeCurrent failed");
 		return false;
 	}
@@ -313,7 +335,88 @@ bool wlr_egl_make_current(struct wlr_egl *egl, EGLSurface surface,
 }
 
 bool wlr_egl_is_current(struct wlr_egl *egl) {
-	return eglGetCurrentContext() == egl->context;
+	return eglGetCurrentContext() == egl_get_context(egl);
+}
+
+bool wlr_egl_bind_thread(struct wlr_egl *egl) {
+	assert(thread_context.egl == NULL);
+
+	size_t atti = 0;
+	EGLint attribs[5];
+	attribs[atti++] = EGL_CONTEXT_CLIENT_VERSION;
+	attribs[atti++] = 2;
+
+	// Render threads draw the compositor's frames, give them the priority the
+	// main context got
+	if (check_egl_ext(egl->exts_str, "EGL_IMG_context_priority")) {
+		EGLint priority = EGL_CONTEXT_PRIORITY_MEDIUM_IMG;
+		eglQueryContext(egl->display, egl->context,
+			EGL_CONTEXT_PRIORITY_LEVEL_IMG, &priority);
+		attribs[atti++] = EGL_CONTEXT_PRIORITY_LEVEL_IMG;
+		attribs[atti++] = priority;
+	}
+
+	attribs[atti++] = EGL_NONE;
+	assert(atti <= sizeof(attribs)/sizeof(attribs[0]));
+
+	if (eglBindAPI(EGL_OPENGL_ES_API) == EGL_FALSE) {
+		wlr_log(L_ERROR, "Failed to bind to the OpenGL ES API");
+		return false;
+	}
+
+	EGLContext context = eglCreateContext(egl->display, egl->config,
+		egl->context, attribs);
+	if (context == EGL_NO_CONTEXT) {
+		wlr_log(L_ERROR, "Failed to create shared EGL context");
+		return false;
+	}
+
+	thread_context.egl = egl;
+	thread_context.context = context;
+	return true;
+}
+
+void wlr_egl_unbind_thread(struct wlr_egl *egl) {
+	if (thread_context.egl != egl) {
+		return;
+	}
+
+	eglMakeCurrent(egl->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+		EGL_NO_CONTEXT);
+	eglDestroyContext(egl->display, thread_context.context);
+	eglReleaseThread();
+	thread_context.egl = NULL;
+	thread_context.context = EGL_NO_CONTEXT;
+}
+
+EGLSyncKHR wlr_egl_create_fence(struct wlr_egl *egl) {
+	assert(wlr_egl_is_current(egl));
+
+	if (egl->exts.fence_sync_khr) {
+		EGLSyncKHR fence = eglCreateSyncKHR(egl->display, EGL_SYNC_FENCE_KHR,
+			NULL);
+		if (fence != EGL_NO_SYNC_KHR) {
+			// The waiting thread can't flush our commands
+			glFlush();
+			return fence;
+		}
+		wlr_log(L_ERROR, "Failed to create EGL fence");
+	}
+
+	glFinish();
+	return EGL_NO_SYNC_KHR;
+}
+
+void wlr_egl_wait_fence(struct wlr_egl *egl, EGLSyncKHR fence) {
+	if (fence == EGL_NO_SYNC_KHR) {
+		return;
+	}
+
+	if (eglClientWaitSyncKHR(egl->display, fence, 0, EGL_FOREVER_KHR) ==
+			EGL_FALSE) {
+		wlr_log(L_ERROR, "Failed to wait for EGL fence");
+	}
+	eglDestroySyncKHR(egl->display, fence);
 }
 
 bool wlr_egl_swap_buffers(struct wlr_egl *egl, EGLSurface surface,
@@ -22,6 +22,15 @@ static struct wlr_gles2_renderer *gles2_get_renderer(
 	return (struct wlr_gles2_renderer *)wlr_renderer;
 }
 
+bool wlr_renderer_is_gles2(struct wlr_renderer *wlr_renderer) {
+	return wlr_renderer->impl == &renderer_impl;
+}
+
+struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *wlr_renderer) {
+	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
+	return renderer->egl;
+}
+
 static struct wlr_gles2_renderer *gles2_get_renderer_in_context(
 		struct wlr_renderer *wlr_renderer) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
@@ -320,6 +329,49 @@ static struct wlr_texture *gles2_texture_from_dmabuf(
 	return wlr_gles2_texture_from_dmabuf(renderer->egl, attribs);
 }
 
+static struct wlr_texture *gles2_texture_from_framebuffer(
+		struct wlr_renderer *wlr_renderer, const struct wlr_box *box) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+
+	struct wlr_box gl_box;
+	wlr_box_transform(box, WL_OUTPUT_TRANSFORM_FLIPPED_180,
+		renderer->viewport_width, renderer->viewport_height, &gl_box);
+
+	return wlr_gles2_texture_from_framebuffer(renderer->egl, gl_box.x,
+		gl_box.y, gl_box.width, gl_box.height);
+}
+
+static bool gles2_texture_write_framebuffer(struct wlr_renderer *wlr_renderer,
+		struct wlr_texture *wlr_texture, const struct wlr_box *box) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	struct wlr_gles2_texture *texture =
+		get_gles2_texture_in_context(wlr_texture);
+
+	if (texture->type != WLR_GLES2_TEXTURE_GLTEX ||
+			texture->width != box->width || texture->height != box->height) {
+		wlr_log(L_ERROR, "Cannot write framebuffer: incompatible texture");
+		return false;
+	}
+
+	struct wlr_box gl_box;
+	wlr_box_transform(box, WL_OUTPUT_TRANSFORM_FLIPPED_180,
+		renderer->viewport_width, renderer->viewport_height, &gl_box);
+
+	PUSH_GLES2_DEBUG;
+
+	glGetError(); // Clear the error flag
+
+	glBindTexture(GL_TEXTURE_2D, texture->gl_tex);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gl_box.x, gl_box.y,
+		gl_box.width, gl_box.height);
+
+	POP_GLES2_DEBUG;
+
+	return glGetError() == GL_NO_ERROR;
+}
+
 static void gles2_init_wl_display(struct wlr_renderer *wlr_renderer,
 		struct wl_display *wl_display) {
 	struct wlr_gles2_renderer *renderer =
@@ -369,6 +421,8 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.texture_from_pixels = gles2_texture_from_pixels,
 	.texture_from_wl_drm = gles2_texture_from_wl_drm,
 	.texture_from_dmabuf = gles2_texture_from_dmabuf,
+	.texture_from_framebuffer = gles2_texture_from_framebuffer,
+	.texture_write_framebuffer = gles2_texture_write_framebuffer,
 	.init_wl_display = gles2_init_wl_display,
 };
 
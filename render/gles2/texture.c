@@ -109,7 +109,11 @@ static void gles2_texture_destroy(struct wlr_texture *wlr_texture) {
 
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
 
-	wlr_egl_make_current(texture->egl, EGL_NO_SURFACE, NULL);
+	// Textures can be destroyed while an output is being rendered, eg. when
+	// the last reference to a buffer is dropped, don't unbind its surface
+	if (!wlr_egl_is_current(texture->egl)) {
+		wlr_egl_make_current(texture->egl, EGL_NO_SURFACE, NULL);
+	}
 
 	PUSH_GLES2_DEBUG;
 
@@ -287,3 +291,47 @@ struct wlr_texture *wlr_gles2_texture_from_dmabuf(struct wlr_egl *egl,
 	POP_GLES2_DEBUG;
 	return &texture->wlr_texture;
 }
+
+struct wlr_texture *wlr_gles2_texture_from_framebuffer(struct wlr_egl *egl,
+		int32_t x, int32_t y, uint32_t width, uint32_t height) {
+	assert(wlr_egl_is_current(egl));
+
+	struct wlr_gles2_texture *texture =
+		calloc(1, sizeof(struct wlr_gles2_texture));
+	if (texture == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_texture_init(&texture->wlr_texture, &texture_impl);
+	texture->egl = egl;
+	texture->width = width;
+	texture->height = height;
+	texture->type = WLR_GLES2_TEXTURE_GLTEX;
+	// The framebuffer is copied bottom-up
+	texture->inverted_y = true;
+
+	PUSH_GLES2_DEBUG;
+
+	// Copying requires the texture format to be a subset of the framebuffer's
+	GLint alpha_bits = 0;
+	glGetIntegerv(GL_ALPHA_BITS, &alpha_bits);
+	texture->has_alpha = alpha_bits > 0;
+
+	glGetError(); // Clear the error flag
+
+	glGenTextures(1, &texture->gl_tex);
+	glBindTexture(GL_TEXTURE_2D, texture->gl_tex);
+	glCopyTexImage2D(GL_TEXTURE_2D, 0, texture->has_alpha ? GL_RGBA : GL_RGB,
+		x, y, width, height, 0);
+
+	if (glGetError() != GL_NO_ERROR) {
+		wlr_log(L_ERROR, "Failed to copy framebuffer into texture");
+		glDeleteTextures(1, &texture->gl_tex);
+		POP_GLES2_DEBUG;
+		free(texture);
+		return NULL;
+	}
+
+	POP_GLES2_DEBUG;
+	return &texture->wlr_texture;
+}
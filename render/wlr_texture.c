@@ -42,6 +42,22 @@ struct wlr_texture *wlr_texture_from_dmabuf(struct wlr_renderer *renderer,
 	return renderer->impl->texture_from_dmabuf(renderer, attribs);
 }
 
+struct wlr_texture *wlr_texture_from_framebuffer(struct wlr_renderer *renderer,
+		const struct wlr_box *box) {
+	if (!renderer->impl->texture_from_framebuffer) {
+		return NULL;
+	}
+	return renderer->impl->texture_from_framebuffer(renderer, box);
+}
+
+bool wlr_texture_write_framebuffer(struct wlr_renderer *renderer,
+		struct wlr_texture *texture, const struct wlr_box *box) {
+	if (!renderer->impl->texture_write_framebuffer) {
+		return false;
+	}
+	return renderer->impl->texture_write_framebuffer(renderer, texture, box);
+}
+
 void wlr_texture_get_size(struct wlr_texture *texture, int *width,
 		int *height) {
 	return texture->impl->get_size(texture, width, height);
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "rootston/bindings.h"
+#include "rootston/config.h"
+#include "rootston/keyboard.h"
+
+#define BINDING_TABLE_MIN_ENTRIES 16
+
+static int keysym_cmp(const void *a, const void *b) {
+	xkb_keysym_t ka = *(const xkb_keysym_t *)a;
+	xkb_keysym_t kb = *(const xkb_keysym_t *)b;
+	return (ka > kb) - (ka < kb);
+}
+
+static uint64_t binding_hash(uint32_t modifiers, const xkb_keysym_t *keysyms,
+		size_t len) {
+	// FNV-1a over the modifiers and the sorted keysyms
+	uint64_t hash = 0xcbf29ce484222325;
+	hash = (hash ^ modifiers) * 0x100000001b3;
+	for (size_t i = 0; i < len; ++i) {
+		hash = (hash ^ keysyms[i]) * 0x100000001b3;
+	}
+	return hash;
+}
+
+/**
+ * Checks whether a binding matches the pressed keysyms, the same way as
+ * before bindings were indexed.
+ */
+static bool binding_matches(struct roots_binding_config *bc,
+		uint32_t modifiers, const xkb_keysym_t *pressed, size_t pressed_len) {
+	if (modifiers != bc->modifiers || pressed_len != bc->keysyms_len) {
+		return false;
+	}
+	for (size_t i = 0; i < bc->keysyms_len; ++i) {
+		bool found = false;
+		for (size_t j = 0; j < pressed_len; ++j) {
+			if (pressed[j] == bc->keysyms[i]) {
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool entry_equals(const struct binding_table_entry *entry,
+		uint64_t hash, uint32_t modifiers, const xkb_keysym_t *sorted,
+		size_t len) {
+	return entry->hash == hash && entry->binding->modifiers == modifiers &&
+		entry->binding->keysyms_len == len &&
+		memcmp(entry->keysyms, sorted, len * sizeof(xkb_keysym_t)) == 0;
+}
+
+static struct binding_table_entry *table_find_slot(
+		struct binding_table *table, uint64_t hash, uint32_t modifiers,
+		const xkb_keysym_t *sorted, size_t len) {
+	size_t mask = table->n_entries - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		struct binding_table_entry *entry = &table->entries[i];
+		if (entry->binding == NULL ||
+				entry_equals(entry, hash, modifiers, sorted, len)) {
+			return entry;
+		}
+	}
+}
+
+void binding_table_init(struct binding_table *table,
+		struct wl_list *bindings) {
+	memset(table, 0, sizeof(*table));
+	table->bindings = bindings;
+
+	size_t n = wl_list_length(bindings);
+	size_t n_entries = BINDING_TABLE_MIN_ENTRIES;
+	while (n_entries < 2 * n) {
+		n_entries *= 2;
+	}
+	table->entries = calloc(n_entries, sizeof(struct binding_table_entry));
+	table->fallback = calloc(n + 1, sizeof(struct binding_table_entry));
+	if (table->entries == NULL || table->fallback == NULL) {
+		goto error;
+	}
+	table->n_entries = n_entries;
+
+	size_t order = 0;
+	struct roots_binding_config *bc;
+	wl_list_for_each(bc, bindings, link) {
+		struct binding_table_entry new_entry = {
+			.binding = bc,
+			.keysyms = malloc((bc->keysyms_len + 1) * sizeof(xkb_keysym_t)),
+			.order = order++,
+		};
+		if (new_entry.keysyms == NULL) {
+			goto error;
+		}
+		memcpy(new_entry.keysyms, bc->keysyms,
+			bc->keysyms_len * sizeof(xkb_keysym_t));
+		qsort(new_entry.keysyms, bc->keysyms_len, sizeof(xkb_keysym_t),
+			keysym_cmp);
+		new_entry.hash = binding_hash(bc->modifiers, new_entry.keysyms,
+			bc->keysyms_len);
+
+		bool repeated = false;
+		for (size_t i = 1; i < bc->keysyms_len; ++i) {
+			if (new_entry.keysyms[i] == new_entry.keysyms[i - 1]) {
+				repeated = true;
+				break;
+			}
+		}
+		if (repeated) {
+			table->fallback[table->n_fallback++] = new_entry;
+			continue;
+		}
+
+		struct binding_table_entry *entry = table_find_slot(table,
+			new_entry.hash, bc->modifiers, new_entry.keysyms,
+			bc->keysyms_len);
+		if (entry->binding != NULL) {
+			// Shadowed by a binding earlier in the list
+			free(new_entry.keysyms);
+			continue;
+		}
+		*entry = new_entry;
+	}
+	return;
+
+error:
+	wlr_log(L_ERROR, "Allocation failed, bindings won't be indexed");
+	binding_table_finish(table);
+	table->bindings = bindings;
+}
+
+void binding_table_finish(struct binding_table *table) {
+	for (size_t i = 0; i < table->n_entries; ++i) {
+		free(table->entries[i].keysyms);
+	}
+	for (size_t i = 0; i < table->n_fallback; ++i) {
+		free(table->fallback[i].keysyms);
+	}
+	free(table->entries);
+	free(table->fallback);
+	memset(table, 0, sizeof(*table));
+}
+
+struct roots_binding_config *binding_table_find(struct binding_table *table,
+		uint32_t modifiers, const xkb_keysym_t *pressed, size_t pressed_len) {
+	if (table->entries == NULL) {
+		if (table->bindings == NULL) {
+			return NULL;
+		}
+		struct roots_binding_config *bc;
+		wl_list_for_each(bc, table->bindings, link) {
+			if (binding_matches(bc, modifiers, pressed, pressed_len)) {
+				return bc;
+			}
+		}
+		return NULL;
+	}
+
+	if (pressed_len > ROOTS_KEYBOARD_PRESSED_KEYSYMS_CAP) {
+		return NULL;
+	}
+	xkb_keysym_t sorted[ROOTS_KEYBOARD_PRESSED_KEYSYMS_CAP];
+	memcpy(sorted, pressed, pressed_len * sizeof(xkb_keysym_t));
+	qsort(sorted, pressed_len, sizeof(xkb_keysym_t), keysym_cmp);
+	uint64_t hash = binding_hash(modifiers, sorted, pressed_len);
+
+	struct binding_table_entry *found =
+		table_find_slot(table, hash, modifiers, sorted, pressed_len);
+	if (found->binding == NULL) {
+		found = NULL;
+	}
+	for (size_t i = 0; i < table->n_fallback; ++i) {
+		struct binding_table_entry *entry = &table->fallback[i];
+		if ((found == NULL || entry->order < found->order) &&
+				binding_matches(entry->binding, modifiers, pressed,
+					pressed_len)) {
+			found = entry;
+		}
+	}
+	return found != NULL ? found->binding : NULL;
+}
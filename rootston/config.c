@@ -182,6 +182,16 @@ static void config_handle_cursor(struct roots_config *config,
 	} else if (strcmp(name, "default-image") == 0) {
 		free(cc->default_image);
 		cc->default_image = strdup(value);
+	} else if (strcmp(name, "coalesce-motion") == 0) {
+		if (strcasecmp(value, "true") == 0) {
+			cc->coalesce_motion = true;
+		} else if (strcasecmp(value, "false") == 0) {
+			cc->coalesce_motion = false;
+		} else {
+			wlr_log(L_ERROR, "got unknown coalesce-motion value: %s", value);
+		}
+	} else if (strcmp(name, "coalesce-motion-interval") == 0) {
+		cc->coalesce_motion_interval = strtol(value, NULL, 10);
 	} else {
 		wlr_log(L_ERROR, "got unknown cursor config: %s", name);
 	}
@@ -243,11 +253,36 @@ static int config_ini_handler(void *user, const char *section, const char *name,
 			} else if (strcasecmp(value, "immediate") == 0) {
 				config->xwayland = true;
 				config->xwayland_lazy = false;
+			} else if (strcasecmp(value, "prestart") == 0) {
+				config->xwayland = true;
+				config->xwayland_lazy = true;
+				if (config->xwayland_prestart_delay < 0) {
+					config->xwayland_prestart_delay =
+						ROOTS_XWAYLAND_PRESTART_DELAY;
+				}
 			} else if (strcasecmp(value, "false") == 0) {
 				config->xwayland = false;
 			} else {
 				wlr_log(L_ERROR, "got unknown xwayland value: %s", value);
 			}
+		} else if (strcmp(name, "xwayland-prestart-delay") == 0) {
+			config->xwayland_prestart_delay = strtol(value, NULL, 10);
+		} else if (strcmp(name, "input-latency-log") == 0) {
+			config->input_latency_log_interval = strtol(value, NULL, 10);
+		} else if (strcmp(name, "selection-cache-size") == 0) {
+			config->selection_cache_size = strtoul(value, NULL, 10);
+		} else if (strcmp(name, "record-input") == 0) {
+			free(config->record_input_path);
+			config->record_input_path = strdup(value);
+		} else if (strcmp(name, "render-threads") == 0) {
+			if (strcasecmp(value, "true") == 0) {
+				config->render_threads = true;
+			} else if (strcasecmp(value, "false") == 0) {
+				config->render_threads = false;
+			} else {
+				wlr_log(L_ERROR, "got unknown render-threads value: %s",
+					value);
+			}
 		} else {
 			wlr_log(L_ERROR, "got unknown core config: %s", name);
 		}
@@ -393,6 +428,7 @@ struct roots_config *roots_config_create_from_args(int argc, char *argv[]) {
 
 	config->xwayland = true;
 	config->xwayland_lazy = true;
+	config->xwayland_prestart_delay = -1;
 	wl_list_init(&config->outputs);
 	wl_list_init(&config->devices);
 	wl_list_init(&config->keyboards);
@@ -453,6 +489,7 @@ struct roots_config *roots_config_create_from_args(int argc, char *argv[]) {
 		exit(1);
 	}
 
+	binding_table_init(&config->binding_table, &config->bindings);
 	return config;
 }
 
@@ -493,6 +530,7 @@ void roots_config_destroy(struct roots_config *config) {
 		free(cc);
 	}
 
+	binding_table_finish(&config->binding_table);
 	struct roots_binding_config *bc, *btmp = NULL;
 	wl_list_for_each_safe(bc, btmp, &config->bindings, link) {
 		free(bc->keysyms);
@@ -501,6 +539,7 @@ void roots_config_destroy(struct roots_config *config) {
 	}
 
 	free(config->config_path);
+	free(config->record_input_path);
 	free(config);
 }
 
@@ -41,6 +41,7 @@ struct roots_view *view_create(struct roots_desktop *desktop) {
 	wl_signal_init(&view->events.unmap);
 	wl_signal_init(&view->events.destroy);
 	wl_list_init(&view->children);
+	wl_list_init(&view->hit_box_link);
 	return view;
 }
 
@@ -465,6 +466,7 @@ void view_map(struct roots_view *view, struct wlr_surface *surface) {
 		&view->new_subsurface);
 
 	wl_list_insert(&view->desktop->views, &view->link);
+	view->stack_serial = ++view->desktop->view_stack_serial;
 	view_damage_whole(view);
 }
 
@@ -489,6 +491,10 @@ void view_unmap(struct roots_view *view) {
 		view->fullscreen_output = NULL;
 	}
 
+	wl_list_remove(&view->hit_box_link);
+	wl_list_init(&view->hit_box_link);
+	view_grid_remove_view(&view->desktop->view_grid, view);
+
 	view->wlr_surface = NULL;
 	view->width = view->height = 0;
 }
@@ -512,7 +518,16 @@ void view_setup(struct roots_view *view) {
 	view_update_output(view, NULL);
 }
 
+static void view_invalidate_hit_box(struct roots_view *view) {
+	if (view->wlr_surface == NULL || !wl_list_empty(&view->hit_box_link)) {
+		return;
+	}
+	wl_list_insert(&view->desktop->dirty_views, &view->hit_box_link);
+}
+
 void view_apply_damage(struct roots_view *view) {
+	view_invalidate_hit_box(view);
+
 	struct roots_output *output;
 	wl_list_for_each(output, &view->desktop->outputs, link) {
 		output_damage_from_view(output, view);
@@ -520,6 +535,8 @@ void view_apply_damage(struct roots_view *view) {
 }
 
 void view_damage_whole(struct roots_view *view) {
+	view_invalidate_hit_box(view);
+
 	struct roots_output *output;
 	wl_list_for_each(output, &view->desktop->outputs, link) {
 		output_damage_whole_view(output, view);
@@ -613,6 +630,134 @@ static bool view_at(struct roots_view *view, double lx, double ly,
 	return false;
 }
 
+static void hit_box_add_surface(struct wlr_surface *surface, int sx, int sy,
+		void *data) {
+	struct wlr_box *box = data;
+	int width = surface->current.width, height = surface->current.height;
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+	if (box->width <= 0 || box->height <= 0) {
+		box->x = sx;
+		box->y = sy;
+		box->width = width;
+		box->height = height;
+		return;
+	}
+
+	int x1 = sx < box->x ? sx : box->x;
+	int y1 = sy < box->y ? sy : box->y;
+	int x2 = sx + width > box->x + box->width ?
+		sx + width : box->x + box->width;
+	int y2 = sy + height > box->y + box->height ?
+		sy + height : box->y + box->height;
+	box->x = x1;
+	box->y = y1;
+	box->width = x2 - x1;
+	box->height = y2 - y1;
+}
+
+/**
+ * Computes a box in layout coordinates containing every point for which
+ * view_at can return true.
+ */
+static void view_get_hit_box(struct roots_view *view, struct wlr_box *hit_box) {
+	if (view->type == ROOTS_WL_SHELL_VIEW &&
+			view->wl_shell_surface->state == WLR_WL_SHELL_SURFACE_STATE_POPUP) {
+		*hit_box = (struct wlr_box){0};
+		return;
+	}
+
+	// Same as the decoration box, but relative to the view and using the
+	// surface size like view_at does
+	struct wlr_surface_state *state = &view->wlr_surface->current;
+	struct wlr_box box = {
+		.x = 0, .y = 0,
+		.width = state->width, .height = state->height,
+	};
+	if (view->decorated) {
+		box.x -= view->border_width;
+		box.y -= view->border_width + view->titlebar_height;
+		box.width += view->border_width * 2;
+		box.height += view->border_width * 2 + view->titlebar_height;
+	}
+
+	switch (view->type) {
+	case ROOTS_XDG_SHELL_V6_VIEW:
+		wlr_xdg_surface_v6_for_each_surface(view->xdg_surface_v6,
+			hit_box_add_surface, &box);
+		break;
+	case ROOTS_XDG_SHELL_VIEW:
+		wlr_xdg_surface_for_each_surface(view->xdg_surface,
+			hit_box_add_surface, &box);
+		break;
+	case ROOTS_WL_SHELL_VIEW:
+		wlr_wl_shell_surface_for_each_surface(view->wl_shell_surface,
+			hit_box_add_surface, &box);
+		break;
+#ifdef WLR_HAS_XWAYLAND
+	case ROOTS_XWAYLAND_VIEW:
+		wlr_surface_for_each_surface(view->wlr_surface,
+			hit_box_add_surface, &box);
+		break;
+#endif
+	}
+
+	double x1 = box.x, y1 = box.y;
+	double x2 = box.x + box.width, y2 = box.y + box.height;
+	if (view->rotation != 0.0) {
+		// Rotate the corners around the center of the view
+		double cx = (double)state->width/2, cy = (double)state->height/2;
+		double c = cos(view->rotation), s = sin(view->rotation);
+		double corners[4][2] = {
+			{ box.x, box.y },
+			{ box.x + box.width, box.y },
+			{ box.x, box.y + box.height },
+			{ box.x + box.width, box.y + box.height },
+		};
+		for (size_t i = 0; i < 4; ++i) {
+			double dx = corners[i][0] - cx, dy = corners[i][1] - cy;
+			double px = cx + c*dx - s*dy, py = cy + s*dx + c*dy;
+			if (i == 0) {
+				x1 = x2 = px;
+				y1 = y2 = py;
+			} else {
+				x1 = fmin(x1, px);
+				y1 = fmin(y1, py);
+				x2 = fmax(x2, px);
+				y2 = fmax(y2, py);
+			}
+		}
+	}
+
+	// Keep a pixel of margin for rounding errors
+	hit_box->x = floor(view->x + x1) - 1;
+	hit_box->y = floor(view->y + y1) - 1;
+	hit_box->width = ceil(view->x + x2) + 1 - hit_box->x;
+	hit_box->height = ceil(view->y + y2) + 1 - hit_box->y;
+}
+
+static void desktop_update_hit_boxes(struct roots_desktop *desktop) {
+	struct roots_view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &desktop->dirty_views, hit_box_link) {
+		wl_list_remove(&view->hit_box_link);
+		wl_list_init(&view->hit_box_link);
+
+		view_get_hit_box(view, &view->hit_box);
+		view_grid_update_view(&desktop->view_grid, view, &view->hit_box);
+	}
+}
+
+static int view_stack_cmp(const void *a, const void *b) {
+	const struct roots_view *view_a = *(struct roots_view * const *)a;
+	const struct roots_view *view_b = *(struct roots_view * const *)b;
+	// Top-most first
+	if (view_a->stack_serial == view_b->stack_serial) {
+		return 0;
+	}
+	return view_a->stack_serial > view_b->stack_serial ? -1 : 1;
+}
+
 static struct roots_view *desktop_view_at(struct roots_desktop *desktop,
 		double lx, double ly, struct wlr_surface **surface,
 		double *sx, double *sy) {
@@ -630,8 +775,26 @@ static struct roots_view *desktop_view_at(struct roots_desktop *desktop,
 		}
 	}
 
-	struct roots_view *view;
-	wl_list_for_each(view, &desktop->views, link) {
+	desktop_update_hit_boxes(desktop);
+
+	struct wlr_list *views = view_grid_views_at(&desktop->view_grid, lx, ly);
+	if (views == NULL) {
+		return NULL;
+	}
+
+	struct wlr_list *candidates = &desktop->hit_candidates;
+	candidates->length = 0;
+	for (size_t i = 0; i < views->length; ++i) {
+		struct roots_view *view = views->items[i];
+		if (wlr_box_contains_point(&view->hit_box, lx, ly) &&
+				wlr_list_push(candidates, view) < 0) {
+			return NULL;
+		}
+	}
+	wlr_list_qsort(candidates, view_stack_cmp);
+
+	for (size_t i = 0; i < candidates->length; ++i) {
+		struct roots_view *view = candidates->items[i];
 		if (view_at(view, lx, ly, surface, sx, sy)) {
 			return view;
 		}
@@ -766,6 +929,17 @@ struct roots_desktop *desktop_create(struct roots_server *server,
 
 	wl_list_init(&desktop->views);
 	wl_list_init(&desktop->outputs);
+	wl_list_init(&desktop->dirty_views);
+
+	if (!view_grid_init(&desktop->view_grid)) {
+		free(desktop);
+		return NULL;
+	}
+	if (!wlr_list_init(&desktop->hit_candidates)) {
+		view_grid_finish(&desktop->view_grid);
+		free(desktop);
+		return NULL;
+	}
 
 	desktop->new_output.notify = handle_new_output;
 	wl_signal_add(&server->backend->events.new_output, &desktop->new_output);
@@ -818,6 +992,8 @@ struct roots_desktop *desktop_create(struct roots_server *server,
 	if (desktop->xcursor_manager == NULL) {
 		wlr_log(L_ERROR, "Cannot create XCursor manager for theme %s",
 			cursor_theme);
+		wlr_list_finish(&desktop->hit_candidates);
+		view_grid_finish(&desktop->view_grid);
 		free(desktop);
 		return NULL;
 	}
@@ -828,6 +1004,10 @@ struct roots_desktop *desktop_create(struct roots_server *server,
 		wl_signal_add(&desktop->xwayland->events.new_surface,
 			&desktop->xwayland_surface);
 		desktop->xwayland_surface.notify = handle_xwayland_surface;
+		if (config->xwayland_prestart_delay >= 0) {
+			wlr_xwayland_prestart(desktop->xwayland,
+				config->xwayland_prestart_delay);
+		}
 
 		if (wlr_xcursor_manager_load(desktop->xcursor_manager, 1)) {
 			wlr_log(L_ERROR, "Cannot load XWayland XCursor theme");
@@ -1,5 +1,6 @@
 #define _POSIX_C_SOURCE 200112L
 #include <assert.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <wayland-server.h>
@@ -8,6 +9,7 @@
 #include <wlr/backend/multi.h>
 #include <wlr/config.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_input_recorder.h>
 #include <wlr/util/log.h>
 #include "rootston/config.h"
 #include "rootston/server.h"
@@ -16,6 +18,8 @@ struct roots_server server = { 0 };
 
 int main(int argc, char **argv) {
 	wlr_log_init(L_DEBUG, NULL);
+	// Clients closing their end of a pipe early must not kill the compositor
+	signal(SIGPIPE, SIG_IGN);
 	server.config = roots_config_create_from_args(argc, argv);
 	server.wl_display = wl_display_create();
 	server.wl_event_loop = wl_display_get_event_loop(server.wl_display);
@@ -27,6 +31,12 @@ int main(int argc, char **argv) {
 		return 1;
 	}
 
+	if (server.config->record_input_path != NULL) {
+		// Must listen to new inputs before the seats do
+		wlr_input_recorder_create(server.backend,
+			server.config->record_input_path);
+	}
+
 	server.renderer = wlr_backend_get_renderer(server.backend);
 	assert(server.renderer);
 	server.data_device_manager =
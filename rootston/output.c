@@ -2,8 +2,10 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <wlr/config.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_output_layout.h>
@@ -126,10 +128,34 @@ static void drag_icons_for_each_surface(struct roots_input *input,
 	}
 }
 
+enum roots_render_op_type {
+	ROOTS_RENDER_BEGIN,
+	ROOTS_RENDER_SCISSOR,
+	ROOTS_RENDER_CLEAR,
+	ROOTS_RENDER_TEXTURE,
+	ROOTS_RENDER_QUAD,
+};
+
+/**
+ * A drawing command recorded on the main thread and replayed by the output's
+ * render thread. Textures are kept alive by a reference to their buffer until
+ * the frame is done, which also prevents clients from updating them meanwhile.
+ */
+struct roots_render_op {
+	enum roots_render_op_type type;
+	struct wlr_box box; // BEGIN (size only), SCISSOR
+	float color[4]; // CLEAR, QUAD
+	struct wlr_buffer *buffer; // TEXTURE
+	float matrix[9]; // TEXTURE, QUAD
+	float alpha; // TEXTURE
+};
 
 struct render_data {
 	struct layout_data layout;
 	struct roots_output *output;
+	struct wlr_renderer *renderer;
+	// if not NULL, drawing is recorded for the render thread instead
+	struct wl_array *ops;
 	struct timespec *when;
 	pixman_region32_t *damage;
 	float alpha;
@@ -164,10 +190,83 @@ static bool surface_intersect_output(struct wlr_surface *surface,
 	return wlr_output_layout_intersects(output_layout, wlr_output, &layout_box);
 }
 
-static void scissor_output(struct roots_output *output, pixman_box32_t *rect) {
-	struct wlr_output *wlr_output = output->wlr_output;
-	struct wlr_renderer *renderer = wlr_backend_get_renderer(wlr_output->backend);
-	assert(renderer);
+static struct roots_render_op *add_render_op(struct render_data *data,
+		enum roots_render_op_type type) {
+	struct roots_render_op *op = wl_array_add(data->ops, sizeof(*op));
+	if (op == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return NULL;
+	}
+	memset(op, 0, sizeof(*op));
+	op->type = type;
+	return op;
+}
+
+static void render_begin(struct render_data *data, int width, int height) {
+	if (data->ops == NULL) {
+		wlr_renderer_begin(data->renderer, width, height);
+		return;
+	}
+
+	struct roots_render_op *op = add_render_op(data, ROOTS_RENDER_BEGIN);
+	if (op != NULL) {
+		op->box.width = width;
+		op->box.height = height;
+	}
+}
+
+static void render_end(struct render_data *data) {
+	if (data->ops == NULL) {
+		wlr_renderer_scissor(data->renderer, NULL);
+		wlr_renderer_end(data->renderer);
+	}
+}
+
+static void render_clear(struct render_data *data,
+		const float color[static 4]) {
+	if (data->ops == NULL) {
+		wlr_renderer_clear(data->renderer, color);
+		return;
+	}
+
+	struct roots_render_op *op = add_render_op(data, ROOTS_RENDER_CLEAR);
+	if (op != NULL) {
+		memcpy(op->color, color, sizeof(op->color));
+	}
+}
+
+static void render_texture(struct render_data *data, struct wlr_buffer *buffer,
+		const float matrix[static 9], float alpha) {
+	if (data->ops == NULL) {
+		wlr_render_texture_with_matrix(data->renderer, buffer->texture, matrix,
+			alpha);
+		return;
+	}
+
+	struct roots_render_op *op = add_render_op(data, ROOTS_RENDER_TEXTURE);
+	if (op != NULL) {
+		op->buffer = wlr_buffer_ref(buffer);
+		memcpy(op->matrix, matrix, sizeof(op->matrix));
+		op->alpha = alpha;
+	}
+}
+
+static void render_quad(struct render_data *data, const float color[static 4],
+		const float matrix[static 9]) {
+	if (data->ops == NULL) {
+		wlr_render_quad_with_matrix(data->renderer, color, matrix);
+		return;
+	}
+
+	struct roots_render_op *op = add_render_op(data, ROOTS_RENDER_QUAD);
+	if (op != NULL) {
+		memcpy(op->color, color, sizeof(op->color));
+		memcpy(op->matrix, matrix, sizeof(op->matrix));
+	}
+}
+
+static void scissor_output(struct render_data *data, pixman_box32_t *rect) {
+	struct wlr_output *wlr_output = data->output->wlr_output;
 
 	struct wlr_box box = {
 		.x = rect->x1,
@@ -183,7 +282,15 @@ static void scissor_output(struct roots_output *output, pixman_box32_t *rect) {
 		wlr_output_transform_invert(wlr_output->transform);
 	wlr_box_transform(&box, transform, ow, oh, &box);
 
-	wlr_renderer_scissor(renderer, &box);
+	if (data->ops == NULL) {
+		wlr_renderer_scissor(data->renderer, &box);
+		return;
+	}
+
+	struct roots_render_op *op = add_render_op(data, ROOTS_RENDER_SCISSOR);
+	if (op != NULL) {
+		op->box = box;
+	}
 }
 
 static void render_surface(struct wlr_surface *surface, int sx, int sy,
@@ -192,15 +299,10 @@ static void render_surface(struct wlr_surface *surface, int sx, int sy,
 	struct roots_output *output = data->output;
 	float rotation = data->layout.rotation;
 
-	struct wlr_texture *texture = wlr_surface_get_texture(surface);
-	if (texture == NULL) {
+	if (wlr_surface_get_texture(surface) == NULL) {
 		return;
 	}
 
-	struct wlr_renderer *renderer =
-		wlr_backend_get_renderer(output->wlr_output->backend);
-	assert(renderer);
-
 	double lx, ly;
 	get_layout_position(&data->layout, &lx, &ly, surface, sx, sy);
 
@@ -233,8 +335,8 @@ static void render_surface(struct wlr_surface *surface, int sx, int sy,
 	int nrects;
 	pixman_box32_t *rects = pixman_region32_rectangles(&damage, &nrects);
 	for (int i = 0; i < nrects; ++i) {
-		scissor_output(output, &rects[i]);
-		wlr_render_texture_with_matrix(renderer, texture, matrix, data->alpha);
+		scissor_output(data, &rects[i]);
+		render_texture(data, surface->buffer, matrix, data->alpha);
 	}
 
 damage_finish:
@@ -270,9 +372,6 @@ static void render_decorations(struct roots_view *view,
 	}
 
 	struct roots_output *output = data->output;
-	struct wlr_renderer *renderer =
-		wlr_backend_get_renderer(output->wlr_output->backend);
-	assert(renderer);
 
 	struct wlr_box box;
 	get_decoration_box(view, output, &box);
@@ -299,8 +398,8 @@ static void render_decorations(struct roots_view *view,
 	pixman_box32_t *rects =
 		pixman_region32_rectangles(&damage, &nrects);
 	for (int i = 0; i < nrects; ++i) {
-		scissor_output(output, &rects[i]);
-		wlr_render_quad_with_matrix(renderer, color, matrix);
+		scissor_output(data, &rects[i]);
+		render_quad(data, color, matrix);
 	}
 
 damage_finish:
@@ -389,6 +488,264 @@ static void layers_send_done(
 	}
 }
 
+struct scanout_data {
+	struct layout_data layout;
+	struct roots_output *output;
+	float alpha;
+
+	size_t n_surfaces; // number of visible surfaces and decorations
+	// last visible surface
+	struct wlr_surface *surface;
+	struct wlr_box box;
+	float rotation, surface_alpha;
+};
+
+static void count_scanout_surface(struct wlr_surface *surface, int sx, int sy,
+		void *_data) {
+	struct scanout_data *data = _data;
+	struct roots_output *output = data->output;
+	float rotation = data->layout.rotation;
+
+	if (!wlr_surface_has_buffer(surface)) {
+		return;
+	}
+
+	double lx, ly;
+	get_layout_position(&data->layout, &lx, &ly, surface, sx, sy);
+
+	struct wlr_box box;
+	bool intersects = surface_intersect_output(surface, output->desktop->layout,
+		output->wlr_output, lx, ly, rotation, &box);
+	if (!intersects) {
+		return;
+	}
+
+	// Layer surfaces are iterated twice, don't count them twice
+	if (data->n_surfaces > 0 && data->surface == surface &&
+			memcmp(&data->box, &box, sizeof(box)) == 0) {
+		return;
+	}
+
+	data->n_surfaces++;
+	data->surface = surface;
+	data->box = box;
+	data->rotation = rotation;
+	data->surface_alpha = data->alpha;
+}
+
+static void count_scanout_layer(struct roots_output *output,
+		const struct wlr_box *output_layout_box, struct scanout_data *data,
+		struct wl_list *layer) {
+	struct roots_layer_surface *roots_surface;
+	wl_list_for_each(roots_surface, layer, link) {
+		struct wlr_layer_surface *layer = roots_surface->layer_surface;
+
+		surface_for_each_surface(layer->surface,
+			roots_surface->geo.x + output_layout_box->x,
+			roots_surface->geo.y + output_layout_box->y,
+			0, &data->layout, count_scanout_surface, data);
+
+		wlr_layer_surface_for_each_surface(layer, count_scanout_surface, data);
+	}
+}
+
+static void count_scanout_view(struct roots_view *view,
+		struct scanout_data *data) {
+	if (view->fullscreen_output != NULL &&
+			view->fullscreen_output != data->output) {
+		return;
+	}
+
+	if (view->decorated && view->wlr_surface != NULL) {
+		struct wlr_box box;
+		get_decoration_box(view, data->output, &box);
+		wlr_box_rotated_bounds(&box, view->rotation, &box);
+
+		struct wlr_box output_box = { 0 }, intersection;
+		wlr_output_transformed_resolution(data->output->wlr_output,
+			&output_box.width, &output_box.height);
+		if (wlr_box_intersection(&output_box, &box, &intersection)) {
+			data->n_surfaces++;
+		}
+	}
+
+	data->alpha = view->alpha;
+	view_for_each_surface(view, &data->layout, count_scanout_surface, data);
+}
+
+/**
+ * Returns the surface whose buffer can be presented on the output without
+ * composition, ie. a single opaque surface covering the whole output with
+ * nothing else visible. Returns NULL if there is none.
+ */
+static struct wlr_surface *output_get_scanout_surface(
+		struct roots_output *output) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct roots_desktop *desktop = output->desktop;
+
+	const struct wlr_box *output_box =
+		wlr_output_layout_get_box(desktop->layout, wlr_output);
+
+	struct scanout_data data = {
+		.output = output,
+		.alpha = 1.0,
+	};
+
+	count_scanout_layer(output, output_box, &data,
+		&output->layers[ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND]);
+	count_scanout_layer(output, output_box, &data,
+		&output->layers[ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM]);
+
+	if (output->fullscreen_view != NULL) {
+		struct roots_view *view = output->fullscreen_view;
+		if (view->wlr_surface != NULL) {
+			view_for_each_surface(view, &data.layout, count_scanout_surface,
+				&data);
+		}
+#ifdef WLR_HAS_XWAYLAND
+		if (view->type == ROOTS_XWAYLAND_VIEW) {
+			xwayland_children_for_each_surface(view->xwayland_surface,
+				count_scanout_surface, &data.layout, &data);
+		}
+#endif
+	} else {
+		struct roots_view *view;
+		wl_list_for_each_reverse(view, &desktop->views, link) {
+			count_scanout_view(view, &data);
+		}
+		count_scanout_layer(output, output_box, &data,
+			&output->layers[ZWLR_LAYER_SHELL_V1_LAYER_TOP]);
+	}
+
+	data.alpha = 1.0;
+	drag_icons_for_each_surface(desktop->server->input, count_scanout_surface,
+		&data.layout, &data);
+
+	count_scanout_layer(output, output_box, &data,
+		&output->layers[ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY]);
+
+	if (data.n_surfaces != 1 || data.surface == NULL ||
+			data.rotation != 0.0 || data.surface_alpha != 1.0) {
+		return NULL;
+	}
+
+	// The buffer must be displayable as-is and cover the whole output
+	struct wlr_surface *surface = data.surface;
+	if (surface->current.transform != wlr_output->transform ||
+			surface->current.scale != wlr_output->scale) {
+		return NULL;
+	}
+	int width, height;
+	wlr_output_transformed_resolution(wlr_output, &width, &height);
+	if (data.box.x != 0 || data.box.y != 0 ||
+			data.box.width != width || data.box.height != height) {
+		return NULL;
+	}
+
+	// Nothing must show through the buffer
+	pixman_box32_t surface_box = {
+		.x2 = surface->current.width,
+		.y2 = surface->current.height,
+	};
+	if (pixman_region32_contains_rectangle(&surface->current.opaque,
+			&surface_box) != PIXMAN_REGION_IN) {
+		return NULL;
+	}
+
+	return surface;
+}
+
+static void send_frame_done(struct roots_output *output,
+		struct timespec *when) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct roots_server *server = output->desktop->server;
+	struct render_data data = {
+		.output = output,
+		.when = when,
+	};
+
+	if (output->fullscreen_view != NULL) {
+		struct roots_view *view = output->fullscreen_view;
+		if (wlr_output->fullscreen_surface == view->wlr_surface) {
+			// The surface is managed by the wlr_output
+			return;
+		}
+
+		view_for_each_surface(view, &data.layout, surface_send_frame_done,
+			&data);
+
+#ifdef WLR_HAS_XWAYLAND
+		if (view->type == ROOTS_XWAYLAND_VIEW) {
+			xwayland_children_for_each_surface(view->xwayland_surface,
+				surface_send_frame_done, &data.layout, &data);
+		}
+#endif
+	} else {
+		struct roots_view *view;
+		wl_list_for_each_reverse(view, &output->desktop->views, link) {
+			view_for_each_surface(view, &data.layout, surface_send_frame_done,
+				&data);
+		}
+
+		drag_icons_for_each_surface(server->input, surface_send_frame_done,
+			&data.layout, &data);
+	}
+	layers_send_done(output, when);
+}
+
+/**
+ * Replays the drawing recorded by render_output, on the output's render thread.
+ */
+static void render_thread_render(struct wlr_output *wlr_output,
+		struct wlr_renderer *renderer, void *data) {
+	struct roots_output *output = data;
+
+	struct roots_render_op *op;
+	wl_array_for_each(op, &output->render_ops) {
+		switch (op->type) {
+		case ROOTS_RENDER_BEGIN:
+			wlr_renderer_begin(renderer, op->box.width, op->box.height);
+			break;
+		case ROOTS_RENDER_SCISSOR:
+			wlr_renderer_scissor(renderer, &op->box);
+			break;
+		case ROOTS_RENDER_CLEAR:
+			wlr_renderer_clear(renderer, op->color);
+			break;
+		case ROOTS_RENDER_TEXTURE:
+			wlr_render_texture_with_matrix(renderer, op->buffer->texture,
+				op->matrix, op->alpha);
+			break;
+		case ROOTS_RENDER_QUAD:
+			wlr_render_quad_with_matrix(renderer, op->color, op->matrix);
+			break;
+		}
+	}
+
+	wlr_renderer_scissor(renderer, NULL);
+	wlr_renderer_end(renderer);
+}
+
+static void release_render_ops(struct roots_output *output) {
+	struct roots_render_op *op;
+	wl_array_for_each(op, &output->render_ops) {
+		if (op->type == ROOTS_RENDER_TEXTURE) {
+			wlr_buffer_unref(op->buffer);
+		}
+	}
+	output->render_ops.size = 0;
+}
+
+static void stop_render_thread(struct roots_output *output) {
+	if (output->render_thread == NULL) {
+		return;
+	}
+	wl_list_remove(&output->render_done.link);
+	wlr_output_render_thread_destroy(output->render_thread);
+	output->render_thread = NULL;
+	output->render_thread_failed = false;
+}
+
 static void render_output(struct roots_output *output) {
 	struct wlr_output *wlr_output = output->wlr_output;
 	struct roots_desktop *desktop = output->desktop;
@@ -400,6 +757,15 @@ static void render_output(struct roots_output *output) {
 		return;
 	}
 
+	if (output->render_thread_failed) {
+		stop_render_thread(output);
+	}
+	if (output->render_thread != NULL && output->render_thread->busy) {
+		// The damage is kept, another frame is scheduled once the thread is
+		// done
+		return;
+	}
+
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
 
@@ -443,17 +809,35 @@ static void render_output(struct roots_output *output) {
 
 	struct render_data data = {
 		.output = output,
+		.renderer = renderer,
 		.when = &now,
 		.damage = &damage,
 		.alpha = 1.0,
 	};
+	if (output->render_thread != NULL) {
+		data.ops = &output->render_ops;
+	}
 
 	if (!needs_swap) {
 		// Output doesn't need swap and isn't damaged, skip rendering completely
 		goto damage_finish;
 	}
 
-	wlr_renderer_begin(renderer, wlr_output->width, wlr_output->height);
+	if (!server->config->debug_damage_tracking) {
+		// Only compose where the scene changed if the output can repaint
+		// software cursors by itself. Otherwise, skip composition if a single
+		// client buffer covers the whole output.
+		if (!wlr_output_damage_restore_cursors(output->damage, &damage)) {
+			struct wlr_surface *scanout = output_get_scanout_surface(output);
+			if (scanout != NULL && wlr_output_damage_present_buffer(
+					output->damage, scanout->buffer, &now)) {
+				output->last_frame = desktop->last_frame = now;
+				goto damage_finish;
+			}
+		}
+	}
+
+	render_begin(&data, wlr_output->width, wlr_output->height);
 
 	if (!pixman_region32_not_empty(&damage)) {
 		// Output isn't damaged but needs buffer swap
@@ -461,14 +845,14 @@ static void render_output(struct roots_output *output) {
 	}
 
 	if (server->config->debug_damage_tracking) {
-		wlr_renderer_clear(renderer, (float[]){1, 1, 0, 1});
+		render_clear(&data, (float[]){1, 1, 0, 1});
 	}
 
 	int nrects;
 	pixman_box32_t *rects = pixman_region32_rectangles(&damage, &nrects);
 	for (int i = 0; i < nrects; ++i) {
-		scissor_output(output, &rects[i]);
-		wlr_renderer_clear(renderer, clear_color);
+		scissor_output(&data, &rects[i]);
+		render_clear(&data, clear_color);
 	}
 
 	render_layer(output, output_box, &data,
@@ -518,8 +902,7 @@ static void render_output(struct roots_output *output) {
 			&output->layers[ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY]);
 
 renderer_end:
-	wlr_renderer_scissor(renderer, NULL);
-	wlr_renderer_end(renderer);
+	render_end(&data);
 
 	if (server->config->debug_damage_tracking) {
 		int width, height;
@@ -527,6 +910,18 @@ renderer_end:
 		pixman_region32_union_rect(&damage, &damage, 0, 0, width, height);
 	}
 
+	if (data.ops != NULL) {
+		// Buffers are swapped and frame done events sent once the thread is
+		// done, see output_handle_render_done
+		pixman_region32_copy(&output->render_damage, &damage);
+		output->render_when = now;
+		wlr_output_damage_defer_swap(output->damage);
+		wlr_output_render_thread_submit(output->render_thread,
+			render_thread_render, output);
+		pixman_region32_fini(&damage);
+		return;
+	}
+
 	if (!wlr_output_damage_swap_buffers(output->damage, &now, &damage)) {
 		goto damage_finish;
 	}
@@ -536,33 +931,7 @@ damage_finish:
 	pixman_region32_fini(&damage);
 
 	// Send frame done events to all surfaces
-	if (output->fullscreen_view != NULL) {
-		struct roots_view *view = output->fullscreen_view;
-		if (wlr_output->fullscreen_surface == view->wlr_surface) {
-			// The surface is managed by the wlr_output
-			return;
-		}
-
-		view_for_each_surface(view, &data.layout, surface_send_frame_done,
-			&data);
-
-#ifdef WLR_HAS_XWAYLAND
-		if (view->type == ROOTS_XWAYLAND_VIEW) {
-			xwayland_children_for_each_surface(view->xwayland_surface,
-				surface_send_frame_done, &data.layout, &data);
-		}
-#endif
-	} else {
-		struct roots_view *view;
-		wl_list_for_each_reverse(view, &desktop->views, link) {
-			view_for_each_surface(view, &data.layout, surface_send_frame_done,
-				&data);
-		}
-
-		drag_icons_for_each_surface(server->input, surface_send_frame_done,
-			&data.layout, &data);
-	}
-	layers_send_done(output, data.when);
+	send_frame_done(output, &now);
 }
 
 void output_damage_whole(struct roots_output *output) {
@@ -769,6 +1138,12 @@ static void output_destroy(struct roots_output *output) {
 	//example_config_configure_cursor(sample->config, sample->cursor,
 	//	sample->compositor);
 
+	// Wait for the frame being rendered, if any, before releasing its buffers
+	stop_render_thread(output);
+	release_render_ops(output);
+	wl_array_release(&output->render_ops);
+	pixman_region32_fini(&output->render_damage);
+
 	wl_list_remove(&output->link);
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->mode.link);
@@ -797,6 +1172,28 @@ static void output_damage_handle_destroy(struct wl_listener *listener,
 	output_destroy(output);
 }
 
+static void output_handle_render_done(struct wl_listener *listener,
+		void *data) {
+	struct roots_output *output =
+		wl_container_of(listener, output, render_done);
+	struct wlr_output_render_thread_done_event *event = data;
+
+	if (!event->rendered) {
+		wlr_log(L_ERROR, "Failed to render output '%s' on its thread, "
+			"rendering it on the main thread", output->wlr_output->name);
+		wlr_output_damage_cancel_swap(output->damage);
+		output->render_thread_failed = true;
+	} else if (wlr_output_damage_swap_buffers(output->damage,
+			&output->render_when, &output->render_damage)) {
+		output->last_frame = output->desktop->last_frame = output->render_when;
+	}
+
+	release_render_ops(output);
+	pixman_region32_clear(&output->render_damage);
+
+	send_frame_done(output, &output->render_when);
+}
+
 static void output_handle_mode(struct wl_listener *listener, void *data) {
 	struct roots_output *output =
 		wl_container_of(listener, output, mode);
@@ -833,6 +1230,8 @@ void handle_new_output(struct wl_listener *listener, void *data) {
 	output->wlr_output = wlr_output;
 	wlr_output->data = output;
 	wl_list_insert(&desktop->outputs, &output->link);
+	wl_array_init(&output->render_ops);
+	pixman_region32_init(&output->render_damage);
 
 	output->damage = wlr_output_damage_create(wlr_output);
 
@@ -848,6 +1247,18 @@ void handle_new_output(struct wl_listener *listener, void *data) {
 	output->damage_destroy.notify = output_damage_handle_destroy;
 	wl_signal_add(&output->damage->events.destroy, &output->damage_destroy);
 
+	if (config->render_threads) {
+		output->render_thread = wlr_output_render_thread_create(wlr_output);
+		if (output->render_thread != NULL) {
+			output->render_done.notify = output_handle_render_done;
+			wl_signal_add(&output->render_thread->events.done,
+				&output->render_done);
+		} else {
+			wlr_log(L_ERROR, "Failed to start render thread for output '%s', "
+				"rendering it on the main thread", wlr_output->name);
+		}
+	}
+
 	size_t len = sizeof(output->layers) / sizeof(output->layers[0]);
 	for (size_t i = 0; i < len; ++i) {
 		wl_list_init(&output->layers[i]);
@@ -6,6 +6,7 @@
 #include <wayland-server.h>
 #include <wlr/config.h>
 #include <wlr/types/wlr_idle.h>
+#include <wlr/types/wlr_input_latency.h>
 #include <wlr/types/wlr_layer_shell.h>
 #include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/util/log.h>
@@ -217,6 +218,13 @@ static void roots_seat_init_cursor(struct roots_seat *seat) {
 	struct roots_desktop *desktop = seat->input->server->desktop;
 	wlr_cursor_attach_output_layout(wlr_cursor, desktop->layout);
 
+	struct roots_cursor_config *cc =
+		roots_config_get_cursor(seat->input->config, seat->seat->name);
+	if (cc != NULL && cc->coalesce_motion) {
+		wlr_cursor_set_motion_coalescing(wlr_cursor,
+			seat->input->server->wl_event_loop, cc->coalesce_motion_interval);
+	}
+
 	roots_seat_configure_cursor(seat);
 	roots_seat_configure_xcursor(seat);
 
@@ -394,6 +402,19 @@ struct roots_seat *roots_seat_create(struct roots_input *input, char *name) {
 		return NULL;
 	}
 
+	if (input->config->input_latency_log_interval > 0) {
+		// Destroyed along with the seat
+		struct wlr_input_latency *latency = wlr_input_latency_create(
+			seat->seat, input->server->desktop->layout);
+		if (latency != NULL) {
+			wlr_input_latency_set_log_interval(latency,
+				input->config->input_latency_log_interval * 1000);
+		}
+	}
+
+	wlr_seat_set_selection_cache_size(seat->seat,
+		input->config->selection_cache_size);
+
 	wl_list_insert(&input->seats, &seat->link);
 
 	seat->new_drag_icon.notify = roots_seat_handle_new_drag_icon;
@@ -753,6 +774,7 @@ void roots_seat_set_focus(struct roots_seat *seat, struct roots_view *view) {
 	if (view != NULL) {
 		wl_list_remove(&view->link);
 		wl_list_insert(&seat->input->server->desktop->views, &view->link);
+		view->stack_serial = ++view->desktop->view_stack_serial;
 	}
 
 	bool unfullscreen = true;
@@ -1014,7 +1036,7 @@ void roots_seat_end_compositor_grab(struct roots_seat *seat) {
 			view_move_resize(view, cursor->view_x, cursor->view_y, cursor->view_width, cursor->view_height);
 			break;
 		case ROOTS_CURSOR_ROTATE:
-			view->rotation = cursor->view_rotation;
+			view_rotate(view, cursor->view_rotation);
 			break;
 		case ROOTS_CURSOR_PASSTHROUGH:
 			break;
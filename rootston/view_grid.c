@@ -0,0 +1,182 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "rootston/view.h"
+#include "rootston/view_grid.h"
+
+#define VIEW_GRID_MIN_BUCKETS 64
+
+static int cell_coord(int l) {
+	// Round towards negative infinity, layout coordinates can be negative
+	if (l < 0) {
+		return -((-l - 1) / VIEW_GRID_CELL_SIZE) - 1;
+	}
+	return l / VIEW_GRID_CELL_SIZE;
+}
+
+static size_t cell_hash(struct view_grid *grid, int x, int y) {
+	uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u;
+	return h & (grid->n_buckets - 1);
+}
+
+static bool grid_alloc_buckets(struct view_grid *grid, size_t n_buckets) {
+	struct wl_list *buckets = calloc(n_buckets, sizeof(struct wl_list));
+	if (buckets == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return false;
+	}
+	for (size_t i = 0; i < n_buckets; ++i) {
+		wl_list_init(&buckets[i]);
+	}
+
+	struct wl_list *old_buckets = grid->buckets;
+	size_t old_n_buckets = grid->n_buckets;
+	grid->buckets = buckets;
+	grid->n_buckets = n_buckets;
+
+	for (size_t i = 0; i < old_n_buckets; ++i) {
+		struct view_grid_cell *cell, *tmp;
+		wl_list_for_each_safe(cell, tmp, &old_buckets[i], link) {
+			wl_list_remove(&cell->link);
+			wl_list_insert(&buckets[cell_hash(grid, cell->x, cell->y)],
+				&cell->link);
+		}
+	}
+	free(old_buckets);
+	return true;
+}
+
+static struct view_grid_cell *grid_get_cell(struct view_grid *grid, int x,
+		int y, bool create) {
+	struct wl_list *bucket = &grid->buckets[cell_hash(grid, x, y)];
+	struct view_grid_cell *cell;
+	wl_list_for_each(cell, bucket, link) {
+		if (cell->x == x && cell->y == y) {
+			return cell;
+		}
+	}
+	if (!create) {
+		return NULL;
+	}
+
+	cell = calloc(1, sizeof(struct view_grid_cell));
+	if (cell == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return NULL;
+	}
+	if (!wlr_list_init(&cell->views)) {
+		free(cell);
+		return NULL;
+	}
+	cell->x = x;
+	cell->y = y;
+	wl_list_insert(bucket, &cell->link);
+	grid->n_cells++;
+
+	if (grid->n_cells > 2 * grid->n_buckets) {
+		// Failing to grow only makes lookups slower
+		grid_alloc_buckets(grid, 2 * grid->n_buckets);
+	}
+	return cell;
+}
+
+static void cell_destroy(struct view_grid *grid, struct view_grid_cell *cell) {
+	wl_list_remove(&cell->link);
+	wlr_list_finish(&cell->views);
+	free(cell);
+	grid->n_cells--;
+}
+
+bool view_grid_init(struct view_grid *grid) {
+	grid->buckets = NULL;
+	grid->n_buckets = 0;
+	grid->n_cells = 0;
+	return grid_alloc_buckets(grid, VIEW_GRID_MIN_BUCKETS);
+}
+
+void view_grid_finish(struct view_grid *grid) {
+	for (size_t i = 0; i < grid->n_buckets; ++i) {
+		struct view_grid_cell *cell, *tmp;
+		wl_list_for_each_safe(cell, tmp, &grid->buckets[i], link) {
+			cell_destroy(grid, cell);
+		}
+	}
+	free(grid->buckets);
+	grid->buckets = NULL;
+	grid->n_buckets = 0;
+}
+
+void view_grid_remove_view(struct view_grid *grid, struct roots_view *view) {
+	if (!view->grid.indexed) {
+		return;
+	}
+
+	for (int y = view->grid.y1; y <= view->grid.y2; ++y) {
+		for (int x = view->grid.x1; x <= view->grid.x2; ++x) {
+			struct view_grid_cell *cell = grid_get_cell(grid, x, y, false);
+			if (cell == NULL) {
+				continue;
+			}
+			for (size_t i = 0; i < cell->views.length; ++i) {
+				if (cell->views.items[i] == view) {
+					wlr_list_del(&cell->views, i);
+					break;
+				}
+			}
+			if (cell->views.length == 0) {
+				cell_destroy(grid, cell);
+			}
+		}
+	}
+
+	view->grid.indexed = false;
+}
+
+void view_grid_update_view(struct view_grid *grid, struct roots_view *view,
+		const struct wlr_box *box) {
+	if (box->width <= 0 || box->height <= 0) {
+		view_grid_remove_view(grid, view);
+		return;
+	}
+
+	int x1 = cell_coord(box->x);
+	int y1 = cell_coord(box->y);
+	int x2 = cell_coord(box->x + box->width - 1);
+	int y2 = cell_coord(box->y + box->height - 1);
+	if (view->grid.indexed && view->grid.x1 == x1 && view->grid.y1 == y1 &&
+			view->grid.x2 == x2 && view->grid.y2 == y2) {
+		return;
+	}
+
+	view_grid_remove_view(grid, view);
+
+	view->grid.x1 = x1;
+	view->grid.y1 = y1;
+	view->grid.x2 = x2;
+	view->grid.y2 = y2;
+	view->grid.indexed = true;
+
+	for (int y = y1; y <= y2; ++y) {
+		for (int x = x1; x <= x2; ++x) {
+			struct view_grid_cell *cell = grid_get_cell(grid, x, y, true);
+			if (cell == NULL || wlr_list_push(&cell->views, view) < 0) {
+				// Lookups would miss the view, better not index it at all
+				wlr_log(L_ERROR, "Failed to add view to the grid");
+				view_grid_remove_view(grid, view);
+				return;
+			}
+		}
+	}
+}
+
+struct wlr_list *view_grid_views_at(struct view_grid *grid, double lx,
+		double ly) {
+	struct view_grid_cell *cell = grid_get_cell(grid,
+		cell_coord(floor(lx)), cell_coord(floor(ly)), false);
+	if (cell == NULL) {
+		return NULL;
+	}
+	return &cell->views;
+}
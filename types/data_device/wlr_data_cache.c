@@ -0,0 +1,397 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wayland-server.h>
+#include <wlr/types/wlr_data_device.h>
+#include <wlr/util/log.h>
+#include "types/wlr_data_device.h"
+#include "util/os-compatibility.h"
+
+#define DATA_CACHE_CHUNK_SIZE (1 << 20)
+
+/**
+ * The data sent by the source for a MIME type. The first receive is relayed
+ * from a pipe given to the source, and copied to `fd` on the way with tee().
+ * Later receives are served from `fd`, without asking the source again.
+ *
+ * An entry which is neither complete nor being filled didn't fit in the cache,
+ * its receives go straight to the source.
+ */
+struct data_cache_entry {
+	struct wlr_data_source_cache *cache;
+	char *mime_type;
+	int fd; // -1 if the data didn't fit
+	size_t size;
+	bool complete;
+	struct data_cache_transfer *fill; // NULL if not being filled
+	struct wl_list link; // wlr_data_source_cache::entries
+};
+
+struct data_cache_transfer {
+	struct data_cache_entry *entry; // being filled, NULL if none
+	int source_fd; // pipe from the source, -1 if served from the cache
+	int cache_fd; // -1 if relayed from the source
+	off_t offset;
+	size_t size;
+	int target_fd;
+
+	struct wl_event_loop *event_loop;
+	struct wl_event_source *source_event; // NULL while the target is full
+	struct wl_event_source *target_event;
+};
+
+struct wlr_data_source_cache {
+	struct wl_event_loop *event_loop;
+	size_t max_size, size;
+	struct wl_list entries; // data_cache_entry::link
+};
+
+static void entry_drop_data(struct data_cache_entry *entry) {
+	if (entry->fill != NULL) {
+		entry->fill->entry = NULL;
+		entry->fill = NULL;
+	}
+	if (entry->fd >= 0) {
+		close(entry->fd);
+		entry->fd = -1;
+	}
+	entry->cache->size -= entry->size;
+	entry->size = 0;
+	entry->complete = false;
+}
+
+static void entry_destroy(struct data_cache_entry *entry) {
+	entry_drop_data(entry);
+	wl_list_remove(&entry->link);
+	free(entry->mime_type);
+	free(entry);
+}
+
+static void transfer_destroy(struct data_cache_transfer *transfer) {
+	if (transfer->entry != NULL) {
+		// Incomplete, ask the source again next time
+		entry_destroy(transfer->entry);
+	}
+	if (transfer->source_event != NULL) {
+		wl_event_source_remove(transfer->source_event);
+	}
+	wl_event_source_remove(transfer->target_event);
+	if (transfer->source_fd >= 0) {
+		close(transfer->source_fd);
+	}
+	if (transfer->cache_fd >= 0) {
+		close(transfer->cache_fd);
+	}
+	close(transfer->target_fd);
+	free(transfer);
+}
+
+static void transfer_complete(struct data_cache_transfer *transfer) {
+	struct data_cache_entry *entry = transfer->entry;
+	if (entry != NULL) {
+		wlr_log(L_DEBUG, "Cached %zu bytes of %s selection data", entry->size,
+			entry->mime_type);
+		entry->complete = true;
+		entry->fill = NULL;
+		transfer->entry = NULL;
+	}
+	transfer_destroy(transfer);
+}
+
+static void discard(int fd, size_t len) {
+	char buf[4096];
+	while (len > 0) {
+		ssize_t n = read(fd, buf, len < sizeof(buf) ? len : sizeof(buf));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		len -= n;
+	}
+}
+
+/**
+ * Moves `len` bytes, which have already been sent to the target, from the
+ * pipe to the cache.
+ */
+static void transfer_append(struct data_cache_transfer *transfer, size_t len) {
+	struct data_cache_entry *entry = transfer->entry;
+	while (len > 0) {
+		ssize_t n = splice(transfer->source_fd, NULL, entry->fd, NULL, len,
+			SPLICE_F_MOVE);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			wlr_log_errno(L_ERROR, "Failed to cache selection data");
+			entry_drop_data(entry);
+			discard(transfer->source_fd, len);
+			return;
+		}
+		len -= n;
+		entry->size += n;
+		entry->cache->size += n;
+	}
+}
+
+static int transfer_handle_source_readable(int fd, uint32_t mask,
+		void *data);
+
+/**
+ * Waits for the target to be writable. The source's event is removed rather
+ * than disabled, because a hangup would still be reported.
+ */
+static void transfer_wait_target(struct data_cache_transfer *transfer) {
+	wl_event_source_remove(transfer->source_event);
+	transfer->source_event = NULL;
+	wl_event_source_fd_update(transfer->target_event, WL_EVENT_WRITABLE);
+}
+
+static bool transfer_wait_source(struct data_cache_transfer *transfer) {
+	wl_event_source_fd_update(transfer->target_event, 0);
+	transfer->source_event = wl_event_loop_add_fd(transfer->event_loop,
+		transfer->source_fd, WL_EVENT_READABLE,
+		transfer_handle_source_readable, transfer);
+	return transfer->source_event != NULL;
+}
+
+static int transfer_handle_source_readable(int fd, uint32_t mask,
+		void *data) {
+	struct data_cache_transfer *transfer = data;
+	while (true) {
+		struct data_cache_entry *entry = transfer->entry;
+		size_t len = DATA_CACHE_CHUNK_SIZE;
+		if (entry != NULL) {
+			struct wlr_data_source_cache *cache = entry->cache;
+			if (cache->size >= cache->max_size) {
+				wlr_log(L_DEBUG, "%s selection data doesn't fit in the "
+					"cache", entry->mime_type);
+				entry_drop_data(entry);
+				entry = NULL;
+			} else if (cache->max_size - cache->size < len) {
+				len = cache->max_size - cache->size;
+			}
+		}
+
+		ssize_t n;
+		if (entry != NULL) {
+			n = tee(transfer->source_fd, transfer->target_fd, len,
+				SPLICE_F_NONBLOCK);
+		} else {
+			n = splice(transfer->source_fd, NULL, transfer->target_fd, NULL,
+				len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		}
+		if (n == 0) {
+			transfer_complete(transfer);
+			return 0;
+		} else if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) {
+				// Either the source hasn't written more yet, or the target is
+				// full. In the former case the target is writable right away.
+				transfer_wait_target(transfer);
+				return 0;
+			}
+			wlr_log_errno(L_ERROR, "Failed to relay selection data");
+			transfer_destroy(transfer);
+			return 0;
+		}
+
+		if (entry != NULL) {
+			transfer_append(transfer, n);
+		}
+	}
+}
+
+static int transfer_handle_target_writable(int fd, uint32_t mask,
+		void *data) {
+	struct data_cache_transfer *transfer = data;
+	if (transfer->source_fd >= 0) {
+		// Unless the target was closed, it has room again
+		if (transfer->source_event != NULL ||
+				!transfer_wait_source(transfer)) {
+			transfer_destroy(transfer);
+		}
+		return 0;
+	}
+
+	while ((size_t)transfer->offset < transfer->size) {
+		ssize_t n = sendfile(transfer->target_fd, transfer->cache_fd,
+			&transfer->offset, transfer->size - transfer->offset);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) {
+				return 0;
+			}
+			wlr_log_errno(L_ERROR, "Failed to send cached selection data");
+			break;
+		} else if (n == 0) {
+			break;
+		}
+	}
+	transfer_destroy(transfer);
+	return 0;
+}
+
+static bool set_nonblock(int fd) {
+	int flags = fcntl(fd, F_GETFL);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static struct data_cache_transfer *transfer_create(
+		struct wlr_data_source_cache *cache, int target_fd) {
+	if (!set_nonblock(target_fd)) {
+		return NULL;
+	}
+	struct data_cache_transfer *transfer =
+		calloc(1, sizeof(struct data_cache_transfer));
+	if (transfer == NULL) {
+		return NULL;
+	}
+	transfer->source_fd = -1;
+	transfer->cache_fd = -1;
+	transfer->target_fd = target_fd;
+	transfer->event_loop = cache->event_loop;
+	transfer->target_event = wl_event_loop_add_fd(cache->event_loop,
+		target_fd, 0, transfer_handle_target_writable, transfer);
+	if (transfer->target_event == NULL) {
+		free(transfer);
+		return NULL;
+	}
+	return transfer;
+}
+
+static bool cache_serve(struct wlr_data_source_cache *cache,
+		struct data_cache_entry *entry, int32_t fd) {
+	// The entry may go away before the transfer is done
+	int cache_fd = fcntl(entry->fd, F_DUPFD_CLOEXEC, 0);
+	if (cache_fd < 0) {
+		return false;
+	}
+	struct data_cache_transfer *transfer = transfer_create(cache, fd);
+	if (transfer == NULL) {
+		close(cache_fd);
+		return false;
+	}
+	transfer->cache_fd = cache_fd;
+	transfer->size = entry->size;
+	wl_event_source_fd_update(transfer->target_event, WL_EVENT_WRITABLE);
+	return true;
+}
+
+static bool cache_fill(struct wlr_data_source_cache *cache,
+		struct wlr_data_source *source, const char *mime_type, int32_t fd) {
+	// tee() only works between pipes
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISFIFO(st.st_mode)) {
+		return false;
+	}
+
+	struct data_cache_entry *entry =
+		calloc(1, sizeof(struct data_cache_entry));
+	if (entry == NULL) {
+		return false;
+	}
+	entry->cache = cache;
+	entry->mime_type = strdup(mime_type);
+	entry->fd = os_create_empty_file("wlroots-data-cache");
+	if (entry->mime_type == NULL || entry->fd < 0) {
+		goto error_entry;
+	}
+
+	int p[2];
+	if (pipe2(p, O_CLOEXEC | O_NONBLOCK) != 0) {
+		goto error_entry;
+	}
+
+	struct data_cache_transfer *transfer = transfer_create(cache, fd);
+	if (transfer == NULL) {
+		goto error_pipe;
+	}
+	transfer->source_fd = p[0];
+	if (!transfer_wait_source(transfer)) {
+		wl_event_source_remove(transfer->target_event);
+		free(transfer);
+		goto error_pipe;
+	}
+
+	transfer->entry = entry;
+	entry->fill = transfer;
+	wl_list_insert(&cache->entries, &entry->link);
+
+	source->impl->send(source, mime_type, p[1]);
+	return true;
+
+error_pipe:
+	close(p[0]);
+	close(p[1]);
+error_entry:
+	if (entry->fd >= 0) {
+		close(entry->fd);
+	}
+	free(entry->mime_type);
+	free(entry);
+	return false;
+}
+
+struct wlr_data_source_cache *data_source_cache_create(
+		struct wl_event_loop *event_loop, size_t max_size) {
+	struct wlr_data_source_cache *cache =
+		calloc(1, sizeof(struct wlr_data_source_cache));
+	if (cache == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return NULL;
+	}
+	cache->event_loop = event_loop;
+	cache->max_size = max_size;
+	wl_list_init(&cache->entries);
+	return cache;
+}
+
+void data_source_cache_destroy(struct wlr_data_source_cache *cache) {
+	if (cache == NULL) {
+		return;
+	}
+	// Transfers in progress carry on without the cache
+	struct data_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &cache->entries, link) {
+		entry_destroy(entry);
+	}
+	free(cache);
+}
+
+void data_source_cache_send(struct wlr_data_source *source,
+		const char *mime_type, int32_t fd) {
+	struct wlr_data_source_cache *cache = source->cache;
+	struct data_cache_entry *entry, *found = NULL;
+	wl_list_for_each(entry, &cache->entries, link) {
+		if (strcmp(entry->mime_type, mime_type) == 0) {
+			found = entry;
+			break;
+		}
+	}
+
+	if (found == NULL) {
+		if (cache_fill(cache, source, mime_type, fd)) {
+			return;
+		}
+	} else if (found->complete) {
+		if (cache_serve(cache, found, fd)) {
+			return;
+		}
+	}
+
+	// Not cacheable or already being filled
+	source->impl->send(source, mime_type, fd);
+}
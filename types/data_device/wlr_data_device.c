@@ -148,6 +148,14 @@ void wlr_seat_set_selection(struct wlr_seat *seat,
 	seat->selection_source = source;
 	seat->selection_serial = serial;
 
+	if (source != NULL && source->cache == NULL &&
+			seat->selection_cache_size > 0) {
+		struct wl_event_loop *event_loop =
+			wl_display_get_event_loop(seat->display);
+		source->cache = data_source_cache_create(event_loop,
+			seat->selection_cache_size);
+	}
+
 	struct wlr_seat_client *focused_client =
 		seat->keyboard_state.focused_client;
 
@@ -165,6 +173,11 @@ void wlr_seat_set_selection(struct wlr_seat *seat,
 	}
 }
 
+void wlr_seat_set_selection_cache_size(struct wlr_seat *seat,
+		size_t max_size) {
+	seat->selection_cache_size = max_size;
+}
+
 
 static const struct wl_data_device_manager_interface data_device_manager_impl;
 
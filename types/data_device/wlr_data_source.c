@@ -63,6 +63,7 @@ void wlr_data_source_init(struct wlr_data_source *source,
 	wl_array_init(&source->mime_types);
 	wl_signal_init(&source->events.destroy);
 	source->actions = -1;
+	source->cache = NULL;
 }
 
 void wlr_data_source_finish(struct wlr_data_source *source) {
@@ -72,6 +73,9 @@ void wlr_data_source_finish(struct wlr_data_source *source) {
 
 	wlr_signal_emit_safe(&source->events.destroy, source);
 
+	data_source_cache_destroy(source->cache);
+	source->cache = NULL;
+
 	char **p;
 	wl_array_for_each(p, &source->mime_types) {
 		free(*p);
@@ -81,6 +85,10 @@ void wlr_data_source_finish(struct wlr_data_source *source) {
 
 void wlr_data_source_send(struct wlr_data_source *source, const char *mime_type,
 		int32_t fd) {
+	if (source->cache != NULL) {
+		data_source_cache_send(source, mime_type, fd);
+		return;
+	}
 	source->impl->send(source, mime_type, fd);
 }
 
@@ -10,6 +10,7 @@
 #include <wlr/types/wlr_seat.h>
 #include <wlr/util/log.h>
 #include "types/wlr_seat.h"
+#include "util/hash_table.h"
 #include "util/signal.h"
 
 #define SEAT_VERSION 6
@@ -93,6 +94,8 @@ static void seat_client_handle_resource_destroy(
 		wl_resource_destroy(resource);
 	}
 
+	hash_table_remove(client->seat->client_table,
+		hash_table_ptr_key(client->client));
 	wl_list_remove(&client->link);
 	free(client);
 }
@@ -131,6 +134,14 @@ static void seat_handle_bind(struct wl_client *client, void *_wlr_seat,
 			return;
 		}
 
+		if (!hash_table_set(wlr_seat->client_table,
+				hash_table_ptr_key(client), seat_client)) {
+			free(seat_client);
+			wl_resource_destroy(wl_resource);
+			wl_client_post_no_memory(client);
+			return;
+		}
+
 		seat_client->client = client;
 		seat_client->seat = wlr_seat;
 		wl_list_init(&seat_client->wl_resources);
@@ -191,6 +202,8 @@ void wlr_seat_destroy(struct wlr_seat *seat) {
 	}
 
 	wl_global_destroy(seat->wl_global);
+	hash_table_finish(seat->client_table);
+	free(seat->client_table);
 	free(seat->pointer_state.default_grab);
 	free(seat->keyboard_state.default_grab);
 	free(seat->touch_state.default_grab);
@@ -258,9 +271,20 @@ struct wlr_seat *wlr_seat_create(struct wl_display *display, const char *name) {
 	seat->touch_state.seat = seat;
 	wl_list_init(&seat->touch_state.touch_points);
 
+	seat->client_table = calloc(1, sizeof(struct hash_table));
+	if (seat->client_table == NULL) {
+		free(touch_grab);
+		free(pointer_grab);
+		free(keyboard_grab);
+		free(seat);
+		return NULL;
+	}
+	hash_table_init(seat->client_table);
+
 	seat->wl_global = wl_global_create(display, &wl_seat_interface,
 		SEAT_VERSION, seat, seat_handle_bind);
 	if (seat->wl_global == NULL) {
+		free(seat->client_table);
 		free(touch_grab);
 		free(pointer_grab);
 		free(keyboard_grab);
@@ -299,13 +323,8 @@ struct wlr_seat *wlr_seat_create(struct wl_display *display, const char *name) {
 
 struct wlr_seat_client *wlr_seat_client_for_wl_client(struct wlr_seat *wlr_seat,
 		struct wl_client *wl_client) {
-	struct wlr_seat_client *seat_client;
-	wl_list_for_each(seat_client, &wlr_seat->clients, link) {
-		if (seat_client->client == wl_client) {
-			return seat_client;
-		}
-	}
-	return NULL;
+	return hash_table_get(wlr_seat->client_table,
+		hash_table_ptr_key(wl_client));
 }
 
 void wlr_seat_set_capabilities(struct wlr_seat *wlr_seat,
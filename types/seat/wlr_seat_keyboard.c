@@ -8,6 +8,8 @@
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_primary_selection.h>
 #include <wlr/util/log.h>
+#include "types/wlr_input_latency.h"
+#include "types/wlr_keyboard.h"
 #include "types/wlr_seat.h"
 #include "util/signal.h"
 
@@ -321,14 +323,25 @@ void wlr_seat_keyboard_notify_key(struct wlr_seat *seat, uint32_t time,
 	clock_gettime(CLOCK_MONOTONIC, &seat->last_event);
 	struct wlr_seat_keyboard_grab *grab = seat->keyboard_state.grab;
 	grab->interface->key(grab, time, key, state);
+
+	if (seat->input_latency != NULL) {
+		input_latency_handle_event(seat->input_latency, time,
+			seat->keyboard_state.focused_surface,
+			state == WL_KEYBOARD_KEY_STATE_PRESSED);
+	}
 }
 
 
 static void seat_client_send_keymap(struct wlr_seat_client *client,
 		struct wlr_keyboard *keyboard) {
-	if (!keyboard) {
+	if (!keyboard || keyboard->keymap_file == NULL) {
 		return;
 	}
+	// Keyboards with identical keymaps share the same file
+	if (client->keymap_id == keyboard->keymap_file->id) {
+		return;
+	}
+	client->keymap_id = keyboard->keymap_file->id;
 
 	// TODO: We should probably lift all of the keys set by the other
 	// keyboard
@@ -376,8 +389,13 @@ void seat_client_create_keyboard(struct wlr_seat_client *seat_client,
 		keyboard_handle_resource_destroy);
 	wl_list_insert(&seat_client->keyboards, wl_resource_get_link(resource));
 
+	// Other resources of the client already have the current keymap
 	struct wlr_keyboard *keyboard = seat_client->seat->keyboard_state.keyboard;
-	seat_client_send_keymap(seat_client, keyboard);
+	if (keyboard != NULL && keyboard->keymap_file != NULL) {
+		wl_keyboard_send_keymap(resource, WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1,
+			keyboard->keymap_fd, keyboard->keymap_size);
+		seat_client->keymap_id = keyboard->keymap_file->id;
+	}
 	seat_client_send_repeat_info(seat_client, keyboard);
 
 	// TODO possibly handle the case where this keyboard needs an enter
@@ -6,6 +6,7 @@
 #include <wayland-server.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/util/log.h>
+#include "types/wlr_input_latency.h"
 #include "types/wlr_seat.h"
 #include "util/signal.h"
 
@@ -291,6 +292,11 @@ void wlr_seat_pointer_notify_motion(struct wlr_seat *wlr_seat, uint32_t time,
 	clock_gettime(CLOCK_MONOTONIC, &wlr_seat->last_event);
 	struct wlr_seat_pointer_grab *grab = wlr_seat->pointer_state.grab;
 	grab->interface->motion(grab, time, sx, sy);
+
+	if (wlr_seat->input_latency != NULL) {
+		input_latency_handle_event(wlr_seat->input_latency, time,
+			wlr_seat->pointer_state.focused_surface, false);
+	}
 }
 
 uint32_t wlr_seat_pointer_notify_button(struct wlr_seat *wlr_seat,
@@ -313,6 +319,12 @@ uint32_t wlr_seat_pointer_notify_button(struct wlr_seat *wlr_seat,
 		wlr_seat->pointer_state.grab_serial = serial;
 	}
 
+	if (wlr_seat->input_latency != NULL) {
+		input_latency_handle_event(wlr_seat->input_latency, time,
+			wlr_seat->pointer_state.focused_surface,
+			state == WL_POINTER_BUTTON_STATE_PRESSED);
+	}
+
 	return serial;
 }
 
@@ -323,6 +335,11 @@ void wlr_seat_pointer_notify_axis(struct wlr_seat *wlr_seat, uint32_t time,
 	struct wlr_seat_pointer_grab *grab = wlr_seat->pointer_state.grab;
 	grab->interface->axis(grab, time, orientation, value, value_discrete,
 		source);
+
+	if (wlr_seat->input_latency != NULL) {
+		input_latency_handle_event(wlr_seat->input_latency, time,
+			wlr_seat->pointer_state.focused_surface, false);
+	}
 }
 
 bool wlr_seat_pointer_has_grab(struct wlr_seat *seat) {
@@ -6,6 +6,7 @@
 #include <wayland-server.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/util/log.h>
+#include "types/wlr_input_latency.h"
 #include "types/wlr_seat.h"
 #include "util/signal.h"
 
@@ -177,6 +178,11 @@ uint32_t wlr_seat_touch_notify_down(struct wlr_seat *seat,
 		seat->touch_state.grab_id = touch_id;
 	}
 
+	if (seat->input_latency != NULL) {
+		input_latency_handle_event(seat->input_latency, time, point->surface,
+			true);
+	}
+
 	return serial;
 }
 
@@ -207,6 +213,11 @@ void wlr_seat_touch_notify_motion(struct wlr_seat *seat, uint32_t time,
 	point->sy = sy;
 
 	grab->interface->motion(grab, time, point);
+
+	if (seat->input_latency != NULL) {
+		input_latency_handle_event(seat->input_latency, time, point->surface,
+			false);
+	}
 }
 
 static void handle_point_focus_destroy(struct wl_listener *listener,
@@ -8,6 +8,7 @@
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
+#include "types/wlr_input_latency.h"
 #include "util/signal.h"
 
 struct wlr_cursor_device {
@@ -54,6 +55,23 @@ struct wlr_cursor_state {
 	struct wl_listener layout_add;
 	struct wl_listener layout_change;
 	struct wl_listener layout_destroy;
+
+	// Motion coalescing, see wlr_cursor_set_motion_coalescing
+	struct wl_event_loop *coalesce_loop;
+	uint32_t coalesce_interval_ms;
+	struct wl_event_source *coalesce_idle; // when pending and no interval
+	struct wl_event_source *coalesce_timer;
+	bool coalesce_timer_armed;
+	enum wlr_cursor_pending_motion {
+		WLR_CURSOR_PENDING_NONE,
+		WLR_CURSOR_PENDING_MOTION,
+		WLR_CURSOR_PENDING_MOTION_ABSOLUTE,
+	} pending;
+	struct wlr_event_pointer_motion pending_motion;
+	struct wlr_event_pointer_motion_absolute pending_motion_absolute;
+	// Arrival of the first coalesced event, for input latency tracking
+	bool pending_arrival_set;
+	struct timespec pending_arrival;
 };
 
 struct wlr_cursor *wlr_cursor_create(void) {
@@ -145,12 +163,23 @@ static void cursor_device_destroy(struct wlr_cursor_device *c_device) {
 		wl_list_remove(&c_device->tablet_tool_button.link);
 	}
 
+	// Don't emit motion for a device that's going away
+	struct wlr_cursor_state *state = c_device->cursor->state;
+	if ((state->pending == WLR_CURSOR_PENDING_MOTION &&
+			state->pending_motion.device == dev) ||
+			(state->pending == WLR_CURSOR_PENDING_MOTION_ABSOLUTE &&
+			state->pending_motion_absolute.device == dev)) {
+		state->pending = WLR_CURSOR_PENDING_NONE;
+	}
+
 	wl_list_remove(&c_device->link);
 	wl_list_remove(&c_device->destroy.link);
 	free(c_device);
 }
 
 void wlr_cursor_destroy(struct wlr_cursor *cur) {
+	cur->state->pending = WLR_CURSOR_PENDING_NONE;
+	wlr_cursor_set_motion_coalescing(cur, NULL, 0);
 	cursor_detach_output_layout(cur);
 
 	struct wlr_cursor_device *device, *device_tmp = NULL;
@@ -323,11 +352,114 @@ void wlr_cursor_set_surface(struct wlr_cursor *cur, struct wlr_surface *surface,
 	}
 }
 
+/**
+ * Emits the pending coalesced motion, if any. This must be called before
+ * emitting any other event so that clients see events in order.
+ */
+static void cursor_flush_motion(struct wlr_cursor *cur) {
+	struct wlr_cursor_state *state = cur->state;
+	if (state->coalesce_idle != NULL) {
+		wl_event_source_remove(state->coalesce_idle);
+		state->coalesce_idle = NULL;
+	}
+
+	enum wlr_cursor_pending_motion pending = state->pending;
+	state->pending = WLR_CURSOR_PENDING_NONE;
+	if (pending == WLR_CURSOR_PENDING_NONE) {
+		return;
+	}
+
+	// The motion is timed from the arrival of the first coalesced event, the
+	// flush may happen while handling another event
+	bool arrival_set = state->pending_arrival_set;
+	struct timespec outer_arrival;
+	bool outer_arrival_set = false;
+	if (arrival_set) {
+		outer_arrival_set = input_latency_get_event_arrival(&outer_arrival);
+		input_latency_begin_event(&state->pending_arrival);
+	}
+
+	if (pending == WLR_CURSOR_PENDING_MOTION) {
+		struct wlr_event_pointer_motion event = state->pending_motion;
+		wlr_signal_emit_safe(&cur->events.motion, &event);
+	} else {
+		struct wlr_event_pointer_motion_absolute event =
+			state->pending_motion_absolute;
+		wlr_signal_emit_safe(&cur->events.motion_absolute, &event);
+	}
+
+	if (outer_arrival_set) {
+		input_latency_begin_event(&outer_arrival);
+	} else if (arrival_set) {
+		input_latency_end_event();
+	}
+}
+
+static void cursor_set_pending(struct wlr_cursor *cur,
+		enum wlr_cursor_pending_motion pending) {
+	struct wlr_cursor_state *state = cur->state;
+	state->pending = pending;
+	state->pending_arrival_set =
+		input_latency_get_event_arrival(&state->pending_arrival);
+}
+
+static void handle_coalesce_idle(void *data) {
+	struct wlr_cursor_state *state = data;
+	// Idle sources are destroyed after being dispatched
+	state->coalesce_idle = NULL;
+	cursor_flush_motion(state->cursor);
+}
+
+static int handle_coalesce_timer(void *data) {
+	struct wlr_cursor_state *state = data;
+	state->coalesce_timer_armed = false;
+	cursor_flush_motion(state->cursor);
+	return 0;
+}
+
+static void cursor_schedule_flush(struct wlr_cursor *cur) {
+	struct wlr_cursor_state *state = cur->state;
+	if (state->coalesce_interval_ms > 0) {
+		if (!state->coalesce_timer_armed) {
+			wl_event_source_timer_update(state->coalesce_timer,
+				state->coalesce_interval_ms);
+			state->coalesce_timer_armed = true;
+		}
+		return;
+	}
+
+	if (state->coalesce_idle == NULL) {
+		state->coalesce_idle = wl_event_loop_add_idle(state->coalesce_loop,
+			handle_coalesce_idle, state);
+		if (state->coalesce_idle == NULL) {
+			wlr_log(L_ERROR, "Failed to add idle event source");
+			cursor_flush_motion(cur);
+		}
+	}
+}
+
 static void handle_pointer_motion(struct wl_listener *listener, void *data) {
 	struct wlr_event_pointer_motion *event = data;
 	struct wlr_cursor_device *device =
 		wl_container_of(listener, device, motion);
-	wlr_signal_emit_safe(&device->cursor->events.motion, event);
+	struct wlr_cursor_state *state = device->cursor->state;
+
+	if (state->coalesce_loop == NULL) {
+		wlr_signal_emit_safe(&device->cursor->events.motion, event);
+		return;
+	}
+
+	if (state->pending == WLR_CURSOR_PENDING_MOTION &&
+			state->pending_motion.device == event->device) {
+		state->pending_motion.time_msec = event->time_msec;
+		state->pending_motion.delta_x += event->delta_x;
+		state->pending_motion.delta_y += event->delta_y;
+	} else {
+		cursor_flush_motion(device->cursor);
+		cursor_set_pending(device->cursor, WLR_CURSOR_PENDING_MOTION);
+		state->pending_motion = *event;
+	}
+	cursor_schedule_flush(device->cursor);
 }
 
 static void apply_output_transform(double *x, double *y,
@@ -399,19 +531,35 @@ static void handle_pointer_motion_absolute(struct wl_listener *listener,
 	if (output) {
 		apply_output_transform(&event->x, &event->y, output->transform);
 	}
-	wlr_signal_emit_safe(&device->cursor->events.motion_absolute, event);
+
+	struct wlr_cursor_state *state = device->cursor->state;
+	if (state->coalesce_loop == NULL) {
+		wlr_signal_emit_safe(&device->cursor->events.motion_absolute, event);
+		return;
+	}
+
+	if (state->pending != WLR_CURSOR_PENDING_MOTION_ABSOLUTE ||
+			state->pending_motion_absolute.device != event->device) {
+		cursor_flush_motion(device->cursor);
+		cursor_set_pending(device->cursor,
+			WLR_CURSOR_PENDING_MOTION_ABSOLUTE);
+	}
+	state->pending_motion_absolute = *event;
+	cursor_schedule_flush(device->cursor);
 }
 
 static void handle_pointer_button(struct wl_listener *listener, void *data) {
 	struct wlr_event_pointer_button *event = data;
 	struct wlr_cursor_device *device =
 		wl_container_of(listener, device, button);
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.button, event);
 }
 
 static void handle_pointer_axis(struct wl_listener *listener, void *data) {
 	struct wlr_event_pointer_axis *event = data;
 	struct wlr_cursor_device *device = wl_container_of(listener, device, axis);
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.axis, event);
 }
 
@@ -419,6 +567,7 @@ static void handle_touch_up(struct wl_listener *listener, void *data) {
 	struct wlr_event_touch_up *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, touch_up);
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.touch_up, event);
 }
 
@@ -432,6 +581,7 @@ static void handle_touch_down(struct wl_listener *listener, void *data) {
 	if (output) {
 		apply_output_transform(&event->x, &event->y, output->transform);
 	}
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.touch_down, event);
 }
 
@@ -445,6 +595,7 @@ static void handle_touch_motion(struct wl_listener *listener, void *data) {
 	if (output) {
 		apply_output_transform(&event->x, &event->y, output->transform);
 	}
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.touch_motion, event);
 }
 
@@ -452,6 +603,7 @@ static void handle_touch_cancel(struct wl_listener *listener, void *data) {
 	struct wlr_event_touch_cancel *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, touch_cancel);
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.touch_cancel, event);
 }
 
@@ -465,6 +617,7 @@ static void handle_tablet_tool_tip(struct wl_listener *listener, void *data) {
 	if (output) {
 		apply_output_transform(&event->x, &event->y, output->transform);
 	}
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.tablet_tool_tip, event);
 }
 
@@ -478,6 +631,7 @@ static void handle_tablet_tool_axis(struct wl_listener *listener, void *data) {
 	if (output) {
 		apply_output_transform(&event->x, &event->y, output->transform);
 	}
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.tablet_tool_axis, event);
 }
 
@@ -486,6 +640,7 @@ static void handle_tablet_tool_button(struct wl_listener *listener,
 	struct wlr_event_tablet_tool_button *event = data;
 	struct wlr_cursor_device *device;
 	device = wl_container_of(listener, device, tablet_tool_button);
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.tablet_tool_button, event);
 }
 
@@ -500,6 +655,7 @@ static void handle_tablet_tool_proximity(struct wl_listener *listener,
 	if (output) {
 		apply_output_transform(&event->x, &event->y, output->transform);
 	}
+	cursor_flush_motion(device->cursor);
 	wlr_signal_emit_safe(&device->cursor->events.tablet_tool_proximity, event);
 }
 
@@ -733,3 +889,28 @@ void wlr_cursor_map_input_to_region(struct wlr_cursor *cur,
 
 	c_device->mapped_box = box;
 }
+
+void wlr_cursor_set_motion_coalescing(struct wlr_cursor *cur,
+		struct wl_event_loop *loop, uint32_t interval_ms) {
+	struct wlr_cursor_state *state = cur->state;
+	cursor_flush_motion(cur);
+	if (state->coalesce_timer != NULL) {
+		wl_event_source_remove(state->coalesce_timer);
+		state->coalesce_timer = NULL;
+		state->coalesce_timer_armed = false;
+	}
+
+	state->coalesce_loop = loop;
+	state->coalesce_interval_ms = interval_ms;
+	if (loop == NULL || interval_ms == 0) {
+		return;
+	}
+
+	state->coalesce_timer = wl_event_loop_add_timer(loop,
+		handle_coalesce_timer, state);
+	if (state->coalesce_timer == NULL) {
+		wlr_log(L_ERROR, "Failed to add timer event source, "
+			"disabling motion coalescing");
+		state->coalesce_loop = NULL;
+	}
+}
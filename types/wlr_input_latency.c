@@ -0,0 +1,406 @@
+#define _POSIX_C_SOURCE 199309L
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wlr/types/wlr_input_latency.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+#include "types/wlr_input_latency.h"
+#include "util/signal.h"
+#include "util/time.h"
+
+// Samples above this are assumed to come from a different clock or from a
+// response to something else, they are dropped
+#define INPUT_LATENCY_MAX_MSEC 1000
+
+struct wlr_input_latency_output {
+	struct wlr_input_latency *latency;
+	struct wlr_output *output;
+	struct wl_list link;
+
+	struct wl_listener swap_buffers;
+	struct wl_listener layout_output_destroy;
+};
+
+static const char *stage_names[WLR_INPUT_LATENCY_STAGE_COUNT] = {
+	[WLR_INPUT_LATENCY_DISPATCH] = "dispatch",
+	[WLR_INPUT_LATENCY_COMMIT] = "commit",
+	[WLR_INPUT_LATENCY_FRAME] = "frame",
+};
+
+static size_t histogram_bucket(int64_t nsec) {
+	uint64_t usec = nsec > 0 ? nsec / 1000 : 0;
+	if (usec < WLR_LATENCY_HISTOGRAM_SUB_BUCKETS) {
+		return usec;
+	}
+
+	// 8 sub-buckets per power of two: the exponent selects the group and the
+	// 3 bits after the leading one select the sub-bucket
+	int exp = 63 - __builtin_clzll(usec);
+	size_t sub = (usec >> (exp - 3)) & (WLR_LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+	size_t i = (exp - 2) * WLR_LATENCY_HISTOGRAM_SUB_BUCKETS + sub;
+	if (i >= WLR_LATENCY_HISTOGRAM_BUCKETS) {
+		i = WLR_LATENCY_HISTOGRAM_BUCKETS - 1;
+	}
+	return i;
+}
+
+static int64_t histogram_bucket_upper_nsec(size_t i) {
+	if (i < WLR_LATENCY_HISTOGRAM_SUB_BUCKETS) {
+		return (int64_t)(i + 1) * 1000;
+	}
+	int exp = i / WLR_LATENCY_HISTOGRAM_SUB_BUCKETS + 2;
+	size_t sub = i % WLR_LATENCY_HISTOGRAM_SUB_BUCKETS;
+	uint64_t usec = (WLR_LATENCY_HISTOGRAM_SUB_BUCKETS + sub + 1) <<
+		(exp - 3);
+	return (int64_t)usec * 1000;
+}
+
+void wlr_latency_histogram_add(struct wlr_latency_histogram *hist,
+		int64_t nsec) {
+	hist->buckets[histogram_bucket(nsec)]++;
+	hist->count++;
+	hist->sum_nsec += nsec;
+	if (nsec > hist->max_nsec) {
+		hist->max_nsec = nsec;
+	}
+}
+
+void wlr_latency_histogram_reset(struct wlr_latency_histogram *hist) {
+	memset(hist, 0, sizeof(*hist));
+}
+
+int64_t wlr_latency_histogram_percentile(
+		const struct wlr_latency_histogram *hist, double percentile) {
+	if (hist->count == 0) {
+		return 0;
+	}
+
+	uint64_t rank = percentile / 100 * hist->count;
+	if (rank < 1) {
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (size_t i = 0; i < WLR_LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		seen += hist->buckets[i];
+		if (seen >= rank) {
+			int64_t upper = histogram_bucket_upper_nsec(i);
+			return upper < hist->max_nsec ? upper : hist->max_nsec;
+		}
+	}
+	return hist->max_nsec;
+}
+
+// Set by backends while they handle an input event
+static struct {
+	bool set;
+	int64_t nsec;
+} event_arrival;
+
+void input_latency_begin_event(const struct timespec *arrival) {
+	event_arrival.set = true;
+	event_arrival.nsec = timespec_to_nsec(arrival);
+}
+
+void input_latency_end_event(void) {
+	event_arrival.set = false;
+}
+
+bool input_latency_get_event_arrival(struct timespec *arrival) {
+	if (!event_arrival.set) {
+		return false;
+	}
+	timespec_from_nsec(arrival, event_arrival.nsec);
+	return true;
+}
+
+/**
+ * Returns the time at which an event was received, in nanoseconds. This is
+ * the arrival time stamped by the backend if any, or the event timestamp
+ * otherwise, which only has a millisecond resolution. Returns -1 if the
+ * timestamp doesn't look like it comes from CLOCK_MONOTONIC.
+ */
+static int64_t event_start(uint32_t time_msec, int64_t now_nsec) {
+	if (event_arrival.set) {
+		return event_arrival.nsec;
+	}
+
+	// Event timestamps wrap around every 49 days
+	uint32_t elapsed_msec = (uint32_t)(now_nsec / 1000000) - time_msec;
+	if (elapsed_msec > INPUT_LATENCY_MAX_MSEC) {
+		return -1;
+	}
+	return now_nsec - now_nsec % 1000000 - (int64_t)elapsed_msec * 1000000;
+}
+
+static bool latency_record(struct wlr_input_latency *latency,
+		enum wlr_input_latency_stage stage, int64_t start_nsec,
+		int64_t now_nsec) {
+	int64_t nsec = now_nsec - start_nsec;
+	if (start_nsec < 0 || nsec > (int64_t)INPUT_LATENCY_MAX_MSEC * 1000000) {
+		latency->dropped++;
+		return false;
+	}
+	wlr_latency_histogram_add(&latency->stages[stage], nsec);
+	return true;
+}
+
+static int64_t get_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+static void latency_stop_tracking(struct wlr_input_latency *latency) {
+	if (latency->surface != NULL) {
+		wl_list_remove(&latency->surface_commit.link);
+		wl_list_remove(&latency->surface_destroy.link);
+		latency->surface = NULL;
+	}
+	latency->state = WLR_INPUT_LATENCY_IDLE;
+}
+
+static void latency_handle_surface_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency *latency =
+		wl_container_of(listener, latency, surface_commit);
+	bool recorded = latency_record(latency, WLR_INPUT_LATENCY_COMMIT,
+		latency->event_start_nsec, get_time_nsec());
+
+	latency_stop_tracking(latency);
+	if (recorded) {
+		latency->state = WLR_INPUT_LATENCY_WAIT_FRAME;
+	}
+}
+
+static void latency_handle_surface_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency *latency =
+		wl_container_of(listener, latency, surface_destroy);
+	latency_stop_tracking(latency);
+}
+
+void input_latency_handle_event(struct wlr_input_latency *latency,
+		uint32_t time_msec, struct wlr_surface *surface, bool wait_response) {
+	if (surface == NULL) {
+		// Nobody received the event
+		return;
+	}
+
+	int64_t now_nsec = get_time_nsec();
+	int64_t start_nsec = event_start(time_msec, now_nsec);
+	if (!latency_record(latency, WLR_INPUT_LATENCY_DISPATCH, start_nsec,
+			now_nsec)) {
+		return;
+	}
+
+	if (!wait_response) {
+		return;
+	}
+	if (latency->state != WLR_INPUT_LATENCY_IDLE) {
+		if (now_nsec - latency->event_start_nsec <=
+				(int64_t)INPUT_LATENCY_MAX_MSEC * 1000000) {
+			// Still waiting for the response to a previous event
+			return;
+		}
+		// The previous event never got a response
+		latency->dropped++;
+	}
+
+	latency_stop_tracking(latency);
+	latency->state = WLR_INPUT_LATENCY_WAIT_COMMIT;
+	latency->event_start_nsec = start_nsec;
+	latency->surface = surface;
+	wl_signal_add(&surface->events.commit, &latency->surface_commit);
+	wl_signal_add(&surface->events.destroy, &latency->surface_destroy);
+}
+
+static void output_handle_swap_buffers(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency_output *l_output =
+		wl_container_of(listener, l_output, swap_buffers);
+	struct wlr_input_latency *latency = l_output->latency;
+	if (latency->state != WLR_INPUT_LATENCY_WAIT_FRAME) {
+		return;
+	}
+
+	latency_record(latency, WLR_INPUT_LATENCY_FRAME,
+		latency->event_start_nsec, get_time_nsec());
+	latency->state = WLR_INPUT_LATENCY_IDLE;
+}
+
+static void latency_output_destroy(struct wlr_input_latency_output *l_output) {
+	wl_list_remove(&l_output->swap_buffers.link);
+	wl_list_remove(&l_output->layout_output_destroy.link);
+	wl_list_remove(&l_output->link);
+	free(l_output);
+}
+
+static void output_handle_layout_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency_output *l_output =
+		wl_container_of(listener, l_output, layout_output_destroy);
+	latency_output_destroy(l_output);
+}
+
+static void latency_add_output(struct wlr_input_latency *latency,
+		struct wlr_output_layout_output *layout_output) {
+	struct wlr_input_latency_output *l_output =
+		calloc(1, sizeof(struct wlr_input_latency_output));
+	if (l_output == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return;
+	}
+	l_output->latency = latency;
+	l_output->output = layout_output->output;
+
+	l_output->swap_buffers.notify = output_handle_swap_buffers;
+	wl_signal_add(&layout_output->output->events.swap_buffers,
+		&l_output->swap_buffers);
+	l_output->layout_output_destroy.notify =
+		output_handle_layout_output_destroy;
+	wl_signal_add(&layout_output->events.destroy,
+		&l_output->layout_output_destroy);
+
+	wl_list_insert(&latency->outputs, &l_output->link);
+}
+
+static void latency_handle_layout_add(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency *latency =
+		wl_container_of(listener, latency, layout_add);
+	struct wlr_output_layout_output *layout_output = data;
+	latency_add_output(latency, layout_output);
+}
+
+static void latency_handle_layout_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency *latency =
+		wl_container_of(listener, latency, layout_destroy);
+	wlr_input_latency_destroy(latency);
+}
+
+static void latency_handle_seat_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency *latency =
+		wl_container_of(listener, latency, seat_destroy);
+	wlr_input_latency_destroy(latency);
+}
+
+struct wlr_input_latency *wlr_input_latency_create(struct wlr_seat *seat,
+		struct wlr_output_layout *layout) {
+	if (seat->input_latency != NULL) {
+		wlr_log(L_ERROR, "Seat %s already has an input latency tracker",
+			seat->name);
+		return NULL;
+	}
+
+	struct wlr_input_latency *latency =
+		calloc(1, sizeof(struct wlr_input_latency));
+	if (latency == NULL) {
+		return NULL;
+	}
+	latency->seat = seat;
+	latency->layout = layout;
+	wl_list_init(&latency->outputs);
+	wl_signal_init(&latency->events.destroy);
+
+	latency->surface_commit.notify = latency_handle_surface_commit;
+	latency->surface_destroy.notify = latency_handle_surface_destroy;
+
+	latency->layout_add.notify = latency_handle_layout_add;
+	wl_signal_add(&layout->events.add, &latency->layout_add);
+	latency->layout_destroy.notify = latency_handle_layout_destroy;
+	wl_signal_add(&layout->events.destroy, &latency->layout_destroy);
+	latency->seat_destroy.notify = latency_handle_seat_destroy;
+	wl_signal_add(&seat->events.destroy, &latency->seat_destroy);
+
+	struct wlr_output_layout_output *layout_output;
+	wl_list_for_each(layout_output, &layout->outputs, link) {
+		latency_add_output(latency, layout_output);
+	}
+
+	seat->input_latency = latency;
+	return latency;
+}
+
+void wlr_input_latency_destroy(struct wlr_input_latency *latency) {
+	if (latency == NULL) {
+		return;
+	}
+
+	wlr_signal_emit_safe(&latency->events.destroy, latency);
+
+	latency_stop_tracking(latency);
+	wlr_input_latency_set_log_interval(latency, 0);
+
+	struct wlr_input_latency_output *l_output, *tmp;
+	wl_list_for_each_safe(l_output, tmp, &latency->outputs, link) {
+		latency_output_destroy(l_output);
+	}
+	wl_list_remove(&latency->layout_add.link);
+	wl_list_remove(&latency->layout_destroy.link);
+	wl_list_remove(&latency->seat_destroy.link);
+
+	latency->seat->input_latency = NULL;
+	free(latency);
+}
+
+void wlr_input_latency_reset(struct wlr_input_latency *latency) {
+	for (size_t i = 0; i < WLR_INPUT_LATENCY_STAGE_COUNT; ++i) {
+		wlr_latency_histogram_reset(&latency->stages[i]);
+	}
+	latency->dropped = 0;
+}
+
+void wlr_input_latency_log(struct wlr_input_latency *latency) {
+	for (size_t i = 0; i < WLR_INPUT_LATENCY_STAGE_COUNT; ++i) {
+		const struct wlr_latency_histogram *hist = &latency->stages[i];
+		if (hist->count == 0) {
+			continue;
+		}
+		wlr_log(L_INFO, "Input latency on seat %s, %s: p50 %.2f ms, "
+			"p90 %.2f ms, p99 %.2f ms, max %.2f ms (%llu samples)",
+			latency->seat->name, stage_names[i],
+			wlr_latency_histogram_percentile(hist, 50) / 1e6,
+			wlr_latency_histogram_percentile(hist, 90) / 1e6,
+			wlr_latency_histogram_percentile(hist, 99) / 1e6,
+			hist->max_nsec / 1e6, (unsigned long long)hist->count);
+	}
+	if (latency->dropped > 0) {
+		wlr_log(L_INFO, "Input latency on seat %s: %llu samples dropped",
+			latency->seat->name, (unsigned long long)latency->dropped);
+	}
+}
+
+static int latency_handle_log_timer(void *data) {
+	struct wlr_input_latency *latency = data;
+	wlr_input_latency_log(latency);
+	wl_event_source_timer_update(latency->log_timer, latency->log_interval_ms);
+	return 0;
+}
+
+void wlr_input_latency_set_log_interval(struct wlr_input_latency *latency,
+		uint32_t interval_ms) {
+	latency->log_interval_ms = interval_ms;
+	if (interval_ms == 0) {
+		if (latency->log_timer != NULL) {
+			wl_event_source_remove(latency->log_timer);
+			latency->log_timer = NULL;
+		}
+		return;
+	}
+
+	if (latency->log_timer == NULL) {
+		struct wl_event_loop *loop =
+			wl_display_get_event_loop(latency->seat->display);
+		latency->log_timer = wl_event_loop_add_timer(loop,
+			latency_handle_log_timer, latency);
+		if (latency->log_timer == NULL) {
+			wlr_log(L_ERROR, "Failed to create input latency log timer");
+			return;
+		}
+	}
+	wl_event_source_timer_update(latency->log_timer, interval_ms);
+}
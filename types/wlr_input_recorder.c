@@ -0,0 +1,380 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wlr/types/wlr_input_device.h>
+#include <wlr/types/wlr_input_recorder.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_tablet_tool.h>
+#include <wlr/types/wlr_touch.h>
+#include <wlr/util/log.h>
+#include "types/wlr_input_recorder.h"
+#include "util/time.h"
+
+struct wlr_input_recorder_device {
+	struct wlr_input_recorder *recorder;
+	struct wlr_input_device *device;
+	uint16_t id;
+	struct wl_list link; // wlr_input_recorder::devices
+
+	struct wl_listener destroy;
+	// Only the listeners matching the device type are used
+	struct wl_listener events[4];
+};
+
+static void recorder_write(struct wlr_input_recorder *recorder,
+		enum input_record_type type, uint16_t device, const void *payload,
+		size_t payload_size) {
+	if (recorder->file == NULL) {
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t now_nsec = timespec_to_nsec(&now);
+	int64_t delta_usec = (now_nsec - recorder->last_record_nsec) / 1000;
+	if (recorder->last_record_nsec == 0 || delta_usec < 0) {
+		delta_usec = 0;
+	} else if (delta_usec > UINT32_MAX) {
+		delta_usec = UINT32_MAX;
+	}
+	recorder->last_record_nsec = now_nsec;
+
+	struct input_record_header header = {
+		.type = type,
+		.device = device,
+		.delta_usec = delta_usec,
+	};
+	if (fwrite(&header, sizeof(header), 1, recorder->file) != 1 ||
+			(payload_size > 0 &&
+			fwrite(payload, payload_size, 1, recorder->file) != 1)) {
+		wlr_log_errno(L_ERROR, "Failed to write input recording, stopping");
+		fclose(recorder->file);
+		recorder->file = NULL;
+	}
+}
+
+static void device_write(struct wlr_input_recorder_device *dev,
+		enum input_record_type type, const void *payload) {
+	recorder_write(dev->recorder, type, dev->id, payload,
+		input_record_payload_size(type));
+}
+
+static void handle_pointer_motion(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[0]);
+	struct wlr_event_pointer_motion *event = data;
+	struct input_record_pointer_motion record = {
+		.delta_x = event->delta_x,
+		.delta_y = event->delta_y,
+	};
+	device_write(dev, INPUT_RECORD_POINTER_MOTION, &record);
+}
+
+static void handle_pointer_motion_absolute(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[1]);
+	struct wlr_event_pointer_motion_absolute *event = data;
+	struct input_record_pointer_motion_absolute record = {
+		.x = event->x,
+		.y = event->y,
+	};
+	device_write(dev, INPUT_RECORD_POINTER_MOTION_ABSOLUTE, &record);
+}
+
+static void handle_pointer_button(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[2]);
+	struct wlr_event_pointer_button *event = data;
+	struct input_record_button record = {
+		.button = event->button,
+		.state = event->state,
+	};
+	device_write(dev, INPUT_RECORD_POINTER_BUTTON, &record);
+}
+
+static void handle_pointer_axis(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[3]);
+	struct wlr_event_pointer_axis *event = data;
+	struct input_record_pointer_axis record = {
+		.delta = event->delta,
+		.delta_discrete = event->delta_discrete,
+		.source = event->source,
+		.orientation = event->orientation,
+	};
+	device_write(dev, INPUT_RECORD_POINTER_AXIS, &record);
+}
+
+static void handle_keyboard_key(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[0]);
+	struct wlr_event_keyboard_key *event = data;
+	struct input_record_keyboard_key record = {
+		.keycode = event->keycode,
+		.state = event->state,
+		.update_state = event->update_state,
+	};
+	device_write(dev, INPUT_RECORD_KEYBOARD_KEY, &record);
+}
+
+static void handle_touch_down(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[0]);
+	struct wlr_event_touch_down *event = data;
+	struct input_record_touch record = {
+		.x = event->x,
+		.y = event->y,
+		.touch_id = event->touch_id,
+	};
+	device_write(dev, INPUT_RECORD_TOUCH_DOWN, &record);
+}
+
+static void handle_touch_up(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[1]);
+	struct wlr_event_touch_up *event = data;
+	struct input_record_touch record = { .touch_id = event->touch_id };
+	device_write(dev, INPUT_RECORD_TOUCH_UP, &record);
+}
+
+static void handle_touch_motion(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[2]);
+	struct wlr_event_touch_motion *event = data;
+	struct input_record_touch record = {
+		.x = event->x,
+		.y = event->y,
+		.touch_id = event->touch_id,
+	};
+	device_write(dev, INPUT_RECORD_TOUCH_MOTION, &record);
+}
+
+static void handle_touch_cancel(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[3]);
+	struct wlr_event_touch_cancel *event = data;
+	struct input_record_touch record = { .touch_id = event->touch_id };
+	device_write(dev, INPUT_RECORD_TOUCH_CANCEL, &record);
+}
+
+static void handle_tablet_tool_axis(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[0]);
+	struct wlr_event_tablet_tool_axis *event = data;
+	struct input_record_tablet_tool_axis record = {
+		.x = event->x,
+		.y = event->y,
+		.pressure = event->pressure,
+		.distance = event->distance,
+		.tilt_x = event->tilt_x,
+		.tilt_y = event->tilt_y,
+		.rotation = event->rotation,
+		.slider = event->slider,
+		.wheel_delta = event->wheel_delta,
+		.updated_axes = event->updated_axes,
+	};
+	device_write(dev, INPUT_RECORD_TABLET_TOOL_AXIS, &record);
+}
+
+static void handle_tablet_tool_proximity(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[1]);
+	struct wlr_event_tablet_tool_proximity *event = data;
+	struct input_record_tablet_tool_state record = {
+		.x = event->x,
+		.y = event->y,
+		.state = event->state,
+	};
+	device_write(dev, INPUT_RECORD_TABLET_TOOL_PROXIMITY, &record);
+}
+
+static void handle_tablet_tool_tip(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[2]);
+	struct wlr_event_tablet_tool_tip *event = data;
+	struct input_record_tablet_tool_state record = {
+		.x = event->x,
+		.y = event->y,
+		.state = event->state,
+	};
+	device_write(dev, INPUT_RECORD_TABLET_TOOL_TIP, &record);
+}
+
+static void handle_tablet_tool_button(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, events[3]);
+	struct wlr_event_tablet_tool_button *event = data;
+	struct input_record_button record = {
+		.button = event->button,
+		.state = event->state,
+	};
+	device_write(dev, INPUT_RECORD_TABLET_TOOL_BUTTON, &record);
+}
+
+static void recorder_device_destroy(struct wlr_input_recorder_device *dev) {
+	wl_list_remove(&dev->link);
+	wl_list_remove(&dev->destroy.link);
+	for (size_t i = 0; i < sizeof(dev->events) / sizeof(dev->events[0]); ++i) {
+		wl_list_remove(&dev->events[i].link);
+	}
+	free(dev);
+}
+
+static void handle_device_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *dev =
+		wl_container_of(listener, dev, destroy);
+	recorder_write(dev->recorder, INPUT_RECORD_DEVICE_REMOVED, dev->id,
+		NULL, 0);
+	recorder_device_destroy(dev);
+}
+
+static void handle_new_input(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder *recorder =
+		wl_container_of(listener, recorder, new_input);
+	struct wlr_input_device *device = data;
+
+	struct wl_signal *signals[4] = { NULL };
+	wl_notify_func_t handlers[4] = { NULL };
+	switch (device->type) {
+	case WLR_INPUT_DEVICE_POINTER:
+		signals[0] = &device->pointer->events.motion;
+		handlers[0] = handle_pointer_motion;
+		signals[1] = &device->pointer->events.motion_absolute;
+		handlers[1] = handle_pointer_motion_absolute;
+		signals[2] = &device->pointer->events.button;
+		handlers[2] = handle_pointer_button;
+		signals[3] = &device->pointer->events.axis;
+		handlers[3] = handle_pointer_axis;
+		break;
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		signals[0] = &device->keyboard->events.key;
+		handlers[0] = handle_keyboard_key;
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:
+		signals[0] = &device->touch->events.down;
+		handlers[0] = handle_touch_down;
+		signals[1] = &device->touch->events.up;
+		handlers[1] = handle_touch_up;
+		signals[2] = &device->touch->events.motion;
+		handlers[2] = handle_touch_motion;
+		signals[3] = &device->touch->events.cancel;
+		handlers[3] = handle_touch_cancel;
+		break;
+	case WLR_INPUT_DEVICE_TABLET_TOOL:
+		signals[0] = &device->tablet_tool->events.axis;
+		handlers[0] = handle_tablet_tool_axis;
+		signals[1] = &device->tablet_tool->events.proximity;
+		handlers[1] = handle_tablet_tool_proximity;
+		signals[2] = &device->tablet_tool->events.tip;
+		handlers[2] = handle_tablet_tool_tip;
+		signals[3] = &device->tablet_tool->events.button;
+		handlers[3] = handle_tablet_tool_button;
+		break;
+	case WLR_INPUT_DEVICE_TABLET_PAD:
+		wlr_log(L_DEBUG, "Not recording tablet pad '%s'", device->name);
+		return;
+	}
+
+	struct wlr_input_recorder_device *dev =
+		calloc(1, sizeof(struct wlr_input_recorder_device));
+	if (dev == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return;
+	}
+	dev->recorder = recorder;
+	dev->device = device;
+	dev->id = recorder->next_device_id++;
+	wl_list_insert(&recorder->devices, &dev->link);
+
+	dev->destroy.notify = handle_device_destroy;
+	wl_signal_add(&device->events.destroy, &dev->destroy);
+	for (size_t i = 0; i < sizeof(dev->events) / sizeof(dev->events[0]); ++i) {
+		if (signals[i] != NULL) {
+			dev->events[i].notify = handlers[i];
+			wl_signal_add(signals[i], &dev->events[i]);
+		} else {
+			wl_list_init(&dev->events[i].link);
+		}
+	}
+
+	const char *name = device->name != NULL ? device->name : "";
+	struct input_record_device_added record = {
+		.type = device->type,
+		.name_len = strlen(name),
+	};
+	recorder_write(recorder, INPUT_RECORD_DEVICE_ADDED, dev->id, &record,
+		sizeof(record));
+	if (recorder->file != NULL &&
+			fwrite(name, 1, record.name_len, recorder->file) != record.name_len) {
+		wlr_log_errno(L_ERROR, "Failed to write input recording, stopping");
+		fclose(recorder->file);
+		recorder->file = NULL;
+	}
+}
+
+static void handle_backend_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder *recorder =
+		wl_container_of(listener, recorder, backend_destroy);
+	wlr_input_recorder_destroy(recorder);
+}
+
+struct wlr_input_recorder *wlr_input_recorder_create(
+		struct wlr_backend *backend, const char *path) {
+	struct wlr_input_recorder *recorder =
+		calloc(1, sizeof(struct wlr_input_recorder));
+	if (recorder == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	recorder->file = fopen(path, "wb");
+	if (recorder->file == NULL) {
+		wlr_log_errno(L_ERROR, "Failed to open input recording '%s'", path);
+		free(recorder);
+		return NULL;
+	}
+
+	uint32_t version = INPUT_RECORDING_VERSION;
+	if (fwrite(INPUT_RECORDING_MAGIC, strlen(INPUT_RECORDING_MAGIC), 1,
+				recorder->file) != 1 ||
+			fwrite(&version, sizeof(version), 1, recorder->file) != 1) {
+		wlr_log_errno(L_ERROR, "Failed to write input recording '%s'", path);
+		fclose(recorder->file);
+		free(recorder);
+		return NULL;
+	}
+
+	recorder->backend = backend;
+	wl_list_init(&recorder->devices);
+
+	recorder->new_input.notify = handle_new_input;
+	wl_signal_add(&backend->events.new_input, &recorder->new_input);
+	recorder->backend_destroy.notify = handle_backend_destroy;
+	wl_signal_add(&backend->events.destroy, &recorder->backend_destroy);
+
+	wlr_log(L_INFO, "Recording input to '%s'", path);
+	return recorder;
+}
+
+void wlr_input_recorder_destroy(struct wlr_input_recorder *recorder) {
+	if (recorder == NULL) {
+		return;
+	}
+
+	struct wlr_input_recorder_device *dev, *tmp;
+	wl_list_for_each_safe(dev, tmp, &recorder->devices, link) {
+		recorder_device_destroy(dev);
+	}
+
+	wl_list_remove(&recorder->new_input.link);
+	wl_list_remove(&recorder->backend_destroy.link);
+	if (recorder->file != NULL && fclose(recorder->file) != 0) {
+		wlr_log_errno(L_ERROR, "Failed to close input recording");
+	}
+	free(recorder);
+}
@@ -7,9 +7,75 @@
 #include <wlr/interfaces/wlr_keyboard.h>
 #include <wlr/types/wlr_keyboard.h>
 #include <wlr/util/log.h>
+#include "types/wlr_keyboard.h"
+#include "util/hash_table.h"
+#include "util/os-compatibility.h"
 #include "util/signal.h"
 
-int os_create_anonymous_file(off_t size);
+static struct hash_table keymap_files; // wlr_keymap_file by content hash
+static uint64_t next_keymap_file_id = 1;
+
+struct wlr_keymap_file *keymap_file_get(const char *str, size_t size) {
+	uint64_t hash = hash_bytes(HASH_BYTES_INIT, str, size);
+	struct wlr_keymap_file *file = hash_table_get(&keymap_files, hash);
+	if (file != NULL && file->size == size &&
+			memcmp(file->data, str, size) == 0) {
+		file->refcount++;
+		return file;
+	}
+
+	file = calloc(1, sizeof(struct wlr_keymap_file));
+	if (file == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return NULL;
+	}
+	file->fd = os_create_sealed_file(str, size);
+	if (file->fd < 0) {
+		wlr_log_errno(L_ERROR, "creating a keymap file for %zu bytes failed",
+			size);
+		free(file);
+		return NULL;
+	}
+	void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, file->fd, 0);
+	if (data == MAP_FAILED) {
+		wlr_log_errno(L_ERROR, "failed to mmap() %zu bytes", size);
+		close(file->fd);
+		free(file);
+		return NULL;
+	}
+	file->data = data;
+	file->size = size;
+	file->hash = hash;
+	file->id = next_keymap_file_id++;
+	file->refcount = 1;
+
+	// On a hash collision, the new file is simply not shared
+	if (hash_table_get(&keymap_files, hash) == NULL) {
+		hash_table_set(&keymap_files, hash, file);
+	}
+	return file;
+}
+
+struct wlr_keymap_file *keymap_file_ref(struct wlr_keymap_file *file) {
+	file->refcount++;
+	return file;
+}
+
+void keymap_file_unref(struct wlr_keymap_file *file) {
+	if (file == NULL || --file->refcount > 0) {
+		return;
+	}
+
+	if (hash_table_get(&keymap_files, file->hash) == file) {
+		hash_table_remove(&keymap_files, file->hash);
+		if (keymap_files.len == 0) {
+			hash_table_finish(&keymap_files);
+		}
+	}
+	munmap((void *)file->data, file->size);
+	close(file->fd);
+	free(file);
+}
 
 static void keyboard_led_update(struct wlr_keyboard *keyboard) {
 	if (keyboard->xkb_state == NULL) {
@@ -157,9 +223,7 @@ void wlr_keyboard_destroy(struct wlr_keyboard *kb) {
 	}
 	xkb_state_unref(kb->xkb_state);
 	xkb_keymap_unref(kb->keymap);
-	if (kb->keymap_fd >= 0) {
-		close(kb->keymap_fd);
-	}
+	keymap_file_unref(kb->keymap_file);
 	if (kb->impl && kb->impl->destroy) {
 		kb->impl->destroy(kb);
 	} else {
@@ -212,26 +276,29 @@ void wlr_keyboard_set_keymap(struct wlr_keyboard *kb,
 		kb->mod_indexes[i] = xkb_map_mod_get_index(kb->keymap, mod_names[i]);
 	}
 
-	keymap_str = xkb_keymap_get_as_string(kb->keymap,
-		XKB_KEYMAP_FORMAT_TEXT_V1);
-	kb->keymap_size = strlen(keymap_str) + 1;
-	if (kb->keymap_fd >= 0) {
-		close(kb->keymap_fd);
-	}
-	kb->keymap_fd = os_create_anonymous_file(kb->keymap_size);
-	if (kb->keymap_fd < 0) {
-		wlr_log(L_ERROR, "creating a keymap file for %zu bytes failed", kb->keymap_size);
-		goto err;
+	// Serializing is about as slow as compiling, skip it for cached keymaps
+	struct wlr_keymap_file *keymap_file = keymap_cache_get_file(kb->keymap);
+	if (keymap_file == NULL) {
+		keymap_str = xkb_keymap_get_as_string(kb->keymap,
+			XKB_KEYMAP_FORMAT_TEXT_V1);
+		if (keymap_str == NULL) {
+			wlr_log(L_ERROR, "Failed to serialize keymap");
+			goto err;
+		}
+		keymap_file = keymap_file_get(keymap_str, strlen(keymap_str) + 1);
+		free(keymap_str);
+		keymap_str = NULL;
+		if (keymap_file != NULL) {
+			keymap_cache_set_file(kb->keymap, keymap_file);
+		}
 	}
-	void *ptr = mmap(NULL, kb->keymap_size,
-		PROT_READ | PROT_WRITE, MAP_SHARED, kb->keymap_fd, 0);
-	if (ptr == (void*)-1) {
-		wlr_log(L_ERROR, "failed to mmap() %zu bytes", kb->keymap_size);
+	keymap_file_unref(kb->keymap_file);
+	kb->keymap_file = keymap_file;
+	if (kb->keymap_file == NULL) {
 		goto err;
 	}
-	strcpy(ptr, keymap_str);
-	free(keymap_str);
-	munmap(ptr, kb->keymap_size);
+	kb->keymap_fd = kb->keymap_file->fd;
+	kb->keymap_size = kb->keymap_file->size;
 
 	for (size_t i = 0; i < kb->num_keycodes; ++i) {
 		xkb_keycode_t keycode = kb->keycodes[i] + 8;
@@ -248,10 +315,10 @@ err:
 	kb->xkb_state = NULL;
 	xkb_keymap_unref(keymap);
 	kb->keymap = NULL;
-	if (kb->keymap_fd >= 0) {
-		close(kb->keymap_fd);
-		kb->keymap_fd = -1;
-	}
+	keymap_file_unref(kb->keymap_file);
+	kb->keymap_file = NULL;
+	kb->keymap_fd = -1;
+	kb->keymap_size = 0;
 	free(keymap_str);
 }
 
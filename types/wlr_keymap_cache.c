@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_keymap_cache.h>
+#include <wlr/util/log.h>
+#include "types/wlr_keyboard.h"
+#include "util/hash_table.h"
+
+#define KEYMAP_CACHE_DEFAULT_CAPACITY 16
+
+struct keymap_cache_entry {
+	uint64_t hash;
+	char *text;
+	size_t size;
+	struct xkb_keymap *keymap;
+	struct wlr_keymap_file *file; // NULL until a keyboard serialized it
+	struct wl_list link; // keymap_cache::entries
+};
+
+static struct {
+	struct xkb_context *context;
+	struct wl_list entries; // most recently used first
+	size_t len, capacity;
+	struct wlr_keymap_cache_stats stats;
+} cache = {
+	.capacity = KEYMAP_CACHE_DEFAULT_CAPACITY,
+};
+
+static void entry_destroy(struct keymap_cache_entry *entry) {
+	wl_list_remove(&entry->link);
+	cache.len--;
+	xkb_keymap_unref(entry->keymap);
+	keymap_file_unref(entry->file);
+	free(entry->text);
+	free(entry);
+}
+
+static void cache_trim(void) {
+	while (cache.len > cache.capacity) {
+		struct keymap_cache_entry *lru =
+			wl_container_of(cache.entries.prev, lru, link);
+		entry_destroy(lru);
+		cache.stats.evictions++;
+	}
+	if (cache.len == 0 && cache.context != NULL) {
+		xkb_context_unref(cache.context);
+		cache.context = NULL;
+	}
+}
+
+static void cache_init(void) {
+	// The list can't be initialized statically
+	if (cache.entries.next == NULL) {
+		wl_list_init(&cache.entries);
+	}
+}
+
+static struct keymap_cache_entry *find_keymap(struct xkb_keymap *keymap) {
+	cache_init();
+	struct keymap_cache_entry *entry;
+	wl_list_for_each(entry, &cache.entries, link) {
+		if (entry->keymap == keymap) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+struct xkb_keymap *keymap_cache_new_from_buffer(const char *buf,
+		size_t size) {
+	cache_init();
+	// Clients usually include the NUL terminator in the size
+	size = strnlen(buf, size);
+	uint64_t hash = hash_bytes(HASH_BYTES_INIT, buf, size);
+
+	struct keymap_cache_entry *entry;
+	wl_list_for_each(entry, &cache.entries, link) {
+		if (entry->hash == hash && entry->size == size &&
+				memcmp(entry->text, buf, size) == 0) {
+			wl_list_remove(&entry->link);
+			wl_list_insert(&cache.entries, &entry->link);
+			cache.stats.hits++;
+			return xkb_keymap_ref(entry->keymap);
+		}
+	}
+	cache.stats.misses++;
+
+	if (cache.context == NULL) {
+		cache.context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+		if (cache.context == NULL) {
+			wlr_log(L_ERROR, "Failed to create XKB context");
+			return NULL;
+		}
+	}
+	struct xkb_keymap *keymap = xkb_keymap_new_from_buffer(cache.context,
+		buf, size, XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	if (keymap == NULL || cache.capacity == 0) {
+		cache_trim();
+		return keymap;
+	}
+
+	entry = calloc(1, sizeof(struct keymap_cache_entry));
+	if (entry == NULL) {
+		return keymap;
+	}
+	entry->text = malloc(size);
+	if (entry->text == NULL) {
+		free(entry);
+		return keymap;
+	}
+	memcpy(entry->text, buf, size);
+	entry->size = size;
+	entry->hash = hash;
+	entry->keymap = xkb_keymap_ref(keymap);
+	wl_list_insert(&cache.entries, &entry->link);
+	cache.len++;
+	cache_trim();
+	return keymap;
+}
+
+struct wlr_keymap_file *keymap_cache_get_file(struct xkb_keymap *keymap) {
+	struct keymap_cache_entry *entry = find_keymap(keymap);
+	if (entry == NULL || entry->file == NULL) {
+		return NULL;
+	}
+	return keymap_file_ref(entry->file);
+}
+
+void keymap_cache_set_file(struct xkb_keymap *keymap,
+		struct wlr_keymap_file *file) {
+	struct keymap_cache_entry *entry = find_keymap(keymap);
+	if (entry == NULL || entry->file != NULL) {
+		return;
+	}
+	entry->file = keymap_file_ref(file);
+}
+
+void wlr_keymap_cache_get_stats(struct wlr_keymap_cache_stats *stats) {
+	*stats = cache.stats;
+	stats->entries = cache.len;
+	stats->capacity = cache.capacity;
+}
+
+void wlr_keymap_cache_set_capacity(size_t capacity) {
+	cache_init();
+	cache.capacity = capacity;
+	cache_trim();
+}
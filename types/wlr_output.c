@@ -8,6 +8,7 @@
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_surface.h>
@@ -136,6 +137,16 @@ static void output_update_matrix(struct wlr_output *output) {
 		output->height, output->transform);
 }
 
+/**
+ * Forgets which buffers the scene behind software cursors is known for, eg.
+ * because they need to be repainted as a whole.
+ */
+static void output_invalidate_cursor_backgrounds(struct wlr_output *output) {
+	for (size_t i = 0; i < WLR_OUTPUT_CURSOR_BACKGROUNDS_LEN; ++i) {
+		output->cursor_backgrounds_valid[i] = false;
+	}
+}
+
 void wlr_output_enable(struct wlr_output *output, bool enable) {
 	if (output->enabled == enable) {
 		return;
@@ -179,6 +190,7 @@ void wlr_output_update_custom_mode(struct wlr_output *output, int32_t width,
 	output->width = width;
 	output->height = height;
 	output_update_matrix(output);
+	output_invalidate_cursor_backgrounds(output);
 
 	output->refresh = refresh;
 
@@ -194,6 +206,7 @@ void wlr_output_set_transform(struct wlr_output *output,
 		enum wl_output_transform transform) {
 	output->impl->transform(output, transform);
 	output_update_matrix(output);
+	output_invalidate_cursor_backgrounds(output);
 
 	// TODO: only send geometry and done
 	struct wl_resource *resource;
@@ -322,9 +335,24 @@ void wlr_output_effective_resolution(struct wlr_output *output,
 }
 
 bool wlr_output_make_current(struct wlr_output *output, int *buffer_age) {
+	output->cursors_restored = false;
 	return output->impl->make_current(output, buffer_age);
 }
 
+/**
+ * Converts a box in output-local coordinates to renderer coordinates, ie.
+ * upside down.
+ */
+static void output_box_to_renderer(struct wlr_output *output,
+		const struct wlr_box *box, struct wlr_box *dest) {
+	int ow, oh;
+	wlr_output_transformed_resolution(output, &ow, &oh);
+
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(output->transform);
+	wlr_box_transform(box, transform, ow, oh, dest);
+}
+
 static void output_scissor(struct wlr_output *output, pixman_box32_t *rect) {
 	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
 	assert(renderer);
@@ -336,13 +364,8 @@ static void output_scissor(struct wlr_output *output, pixman_box32_t *rect) {
 		.height = rect->y2 - rect->y1,
 	};
 
-	int ow, oh;
-	wlr_output_transformed_resolution(output, &ow, &oh);
-
 	// Scissor is in renderer coordinates, ie. upside down
-	enum wl_output_transform transform =
-		wlr_output_transform_invert(output->transform);
-	wlr_box_transform(&box, transform, ow, oh, &box);
+	output_box_to_renderer(output, &box, &box);
 
 	wlr_renderer_scissor(renderer, &box);
 }
@@ -451,6 +474,161 @@ surface_damage_finish:
 	pixman_region32_fini(&surface_damage);
 }
 
+static bool output_cursor_is_software(struct wlr_output_cursor *cursor) {
+	return cursor->enabled && cursor->visible &&
+		cursor->output->hardware_cursor != cursor;
+}
+
+/**
+ * Saves the scene behind a software cursor for the frame being painted. This
+ * must be done before any cursor is drawn.
+ */
+static bool output_cursor_save_background(struct wlr_output_cursor *cursor) {
+	struct wlr_output *output = cursor->output;
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	assert(renderer);
+
+	struct wlr_output_cursor_background *background =
+		&cursor->backgrounds[output->cursor_backgrounds_idx];
+	output_cursor_get_box(cursor, &background->box);
+
+	// Parts of the box outside of the output are copied too, they're just
+	// never displayed
+	struct wlr_box box;
+	output_box_to_renderer(output, &background->box, &box);
+
+	if (background->texture != NULL) {
+		int width, height;
+		wlr_texture_get_size(background->texture, &width, &height);
+		if (width != box.width || height != box.height) {
+			// Textures can't be destroyed while painting, this is done when
+			// the cursor size changes
+			return false;
+		}
+		if (!wlr_texture_write_framebuffer(renderer, background->texture,
+				&box)) {
+			return false;
+		}
+	} else {
+		background->texture = wlr_texture_from_framebuffer(renderer, &box);
+		if (background->texture == NULL) {
+			return false;
+		}
+	}
+
+	background->saved = true;
+	return true;
+}
+
+static void output_cursor_restore_background(struct wlr_output_cursor *cursor,
+		struct wlr_output_cursor_background *background) {
+	struct wlr_output *output = cursor->output;
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	assert(renderer);
+
+	// The texture is in renderer orientation, undo the output transform
+	float matrix[9];
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(output->transform);
+	wlr_matrix_project_box(matrix, &background->box, transform, 0,
+		output->transform_matrix);
+
+	// Clear first so that the texture replaces the cursor instead of being
+	// blended with it
+	pixman_box32_t rect = {
+		.x1 = background->box.x,
+		.y1 = background->box.y,
+		.x2 = background->box.x + background->box.width,
+		.y2 = background->box.y + background->box.height,
+	};
+	output_scissor(output, &rect);
+	wlr_renderer_clear(renderer, (float[]){0, 0, 0, 0});
+	wlr_render_texture_with_matrix(renderer, background->texture, matrix,
+		1.0f);
+	wlr_renderer_scissor(renderer, NULL);
+}
+
+/**
+ * Saves the scene behind software cursors and draws them. Returns false if the
+ * scene behind some cursor couldn't be saved. With `restored`, the whole buffer
+ * holds the scene, see `wlr_output_restore_cursors`.
+ */
+static bool output_render_cursors(struct wlr_output *output,
+		const struct timespec *when, pixman_region32_t *damage,
+		bool restored) {
+	size_t idx = output->cursor_backgrounds_idx;
+	output->cursor_backgrounds_valid[idx] = false;
+
+	int width, height;
+	wlr_output_transformed_resolution(output, &width, &height);
+	struct wlr_box output_box = { .width = width, .height = height };
+
+	bool saved = true;
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &output->cursors, link) {
+		cursor->backgrounds[idx].saved = false;
+		if (!output_cursor_is_software(cursor)) {
+			continue;
+		}
+
+		// Unless cursors were restored, the buffer only holds the scene where
+		// it has just been repainted, anywhere else it may still hold an old
+		// cursor
+		struct wlr_box box, visible_box;
+		output_cursor_get_box(cursor, &box);
+		wlr_box_intersection(&box, &output_box, &visible_box);
+		pixman_box32_t rect = {
+			.x1 = visible_box.x,
+			.y1 = visible_box.y,
+			.x2 = visible_box.x + visible_box.width,
+			.y2 = visible_box.y + visible_box.height,
+		};
+		if (!restored && pixman_region32_contains_rectangle(damage, &rect) !=
+				PIXMAN_REGION_IN) {
+			saved = false;
+			continue;
+		}
+
+		if (!output_cursor_save_background(cursor)) {
+			saved = false;
+		}
+	}
+
+	wl_list_for_each(cursor, &output->cursors, link) {
+		if (!output_cursor_is_software(cursor)) {
+			continue;
+		}
+		output_cursor_render(cursor, when, damage);
+	}
+
+	return saved;
+}
+
+static bool output_swap_buffers(struct wlr_output *output,
+		pixman_region32_t *damage, pixman_region32_t *render_damage) {
+	int width, height;
+	wlr_output_transformed_resolution(output, &width, &height);
+
+	// Transform damage into renderer coordinates, ie. upside down
+	enum wl_output_transform transform = wlr_output_transform_compose(
+		wlr_output_transform_invert(output->transform),
+		WL_OUTPUT_TRANSFORM_FLIPPED_180);
+	wlr_region_transform(render_damage, render_damage, transform, width,
+		height);
+
+	if (!output->impl->swap_buffers(output, damage ? render_damage : NULL)) {
+		return false;
+	}
+
+	output->frame_pending = true;
+	output->needs_swap = false;
+	pixman_region32_clear(&output->damage);
+
+	output->cursor_backgrounds_idx += 1;
+	output->cursor_backgrounds_idx %= WLR_OUTPUT_CURSOR_BACKGROUNDS_LEN;
+	return true;
+}
+
 bool wlr_output_swap_buffers(struct wlr_output *output, struct timespec *when,
 		pixman_region32_t *damage) {
 	if (output->frame_pending) {
@@ -481,44 +659,164 @@ bool wlr_output_swap_buffers(struct wlr_output *output, struct timespec *when,
 		pixman_region32_intersect(&render_damage, &render_damage, damage);
 	}
 
+	bool restored = output->cursors_restored;
+	output->cursors_restored = false;
+	if (restored) {
+		// The scene is known everywhere, draw the cursors at their new
+		// position
+		struct wlr_output_cursor *cursor;
+		wl_list_for_each(cursor, &output->cursors, link) {
+			if (!output_cursor_is_software(cursor)) {
+				continue;
+			}
+			struct wlr_box box;
+			output_cursor_get_box(cursor, &box);
+			pixman_region32_union_rect(&render_damage, &render_damage,
+				box.x, box.y, box.width, box.height);
+		}
+		pixman_region32_intersect_rect(&render_damage, &render_damage, 0, 0,
+			width, height);
+	}
+
 	struct timespec now;
 	if (when == NULL) {
 		clock_gettime(CLOCK_MONOTONIC, &now);
 		when = &now;
 	}
 
+	bool cursors_saved = false;
 	if (pixman_region32_not_empty(&render_damage)) {
 		if (output->fullscreen_surface != NULL) {
 			output_fullscreen_surface_render(output, output->fullscreen_surface,
 				when, &render_damage);
 		}
 
-		struct wlr_output_cursor *cursor;
-		wl_list_for_each(cursor, &output->cursors, link) {
-			if (!cursor->enabled || !cursor->visible ||
-					output->hardware_cursor == cursor) {
-				continue;
-			}
-			output_cursor_render(cursor, when, &render_damage);
+		cursors_saved = output_render_cursors(output, when, &render_damage,
+			restored);
+	}
+
+	size_t idx = output->cursor_backgrounds_idx;
+	bool ok = output_swap_buffers(output, damage, &render_damage);
+	pixman_region32_fini(&render_damage);
+	if (!ok) {
+		return false;
+	}
+
+	// What was saved for other buffers is kept: restoring it gives back the
+	// scene as it was when they were painted, and the compositor repaints
+	// what changed since
+	output->cursor_backgrounds_valid[idx] = cursors_saved;
+	return true;
+}
+
+bool wlr_output_restore_cursors(struct wlr_output *output, int buffer_age,
+		pixman_region32_t *damage) {
+	if (buffer_age <= 0 || buffer_age >= WLR_OUTPUT_CURSOR_BACKGROUNDS_LEN) {
+		return false;
+	}
+	if (output->fullscreen_surface != NULL) {
+		// Its damage can't be told apart from cursor damage
+		return false;
+	}
+
+	size_t idx = output->cursor_backgrounds_idx;
+	size_t prev_idx = (idx + WLR_OUTPUT_CURSOR_BACKGROUNDS_LEN - buffer_age) %
+		WLR_OUTPUT_CURSOR_BACKGROUNDS_LEN;
+	if (!output->cursor_backgrounds_valid[prev_idx]) {
+		return false;
+	}
+
+	bool saved = false;
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &output->cursors, link) {
+		saved |= cursor->backgrounds[prev_idx].saved;
+	}
+	if (!saved) {
+		// No software cursor was drawn in this buffer
+		return false;
+	}
+
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	assert(renderer);
+
+	wlr_renderer_begin(renderer, output->width, output->height);
+
+	// Put the buffer back in the state it was in before cursors were drawn
+	wl_list_for_each(cursor, &output->cursors, link) {
+		struct wlr_output_cursor_background *background =
+			&cursor->backgrounds[prev_idx];
+		if (!background->saved) {
+			continue;
 		}
+		output_cursor_restore_background(cursor, background);
+		pixman_region32_union_rect(damage, damage,
+			background->box.x, background->box.y,
+			background->box.width, background->box.height);
 	}
 
-	// Transform damage into renderer coordinates, ie. upside down
-	enum wl_output_transform transform = wlr_output_transform_compose(
-		wlr_output_transform_invert(output->transform),
-		WL_OUTPUT_TRANSFORM_FLIPPED_180);
-	wlr_region_transform(&render_damage, &render_damage, transform, width,
-		height);
+	wlr_renderer_end(renderer);
 
-	if (!output->impl->swap_buffers(output, damage ? &render_damage : NULL)) {
+	output->cursors_restored = true;
+	return true;
+}
+
+static bool output_has_software_cursor(struct wlr_output *output) {
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &output->cursors, link) {
+		if (output_cursor_is_software(cursor)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool wlr_output_present_buffer(struct wlr_output *output,
+		struct wlr_buffer *buffer, struct timespec *when) {
+	if (output->frame_pending) {
+		wlr_log(L_ERROR, "Tried to present a buffer when a frame is pending");
+		return false;
+	}
+	if (!output->impl->present_buffer || buffer->texture == NULL) {
+		return false;
+	}
+	if (output_has_software_cursor(output)) {
+		return false;
+	}
+	if (output->fullscreen_surface != NULL &&
+			output->fullscreen_surface->buffer != buffer) {
+		return false;
+	}
+
+	int width, height;
+	wlr_texture_get_size(buffer->texture, &width, &height);
+	if (width != output->width || height != output->height) {
 		return false;
 	}
 
+	if (!output->impl->present_buffer(output, buffer)) {
+		return false;
+	}
+
+	if (output->idle_frame != NULL) {
+		wl_event_source_remove(output->idle_frame);
+		output->idle_frame = NULL;
+	}
+
+	struct timespec now;
+	if (when == NULL) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		when = &now;
+	}
+
+	if (output->fullscreen_surface != NULL) {
+		// This would have been done when rendering the fullscreen surface
+		wlr_surface_send_frame_done(output->fullscreen_surface, when);
+	}
+
+	output_invalidate_cursor_backgrounds(output);
 	output->frame_pending = true;
 	output->needs_swap = false;
 	pixman_region32_clear(&output->damage);
-
-	pixman_region32_fini(&render_damage);
 	return true;
 }
 
@@ -579,6 +877,7 @@ void wlr_output_damage_whole(struct wlr_output *output) {
 
 	pixman_region32_union_rect(&output->damage, &output->damage, 0, 0,
 		width, height);
+	output_invalidate_cursor_backgrounds(output);
 	wlr_output_update_needs_swap(output);
 }
 
@@ -667,6 +966,26 @@ static void output_cursor_damage_whole(struct wlr_output_cursor *cursor) {
 	wlr_output_update_needs_swap(cursor->output);
 }
 
+/**
+ * Destroys the scene saved behind a cursor, eg. because its size changed.
+ * `wlr_output_restore_cursors` can't be used anymore for the buffers it was
+ * drawn into.
+ */
+static void output_cursor_reset_backgrounds(struct wlr_output_cursor *cursor) {
+	bool saved = false;
+	for (size_t i = 0; i < WLR_OUTPUT_CURSOR_BACKGROUNDS_LEN; ++i) {
+		struct wlr_output_cursor_background *background =
+			&cursor->backgrounds[i];
+		saved |= background->saved;
+		background->saved = false;
+		wlr_texture_destroy(background->texture);
+		background->texture = NULL;
+	}
+	if (saved) {
+		output_invalidate_cursor_backgrounds(cursor->output);
+	}
+}
+
 static void output_cursor_reset(struct wlr_output_cursor *cursor) {
 	if (cursor->output->hardware_cursor != cursor) {
 		output_cursor_damage_whole(cursor);
@@ -738,6 +1057,9 @@ bool wlr_output_cursor_set_image(struct wlr_output_cursor *cursor,
 
 	output_cursor_reset(cursor);
 
+	if (cursor->width != width || cursor->height != height) {
+		output_cursor_reset_backgrounds(cursor);
+	}
 	cursor->width = width;
 	cursor->height = height;
 	cursor->hotspot_x = hotspot_x;
@@ -777,8 +1099,13 @@ static void output_cursor_commit(struct wlr_output_cursor *cursor,
 
 	// Some clients commit a cursor surface with a NULL buffer to hide it.
 	cursor->enabled = wlr_surface_has_buffer(surface);
-	cursor->width = surface->current.width * cursor->output->scale;
-	cursor->height = surface->current.height * cursor->output->scale;
+	uint32_t width = surface->current.width * cursor->output->scale;
+	uint32_t height = surface->current.height * cursor->output->scale;
+	if (cursor->width != width || cursor->height != height) {
+		output_cursor_reset_backgrounds(cursor);
+	}
+	cursor->width = width;
+	cursor->height = height;
 	if (update_hotspot) {
 		cursor->hotspot_x -= surface->current.dx * cursor->output->scale;
 		cursor->hotspot_y -= surface->current.dy * cursor->output->scale;
@@ -924,6 +1251,7 @@ void wlr_output_cursor_destroy(struct wlr_output_cursor *cursor) {
 		}
 		cursor->output->hardware_cursor = NULL;
 	}
+	output_cursor_reset_backgrounds(cursor);
 	wlr_texture_destroy(cursor->texture);
 	wl_list_remove(&cursor->link);
 	free(cursor);
@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <time.h>
@@ -63,8 +64,13 @@ struct wlr_output_damage *wlr_output_damage_create(struct wlr_output *output) {
 	wl_signal_init(&output_damage->events.destroy);
 
 	pixman_region32_init(&output_damage->current);
+	pixman_region32_init(&output_damage->current_scene);
+	pixman_region32_init(&output_damage->cursors_damage);
+	pixman_region32_init(&output_damage->deferred);
+	pixman_region32_init(&output_damage->deferred_scene);
 	for (size_t i = 0; i < WLR_OUTPUT_DAMAGE_PREVIOUS_LEN; ++i) {
 		pixman_region32_init(&output_damage->previous[i]);
+		pixman_region32_init(&output_damage->previous_scene[i]);
 	}
 
 	wl_signal_add(&output->events.destroy, &output_damage->output_destroy);
@@ -95,65 +101,213 @@ void wlr_output_damage_destroy(struct wlr_output_damage *output_damage) {
 	wl_list_remove(&output_damage->output_needs_swap.link);
 	wl_list_remove(&output_damage->output_frame.link);
 	pixman_region32_fini(&output_damage->current);
+	pixman_region32_fini(&output_damage->current_scene);
+	pixman_region32_fini(&output_damage->cursors_damage);
+	pixman_region32_fini(&output_damage->deferred);
+	pixman_region32_fini(&output_damage->deferred_scene);
 	for (size_t i = 0; i < WLR_OUTPUT_DAMAGE_PREVIOUS_LEN; ++i) {
 		pixman_region32_fini(&output_damage->previous[i]);
+		pixman_region32_fini(&output_damage->previous_scene[i]);
 	}
 	free(output_damage);
 }
 
-bool wlr_output_damage_make_current(struct wlr_output_damage *output_damage,
-		bool *needs_swap, pixman_region32_t *damage) {
-	struct wlr_output *output = output_damage->output;
+/**
+ * Accumulates damage from the current frame and from the `buffer_age - 1`
+ * previous ones, which must be in the history.
+ */
+static void output_damage_accumulate(struct wlr_output_damage *output_damage,
+		pixman_region32_t *current, pixman_region32_t *previous,
+		int buffer_age, pixman_region32_t *damage) {
+	pixman_region32_copy(damage, current);
+
+	// Accumulate damage from old buffers
+	size_t idx = output_damage->previous_idx;
+	for (int i = 0; i < buffer_age - 1; ++i) {
+		int j = (idx + i) % WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+		pixman_region32_union(damage, damage, &previous[j]);
+	}
 
-	int buffer_age = -1;
-	if (!wlr_output_make_current(output, &buffer_age)) {
-		return false;
+	// Check the number of rectangles
+	int n_rects = pixman_region32_n_rects(damage);
+	if (n_rects > output_damage->max_rects) {
+		pixman_box32_t *extents = pixman_region32_extents(damage);
+		pixman_region32_union_rect(damage, damage, extents->x1, extents->y1,
+			extents->x2 - extents->x1, extents->y2 - extents->y1);
 	}
+}
 
+/**
+ * Computes the region that needs to be repainted in a buffer of the given age.
+ */
+static void output_damage_get_buffer_damage(
+		struct wlr_output_damage *output_damage, int buffer_age,
+		pixman_region32_t *damage) {
 	// Check if we can use damage tracking
 	if (buffer_age <= 0 || buffer_age - 1 > WLR_OUTPUT_DAMAGE_PREVIOUS_LEN) {
 		int width, height;
-		wlr_output_transformed_resolution(output, &width, &height);
+		wlr_output_transformed_resolution(output_damage->output, &width,
+			&height);
 
 		// Buffer new or too old, damage the whole output
 		pixman_region32_union_rect(damage, damage, 0, 0, width, height);
 	} else {
-		pixman_region32_copy(damage, &output_damage->current);
+		output_damage_accumulate(output_damage, &output_damage->current,
+			output_damage->previous, buffer_age, damage);
+	}
+}
 
-		// Accumulate damage from old buffers
-		size_t idx = output_damage->previous_idx;
-		for (int i = 0; i < buffer_age - 1; ++i) {
-			int j = (idx + i) % WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
-			pixman_region32_union(damage, damage, &output_damage->previous[j]);
-		}
+/**
+ * Moves the current damage to the history, once it has been repainted.
+ */
+static void output_damage_rotate(struct wlr_output_damage *output_damage) {
+	// same as decrementing, but works on unsigned integers
+	output_damage->previous_idx += WLR_OUTPUT_DAMAGE_PREVIOUS_LEN - 1;
+	output_damage->previous_idx %= WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
 
-		// Check the number of rectangles
-		int n_rects = pixman_region32_n_rects(damage);
-		if (n_rects > output_damage->max_rects) {
-			pixman_box32_t *extents = pixman_region32_extents(damage);
-			pixman_region32_union_rect(damage, damage, extents->x1, extents->y1,
-				extents->x2 - extents->x1, extents->y2 - extents->y1);
-		}
+	pixman_region32_copy(&output_damage->previous[output_damage->previous_idx],
+		&output_damage->current);
+	pixman_region32_copy(
+		&output_damage->previous_scene[output_damage->previous_idx],
+		&output_damage->current_scene);
+	pixman_region32_clear(&output_damage->current);
+	pixman_region32_clear(&output_damage->current_scene);
+}
+
+bool wlr_output_damage_make_current(struct wlr_output_damage *output_damage,
+		bool *needs_swap, pixman_region32_t *damage) {
+	struct wlr_output *output = output_damage->output;
+
+	output_damage->cursors_restored = false;
+	int buffer_age = -1;
+	if (!wlr_output_make_current(output, &buffer_age)) {
+		return false;
 	}
+	output_damage->buffer_age = buffer_age;
+
+	output_damage_get_buffer_damage(output_damage, buffer_age, damage);
 
 	*needs_swap = output->needs_swap || pixman_region32_not_empty(damage);
 	return true;
 }
 
+static void region_swap(pixman_region32_t *a, pixman_region32_t *b) {
+	pixman_region32_t tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+void wlr_output_damage_defer_swap(struct wlr_output_damage *output_damage) {
+	assert(!output_damage->swap_deferred);
+	output_damage->swap_deferred = true;
+
+	region_swap(&output_damage->current, &output_damage->deferred);
+	region_swap(&output_damage->current_scene,
+		&output_damage->deferred_scene);
+	pixman_region32_clear(&output_damage->current);
+	pixman_region32_clear(&output_damage->current_scene);
+}
+
+/**
+ * Puts back the damage of a frame rendered on a render thread, before it is
+ * swapped. Returns false if no frame was deferred.
+ */
+static bool output_damage_resume_swap(
+		struct wlr_output_damage *output_damage) {
+	if (!output_damage->swap_deferred) {
+		return false;
+	}
+	output_damage->swap_deferred = false;
+
+	region_swap(&output_damage->current, &output_damage->deferred);
+	region_swap(&output_damage->current_scene,
+		&output_damage->deferred_scene);
+	return true;
+}
+
+/**
+ * Adds the damage accumulated while a frame was rendered on a render thread to
+ * the next frame.
+ */
+static void output_damage_finish_swap(
+		struct wlr_output_damage *output_damage) {
+	pixman_region32_union(&output_damage->current, &output_damage->current,
+		&output_damage->deferred);
+	pixman_region32_union(&output_damage->current_scene,
+		&output_damage->current_scene, &output_damage->deferred_scene);
+	pixman_region32_clear(&output_damage->deferred);
+	pixman_region32_clear(&output_damage->deferred_scene);
+
+	if (pixman_region32_not_empty(&output_damage->current)) {
+		wlr_output_schedule_frame(output_damage->output);
+	}
+}
+
 bool wlr_output_damage_swap_buffers(struct wlr_output_damage *output_damage,
 		struct timespec *when, pixman_region32_t *damage) {
-	if (!wlr_output_swap_buffers(output_damage->output, when, damage)) {
+	bool deferred = output_damage_resume_swap(output_damage);
+
+	if (output_damage->cursors_restored) {
+		// The compositor only rendered the scene, the output repaints the rest
+		output_damage->cursors_restored = false;
+		if (damage != NULL) {
+			pixman_region32_union(&output_damage->cursors_damage,
+				&output_damage->cursors_damage, damage);
+		}
+		damage = &output_damage->cursors_damage;
+	}
+
+	bool ok = wlr_output_swap_buffers(output_damage->output, when, damage);
+	if (ok) {
+		output_damage_rotate(output_damage);
+	}
+	if (deferred) {
+		output_damage_finish_swap(output_damage);
+	}
+	return ok;
+}
+
+void wlr_output_damage_cancel_swap(struct wlr_output_damage *output_damage) {
+	if (!output_damage_resume_swap(output_damage)) {
+		return;
+	}
+	output_damage->cursors_restored = false;
+	output_damage_finish_swap(output_damage);
+	wlr_output_damage_add_whole(output_damage);
+}
+
+bool wlr_output_damage_restore_cursors(struct wlr_output_damage *output_damage,
+		pixman_region32_t *damage) {
+	int buffer_age = output_damage->buffer_age;
+	if (buffer_age <= 0 || buffer_age - 1 > WLR_OUTPUT_DAMAGE_PREVIOUS_LEN) {
 		return false;
 	}
 
-	// same as decrementing, but works on unsigned integers
-	output_damage->previous_idx += WLR_OUTPUT_DAMAGE_PREVIOUS_LEN - 1;
-	output_damage->previous_idx %= WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+	pixman_region32_t *cursors_damage = &output_damage->cursors_damage;
+	output_damage_get_buffer_damage(output_damage, buffer_age, cursors_damage);
+	if (!wlr_output_restore_cursors(output_damage->output, buffer_age,
+			cursors_damage)) {
+		return false;
+	}
+	output_damage->cursors_restored = true;
 
-	pixman_region32_copy(&output_damage->previous[output_damage->previous_idx],
-		&output_damage->current);
-	pixman_region32_clear(&output_damage->current);
+	// The rest of the buffer holds the scene as it was when it was last
+	// painted
+	output_damage_accumulate(output_damage, &output_damage->current_scene,
+		output_damage->previous_scene, buffer_age, damage);
+	return true;
+}
 
+bool wlr_output_damage_present_buffer(struct wlr_output_damage *output_damage,
+		struct wlr_buffer *buffer, struct timespec *when) {
+	if (!wlr_output_present_buffer(output_damage->output, buffer, when)) {
+		return false;
+	}
+
+	// The rendering buffers didn't receive this frame, the backend reports a
+	// zero buffer age next time so the damage history isn't used
+	pixman_region32_clear(&output_damage->current);
+	pixman_region32_clear(&output_damage->current_scene);
 	return true;
 }
 
@@ -166,6 +320,10 @@ void wlr_output_damage_add(struct wlr_output_damage *output_damage,
 		damage);
 	pixman_region32_intersect_rect(&output_damage->current,
 		&output_damage->current, 0, 0, width, height);
+	pixman_region32_union(&output_damage->current_scene,
+		&output_damage->current_scene, damage);
+	pixman_region32_intersect_rect(&output_damage->current_scene,
+		&output_damage->current_scene, 0, 0, width, height);
 	wlr_output_schedule_frame(output_damage->output);
 }
 
@@ -175,6 +333,8 @@ void wlr_output_damage_add_whole(struct wlr_output_damage *output_damage) {
 
 	pixman_region32_union_rect(&output_damage->current, &output_damage->current,
 		0, 0, width, height);
+	pixman_region32_union_rect(&output_damage->current_scene,
+		&output_damage->current_scene, 0, 0, width, height);
 
 	wlr_output_schedule_frame(output_damage->output);
 }
@@ -188,5 +348,10 @@ void wlr_output_damage_add_box(struct wlr_output_damage *output_damage,
 		box->x, box->y, box->width, box->height);
 	pixman_region32_intersect_rect(&output_damage->current,
 		&output_damage->current, 0, 0, width, height);
+	pixman_region32_union_rect(&output_damage->current_scene,
+		&output_damage->current_scene, box->x, box->y, box->width,
+		box->height);
+	pixman_region32_intersect_rect(&output_damage->current_scene,
+		&output_damage->current_scene, 0, 0, width, height);
 	wlr_output_schedule_frame(output_damage->output);
 }
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <float.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_output_layout.h>
@@ -8,8 +9,22 @@
 #include <wlr/util/log.h>
 #include "util/signal.h"
 
+struct output_layout_entry {
+	struct wlr_output_layout_output *l_output;
+	struct wlr_box box;
+	size_t order; // position in wlr_output_layout::outputs
+};
+
 struct wlr_output_layout_state {
 	struct wlr_box _box; // should never be read directly, use the getter
+
+	// Index of the outputs, rebuilt lazily after the layout changed. Queries
+	// walk wlr_output_layout::outputs instead if it cannot be rebuilt.
+	bool index_dirty;
+	size_t index_len, index_cap;
+	struct output_layout_entry *by_x; // sorted by box.x
+	struct wlr_output_layout_output **by_output; // sorted by output address
+	int max_width; // of all boxes in by_x
 };
 
 struct wlr_output_layout_output_state {
@@ -37,6 +52,7 @@ struct wlr_output_layout *wlr_output_layout_create(void) {
 		return NULL;
 	}
 	wl_list_init(&layout->outputs);
+	layout->state->index_dirty = true;
 
 	wl_signal_init(&layout->events.add);
 	wl_signal_init(&layout->events.change);
@@ -54,6 +70,7 @@ static void output_layout_output_destroy(
 	wl_list_remove(&l_output->state->transform.link);
 	wl_list_remove(&l_output->state->output_destroy.link);
 	wl_list_remove(&l_output->link);
+	l_output->state->layout->state->index_dirty = true;
 	free(l_output->state);
 	free(l_output);
 }
@@ -70,6 +87,8 @@ void wlr_output_layout_destroy(struct wlr_output_layout *layout) {
 		output_layout_output_destroy(l_output);
 	}
 
+	free(layout->state->by_x);
+	free(layout->state->by_output);
 	free(layout->state);
 	free(layout);
 }
@@ -85,6 +104,94 @@ static struct wlr_box *output_layout_output_get_box(
 	return &l_output->state->_box;
 }
 
+static int entry_x_cmp(const void *a, const void *b) {
+	const struct output_layout_entry *entry_a = a;
+	const struct output_layout_entry *entry_b = b;
+	if (entry_a->box.x != entry_b->box.x) {
+		return entry_a->box.x < entry_b->box.x ? -1 : 1;
+	}
+	// Keep the layout order for outputs in the same column
+	return entry_a->order < entry_b->order ? -1 : 1;
+}
+
+static int l_output_cmp(const void *a, const void *b) {
+	uintptr_t output_a =
+		(uintptr_t)(*(struct wlr_output_layout_output * const *)a)->output;
+	uintptr_t output_b =
+		(uintptr_t)(*(struct wlr_output_layout_output * const *)b)->output;
+	return (output_a > output_b) - (output_a < output_b);
+}
+
+/**
+ * Returns false if the index is unusable, in which case callers need to walk
+ * the output list.
+ */
+static bool output_layout_update_index(struct wlr_output_layout *layout) {
+	struct wlr_output_layout_state *state = layout->state;
+	if (!state->index_dirty) {
+		return true;
+	}
+
+	size_t len = wl_list_length(&layout->outputs);
+	if (len > state->index_cap) {
+		struct output_layout_entry *by_x =
+			realloc(state->by_x, len * sizeof(*by_x));
+		if (by_x == NULL) {
+			wlr_log(L_ERROR, "Allocation failed");
+			return false;
+		}
+		state->by_x = by_x;
+		struct wlr_output_layout_output **by_output =
+			realloc(state->by_output, len * sizeof(*by_output));
+		if (by_output == NULL) {
+			wlr_log(L_ERROR, "Allocation failed");
+			return false;
+		}
+		state->by_output = by_output;
+		state->index_cap = len;
+	}
+
+	size_t i = 0;
+	state->max_width = 0;
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		struct output_layout_entry *entry = &state->by_x[i];
+		entry->l_output = l_output;
+		entry->box = *output_layout_output_get_box(l_output);
+		entry->order = i;
+		if (entry->box.width > state->max_width) {
+			state->max_width = entry->box.width;
+		}
+		state->by_output[i] = l_output;
+		++i;
+	}
+	qsort(state->by_x, len, sizeof(state->by_x[0]), entry_x_cmp);
+	qsort(state->by_output, len, sizeof(state->by_output[0]), l_output_cmp);
+
+	state->index_len = len;
+	state->index_dirty = false;
+	return true;
+}
+
+/**
+ * Returns the index of the first entry with a box starting after `lx`.
+ * Entries before it may contain `lx` only if they start after
+ * `lx - max_width`.
+ */
+static size_t output_layout_index_upper_bound(
+		struct wlr_output_layout_state *state, double lx) {
+	size_t lo = 0, hi = state->index_len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (state->by_x[mid].box.x > lx) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	return lo;
+}
+
 /**
  * This must be called whenever the layout changes to reconfigure the auto
  * configured outputs and emit the `changed` event.
@@ -131,6 +238,8 @@ static void output_layout_reconfigure(struct wlr_output_layout *layout) {
 		wlr_output_set_position(l_output->output, l_output->x, l_output->y);
 	}
 
+	layout->state->index_dirty = true;
+
 	wlr_signal_emit_safe(&layout->events.change, layout);
 }
 
@@ -177,6 +286,7 @@ static struct wlr_output_layout_output *output_layout_output_create(
 	l_output->output = output;
 	wl_signal_init(&l_output->events.destroy);
 	wl_list_insert(&layout->outputs, &l_output->link);
+	layout->state->index_dirty = true;
 
 	wl_signal_add(&output->events.mode, &l_output->state->mode);
 	l_output->state->mode.notify = handle_output_mode;
@@ -211,6 +321,23 @@ void wlr_output_layout_add(struct wlr_output_layout *layout,
 
 struct wlr_output_layout_output *wlr_output_layout_get(
 		struct wlr_output_layout *layout, struct wlr_output *reference) {
+	if (output_layout_update_index(layout)) {
+		struct wlr_output_layout_state *state = layout->state;
+		size_t lo = 0, hi = state->index_len;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			struct wlr_output *output = state->by_output[mid]->output;
+			if (output == reference) {
+				return state->by_output[mid];
+			} else if ((uintptr_t)output < (uintptr_t)reference) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		return NULL;
+	}
+
 	struct wlr_output_layout_output *l_output;
 	wl_list_for_each(l_output, &layout->outputs, link) {
 		if (l_output->output == reference) {
@@ -237,15 +364,8 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 	struct wlr_box out_box;
 
 	if (reference == NULL) {
-		struct wlr_output_layout_output *l_output;
-		wl_list_for_each(l_output, &layout->outputs, link) {
-			struct wlr_box *output_box =
-				output_layout_output_get_box(l_output);
-			if (wlr_box_intersection(output_box, target_lbox, &out_box)) {
-				return true;
-			}
-		}
-		return false;
+		return wlr_output_layout_outputs_in_box(layout, target_lbox,
+			NULL, 0) > 0;
 	} else {
 		struct wlr_output_layout_output *l_output =
 			wlr_output_layout_get(layout, reference);
@@ -258,8 +378,65 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 	}
 }
 
+size_t wlr_output_layout_outputs_in_box(struct wlr_output_layout *layout,
+		const struct wlr_box *target_lbox, struct wlr_output **outputs,
+		size_t outputs_len) {
+	struct wlr_box out_box;
+	size_t n = 0;
+
+	if (!output_layout_update_index(layout)) {
+		struct wlr_output_layout_output *l_output;
+		wl_list_for_each(l_output, &layout->outputs, link) {
+			struct wlr_box *output_box =
+				output_layout_output_get_box(l_output);
+			if (wlr_box_intersection(output_box, target_lbox, &out_box)) {
+				if (n < outputs_len) {
+					outputs[n] = l_output->output;
+				}
+				++n;
+			}
+		}
+		return n;
+	}
+
+	struct wlr_output_layout_state *state = layout->state;
+	size_t end = output_layout_index_upper_bound(state,
+		target_lbox->x + target_lbox->width - 1);
+	for (size_t i = end; i-- > 0;) {
+		struct output_layout_entry *entry = &state->by_x[i];
+		if (entry->box.x + state->max_width <= target_lbox->x) {
+			break;
+		}
+		if (wlr_box_intersection(&entry->box, target_lbox, &out_box)) {
+			if (n < outputs_len) {
+				outputs[n] = entry->l_output->output;
+			}
+			++n;
+		}
+	}
+	return n;
+}
+
 struct wlr_output *wlr_output_layout_output_at(struct wlr_output_layout *layout,
 		double lx, double ly) {
+	if (output_layout_update_index(layout)) {
+		// Overlapping outputs are resolved in layout order
+		struct wlr_output_layout_state *state = layout->state;
+		struct output_layout_entry *found = NULL;
+		size_t end = output_layout_index_upper_bound(state, lx);
+		for (size_t i = end; i-- > 0;) {
+			struct output_layout_entry *entry = &state->by_x[i];
+			if (entry->box.x + state->max_width <= lx) {
+				break;
+			}
+			if (wlr_box_contains_point(&entry->box, lx, ly) &&
+					(found == NULL || entry->order < found->order)) {
+				found = entry;
+			}
+		}
+		return found != NULL ? found->l_output->output : NULL;
+	}
+
 	struct wlr_output_layout_output *l_output;
 	wl_list_for_each(l_output, &layout->outputs, link) {
 		struct wlr_box *box = output_layout_output_get_box(l_output);
@@ -297,16 +474,11 @@ void wlr_output_layout_remove(struct wlr_output_layout *layout,
 void wlr_output_layout_output_coords(struct wlr_output_layout *layout,
 		struct wlr_output *reference, double *lx, double *ly) {
 	assert(layout && reference);
-	double src_x = *lx;
-	double src_y = *ly;
-
-	struct wlr_output_layout_output *l_output;
-	wl_list_for_each(l_output, &layout->outputs, link) {
-		if (l_output->output == reference) {
-			*lx = src_x - (double)l_output->x;
-			*ly = src_y - (double)l_output->y;
-			return;
-		}
+	struct wlr_output_layout_output *l_output =
+		wlr_output_layout_get(layout, reference);
+	if (l_output) {
+		*lx -= (double)l_output->x;
+		*ly -= (double)l_output->y;
 	}
 }
 
@@ -317,6 +489,17 @@ void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 		return;
 	}
 
+	if (reference == NULL && wlr_output_layout_output_at(layout, lx, ly)) {
+		// Already in the layout
+		if (dest_lx) {
+			*dest_lx = lx;
+		}
+		if (dest_ly) {
+			*dest_ly = ly;
+		}
+		return;
+	}
+
 	double min_x = DBL_MAX, min_y = DBL_MAX, min_distance = DBL_MAX;
 	struct wlr_output_layout_output *l_output;
 	wl_list_for_each(l_output, &layout->outputs, link) {
@@ -0,0 +1,264 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wayland-server.h>
+#include <wlr/interfaces/wlr_output.h>
+#include <wlr/render/egl.h>
+#include <wlr/render/gles2.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_render_thread.h>
+#include <wlr/util/log.h>
+#include "util/signal.h"
+
+/**
+ * The thread takes the output's buffer with `impl->make_current` rather than
+ * `wlr_output_make_current`, which updates state owned by the main thread.
+ * Only one thread can have the buffer current at a time: the main thread
+ * releases it when submitting a frame, the render thread when it is done.
+ */
+
+static void write_eventfd(int fd) {
+	uint64_t one = 1;
+	if (write(fd, &one, sizeof(one)) < 0) {
+		wlr_log_errno(L_ERROR, "Failed to write to render thread eventfd");
+	}
+}
+
+static void read_eventfd(int fd) {
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		wlr_log_errno(L_ERROR, "Failed to read from render thread eventfd");
+	}
+}
+
+static bool render_frame(struct wlr_output_render_thread *render_thread,
+		struct wlr_renderer *renderer, wlr_output_render_func_t render,
+		void *data, EGLSyncKHR fence) {
+	struct wlr_output *output = render_thread->output;
+	struct wlr_egl *egl = render_thread->egl;
+
+	wlr_egl_wait_fence(egl, fence);
+	if (!output->impl->make_current(output, NULL)) {
+		wlr_log(L_ERROR, "Failed to make output '%s' current on its render "
+			"thread", output->name);
+		wlr_egl_make_current(egl, EGL_NO_SURFACE, NULL);
+		return false;
+	}
+
+	render(output, renderer, data);
+
+	// The main thread swaps buffers once the frame is complete
+	wlr_egl_wait_fence(egl, wlr_egl_create_fence(egl));
+	wlr_egl_make_current(egl, EGL_NO_SURFACE, NULL);
+	return true;
+}
+
+static void *render_thread_run(void *data) {
+	struct wlr_output_render_thread *render_thread = data;
+	struct wlr_egl *egl = render_thread->egl;
+
+	struct wlr_renderer *renderer = NULL;
+	bool bound = wlr_egl_bind_thread(egl);
+	if (bound) {
+		renderer = wlr_gles2_renderer_create(egl);
+	}
+
+	pthread_mutex_lock(&render_thread->lock);
+	render_thread->started = true;
+	render_thread->stop = renderer == NULL;
+	pthread_cond_broadcast(&render_thread->cond);
+
+	while (true) {
+		while (!render_thread->stop && render_thread->render == NULL) {
+			pthread_cond_wait(&render_thread->cond, &render_thread->lock);
+		}
+		// A submitted frame is rendered even when stopping, to release the
+		// output's buffer
+		if (render_thread->render == NULL) {
+			break;
+		}
+		wlr_output_render_func_t render = render_thread->render;
+		void *render_data = render_thread->render_data;
+		EGLSyncKHR fence = render_thread->fence;
+		pthread_mutex_unlock(&render_thread->lock);
+
+		bool rendered = render_frame(render_thread, renderer, render,
+			render_data, fence);
+
+		pthread_mutex_lock(&render_thread->lock);
+		render_thread->render = NULL;
+		render_thread->rendered = rendered;
+		write_eventfd(render_thread->notify_fd);
+	}
+	pthread_mutex_unlock(&render_thread->lock);
+
+	wlr_renderer_destroy(renderer);
+	if (bound) {
+		wlr_egl_unbind_thread(egl);
+	}
+	return NULL;
+}
+
+static int handle_notify(int fd, uint32_t mask, void *data) {
+	struct wlr_output_render_thread *render_thread = data;
+	struct wlr_output *output = render_thread->output;
+	read_eventfd(fd);
+
+	pthread_mutex_lock(&render_thread->lock);
+	bool done = render_thread->busy && render_thread->render == NULL;
+	bool rendered = render_thread->rendered;
+	pthread_mutex_unlock(&render_thread->lock);
+	if (!done) {
+		return 0;
+	}
+	render_thread->busy = false;
+
+	// Take the output's buffer back, for the compositor to swap it
+	if (rendered && !output->impl->make_current(output, NULL)) {
+		wlr_log(L_ERROR, "Failed to make output '%s' current",
+			output->name);
+		rendered = false;
+	}
+
+	struct wlr_output_render_thread_done_event event = {
+		.render_thread = render_thread,
+		.rendered = rendered,
+	};
+	wlr_signal_emit_safe(&render_thread->events.done, &event);
+	return 0;
+}
+
+static void output_handle_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_output_render_thread *render_thread =
+		wl_container_of(listener, render_thread, output_destroy);
+	wlr_output_render_thread_destroy(render_thread);
+}
+
+struct wlr_output_render_thread *wlr_output_render_thread_create(
+		struct wlr_output *output) {
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	if (renderer == NULL || !wlr_renderer_is_gles2(renderer)) {
+		wlr_log(L_ERROR, "Render threads require the GLES2 renderer");
+		return NULL;
+	}
+
+	struct wlr_output_render_thread *render_thread =
+		calloc(1, sizeof(struct wlr_output_render_thread));
+	if (render_thread == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return NULL;
+	}
+	render_thread->output = output;
+	render_thread->egl = wlr_gles2_renderer_get_egl(renderer);
+	wl_signal_init(&render_thread->events.done);
+	wl_signal_init(&render_thread->events.destroy);
+
+	if (pthread_mutex_init(&render_thread->lock, NULL) != 0) {
+		wlr_log(L_ERROR, "Failed to create render thread lock");
+		goto error_lock;
+	}
+	if (pthread_cond_init(&render_thread->cond, NULL) != 0) {
+		wlr_log(L_ERROR, "Failed to create render thread condition");
+		goto error_cond;
+	}
+
+	render_thread->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (render_thread->notify_fd < 0) {
+		wlr_log_errno(L_ERROR, "Failed to create render thread eventfd");
+		goto error_fd;
+	}
+
+	struct wl_event_loop *event_loop =
+		wl_display_get_event_loop(output->display);
+	render_thread->notify_source = wl_event_loop_add_fd(event_loop,
+		render_thread->notify_fd, WL_EVENT_READABLE, handle_notify,
+		render_thread);
+	if (render_thread->notify_source == NULL) {
+		wlr_log(L_ERROR, "Failed to create render thread event on event loop");
+		goto error_source;
+	}
+
+	if (pthread_create(&render_thread->thread, NULL, render_thread_run,
+			render_thread) != 0) {
+		wlr_log(L_ERROR, "Failed to start render thread");
+		goto error_thread;
+	}
+
+	// Wait for the thread to create its renderer
+	pthread_mutex_lock(&render_thread->lock);
+	while (!render_thread->started) {
+		pthread_cond_wait(&render_thread->cond, &render_thread->lock);
+	}
+	bool stopped = render_thread->stop;
+	pthread_mutex_unlock(&render_thread->lock);
+	if (stopped) {
+		wlr_log(L_ERROR, "Failed to create renderer on render thread");
+		pthread_join(render_thread->thread, NULL);
+		goto error_thread;
+	}
+
+	wl_signal_add(&output->events.destroy, &render_thread->output_destroy);
+	render_thread->output_destroy.notify = output_handle_destroy;
+
+	wlr_log(L_DEBUG, "Started render thread for output '%s'", output->name);
+	return render_thread;
+
+error_thread:
+	wl_event_source_remove(render_thread->notify_source);
+error_source:
+	close(render_thread->notify_fd);
+error_fd:
+	pthread_cond_destroy(&render_thread->cond);
+error_cond:
+	pthread_mutex_destroy(&render_thread->lock);
+error_lock:
+	free(render_thread);
+	return NULL;
+}
+
+void wlr_output_render_thread_destroy(
+		struct wlr_output_render_thread *render_thread) {
+	if (render_thread == NULL) {
+		return;
+	}
+
+	wlr_signal_emit_safe(&render_thread->events.destroy, render_thread);
+
+	pthread_mutex_lock(&render_thread->lock);
+	render_thread->stop = true;
+	pthread_cond_signal(&render_thread->cond);
+	pthread_mutex_unlock(&render_thread->lock);
+	pthread_join(render_thread->thread, NULL);
+
+	wl_list_remove(&render_thread->output_destroy.link);
+	wl_event_source_remove(render_thread->notify_source);
+	close(render_thread->notify_fd);
+	pthread_cond_destroy(&render_thread->cond);
+	pthread_mutex_destroy(&render_thread->lock);
+	free(render_thread);
+}
+
+void wlr_output_render_thread_submit(
+		struct wlr_output_render_thread *render_thread,
+		wlr_output_render_func_t render, void *data) {
+	struct wlr_egl *egl = render_thread->egl;
+	assert(!render_thread->busy);
+	assert(wlr_egl_is_current(egl));
+
+	// Make what the main thread uploaded visible to the render thread, then
+	// hand the output's buffer over
+	EGLSyncKHR fence = wlr_egl_create_fence(egl);
+	wlr_egl_make_current(egl, EGL_NO_SURFACE, NULL);
+
+	render_thread->busy = true;
+	pthread_mutex_lock(&render_thread->lock);
+	render_thread->render = render;
+	render_thread->render_data = data;
+	render_thread->fence = fence;
+	pthread_cond_signal(&render_thread->cond);
+	pthread_mutex_unlock(&render_thread->lock);
+}
@@ -2,10 +2,12 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <unistd.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_virtual_keyboard_v1.h>
 #include <wlr/util/log.h>
 #include <xkbcommon/xkbcommon.h>
+#include "types/wlr_keyboard.h"
 #include "util/signal.h"
 #include "virtual-keyboard-unstable-v1-protocol.h"
 
@@ -46,28 +48,21 @@ static void virtual_keyboard_keymap(struct wl_client *client,
 	struct wlr_virtual_keyboard_v1 *keyboard =
 		virtual_keyboard_from_resource(resource);
 
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	if (!context) {
-		goto context_fail;
-	}
 	void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
-	if (!data) {
-		goto fd_fail;
+	close(fd);
+	if (data == MAP_FAILED) {
+		goto fail;
 	}
-	struct xkb_keymap *keymap = xkb_keymap_new_from_string(context, data,
-		XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	// Compiling takes milliseconds, clients often send the same keymaps
+	struct xkb_keymap *keymap = keymap_cache_new_from_buffer(data, size);
 	munmap(data, size);
 	if (!keymap) {
-		goto keymap_fail;
+		goto fail;
 	}
 	wlr_keyboard_set_keymap(keyboard->input_device.keyboard, keymap);
 	xkb_keymap_unref(keymap);
-	xkb_context_unref(context);
 	return;
-keymap_fail:
-fd_fail:
-	xkb_context_unref(context);
-context_fail:
+fail:
 	wl_client_post_no_memory(client);
 }
 
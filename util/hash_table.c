@@ -0,0 +1,130 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "util/hash_table.h"
+
+#define HASH_TABLE_MIN_CAP 16
+
+static uint64_t hash_key(uint64_t key) {
+	// splitmix64 finalizer, pointers and IDs have poor low bits
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111eb;
+	key ^= key >> 31;
+	return key;
+}
+
+static size_t find_slot(const struct hash_table *table, uint64_t key) {
+	size_t mask = table->cap - 1;
+	size_t i = hash_key(key) & mask;
+	while (table->entries[i].value != NULL && table->entries[i].key != key) {
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+static bool hash_table_resize(struct hash_table *table, size_t cap) {
+	struct hash_table_entry *entries =
+		calloc(cap, sizeof(struct hash_table_entry));
+	if (entries == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return false;
+	}
+
+	struct hash_table_entry *old_entries = table->entries;
+	size_t old_cap = table->cap;
+	table->entries = entries;
+	table->cap = cap;
+
+	for (size_t i = 0; i < old_cap; ++i) {
+		if (old_entries[i].value != NULL) {
+			table->entries[find_slot(table, old_entries[i].key)] =
+				old_entries[i];
+		}
+	}
+	free(old_entries);
+	return true;
+}
+
+void hash_table_init(struct hash_table *table) {
+	table->entries = NULL;
+	table->cap = 0;
+	table->len = 0;
+}
+
+void hash_table_finish(struct hash_table *table) {
+	free(table->entries);
+	hash_table_init(table);
+}
+
+void *hash_table_get(const struct hash_table *table, uint64_t key) {
+	if (table->len == 0) {
+		return NULL;
+	}
+	return table->entries[find_slot(table, key)].value;
+}
+
+bool hash_table_set(struct hash_table *table, uint64_t key, void *value) {
+	assert(value != NULL);
+
+	// Keep the load factor under 1/2 so that probe sequences stay short
+	if (2 * (table->len + 1) > table->cap) {
+		size_t cap = table->cap > 0 ? 2 * table->cap : HASH_TABLE_MIN_CAP;
+		if (!hash_table_resize(table, cap)) {
+			return false;
+		}
+	}
+
+	struct hash_table_entry *entry = &table->entries[find_slot(table, key)];
+	if (entry->value == NULL) {
+		table->len++;
+	}
+	entry->key = key;
+	entry->value = value;
+	return true;
+}
+
+void *hash_table_remove(struct hash_table *table, uint64_t key) {
+	if (table->len == 0) {
+		return NULL;
+	}
+
+	size_t mask = table->cap - 1;
+	size_t i = find_slot(table, key);
+	void *value = table->entries[i].value;
+	if (value == NULL) {
+		return NULL;
+	}
+
+	// Shift back the following entries of the probe sequence instead of
+	// leaving a tombstone
+	size_t j = i;
+	while (true) {
+		j = (j + 1) & mask;
+		struct hash_table_entry *entry = &table->entries[j];
+		if (entry->value == NULL) {
+			break;
+		}
+		size_t home = hash_key(entry->key) & mask;
+		// Move the entry to the hole unless its home slot is in (i, j]
+		bool in_range = i <= j ? (i < home && home <= j) :
+			(i < home || home <= j);
+		if (!in_range) {
+			table->entries[i] = *entry;
+			i = j;
+		}
+	}
+	table->entries[i].value = NULL;
+	table->len--;
+	return value;
+}
+
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+	const uint8_t *bytes = data;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
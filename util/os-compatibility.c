@@ -23,17 +23,25 @@
  * SOFTWARE.
  */
 
-#define _XOPEN_SOURCE 700
+#define _GNU_SOURCE
 #include <errno.h>
 #include <fcntl.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include "util/os-compatibility.h"
 
+#if defined(SYS_memfd_create) && defined(MFD_ALLOW_SEALING) && \
+	defined(F_ADD_SEALS)
+#define HAVE_SEALED_MEMFD 1
+#endif
+
 int os_fd_set_cloexec(int fd) {
 	long flags;
 
@@ -148,3 +156,85 @@ int os_create_anonymous_file(off_t size) {
 
 	return fd;
 }
+
+static bool write_all(int fd, const void *data, size_t size) {
+	const char *p = data;
+	while (size > 0) {
+		ssize_t n = write(fd, p, size);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+/*
+ * Create an empty anonymous file, and return the file descriptor for it.
+ * The file descriptor is set CLOEXEC. `name` only shows up in
+ * /proc/self/fd, and is used when memfd is supported. Otherwise it falls
+ * back to os_create_anonymous_file().
+ */
+int os_create_empty_file(const char *name) {
+	int fd = -1;
+#if defined(SYS_memfd_create) && defined(MFD_CLOEXEC)
+	fd = syscall(SYS_memfd_create, name, MFD_CLOEXEC);
+#endif
+	if (fd >= 0) {
+		return fd;
+	}
+
+	// posix_fallocate fails with an empty size
+	fd = os_create_anonymous_file(1);
+	if (fd < 0) {
+		return -1;
+	}
+	if (ftruncate(fd, 0) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Create an anonymous file holding a copy of the given data, and return
+ * the file descriptor for it. The file descriptor is set CLOEXEC.
+ *
+ * When memfd sealing is supported, the file can't be written to, grown
+ * or shrunk anymore, so the same file descriptor can safely be shared
+ * with several clients. Otherwise it falls back to
+ * os_create_anonymous_file().
+ */
+int os_create_sealed_file(const void *data, size_t size) {
+	int fd = -1;
+#ifdef HAVE_SEALED_MEMFD
+	fd = syscall(SYS_memfd_create, "wlroots-sealed",
+		MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#endif
+	bool sealable = fd >= 0;
+	if (!sealable) {
+		fd = os_create_anonymous_file(size);
+		if (fd < 0) {
+			return -1;
+		}
+	}
+
+	if (!write_all(fd, data, size)) {
+		close(fd);
+		return -1;
+	}
+
+#ifdef HAVE_SEALED_MEMFD
+	if (sealable && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+			F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+		close(fd);
+		return -1;
+	}
+#endif
+
+	return fd;
+}
@@ -0,0 +1,28 @@
+#include <stdint.h>
+#include <time.h>
+#include "util/time.h"
+
+static const int64_t nsec_per_sec = 1000000000;
+
+int64_t timespec_to_nsec(const struct timespec *a) {
+	return (int64_t)a->tv_sec * nsec_per_sec + a->tv_nsec;
+}
+
+void timespec_from_nsec(struct timespec *r, int64_t nsec) {
+	r->tv_sec = nsec / nsec_per_sec;
+	r->tv_nsec = nsec % nsec_per_sec;
+	if (r->tv_nsec < 0) {
+		r->tv_sec--;
+		r->tv_nsec += nsec_per_sec;
+	}
+}
+
+void timespec_sub(struct timespec *r, const struct timespec *a,
+		const struct timespec *b) {
+	r->tv_sec = a->tv_sec - b->tv_sec;
+	r->tv_nsec = a->tv_nsec - b->tv_nsec;
+	if (r->tv_nsec < 0) {
+		r->tv_sec--;
+		r->tv_nsec += nsec_per_sec;
+	}
+}
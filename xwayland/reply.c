@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "xwayland/xwm.h"
+
+void xwm_queue_reply(struct wlr_xwm *xwm, unsigned int sequence,
+		xcb_window_t window, xwm_reply_handler_t handler, void *data) {
+	struct xwm_pending_reply *pending =
+		calloc(1, sizeof(struct xwm_pending_reply));
+	if (pending == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		xcb_discard_reply(xwm->xcb_conn, sequence);
+		handler(xwm, NULL, NULL, data);
+		return;
+	}
+	pending->sequence = sequence;
+	pending->window = window;
+	pending->handler = handler;
+	pending->data = data;
+	wl_list_insert(xwm->pending_replies.prev, &pending->link);
+}
+
+static void handle_pending_reply(struct wlr_xwm *xwm,
+		struct xwm_pending_reply *pending, void *reply,
+		xcb_generic_error_t *error) {
+	// The handler may queue or discard other requests
+	wl_list_remove(&pending->link);
+	pending->handler(xwm, reply, error, pending->data);
+	free(pending);
+}
+
+int xwm_dispatch_replies(struct wlr_xwm *xwm) {
+	int count = 0;
+	while (!wl_list_empty(&xwm->pending_replies)) {
+		struct xwm_pending_reply *pending =
+			wl_container_of(xwm->pending_replies.next, pending, link);
+		void *reply = NULL;
+		xcb_generic_error_t *error = NULL;
+		if (!xcb_poll_for_reply(xwm->xcb_conn, pending->sequence, &reply,
+				&error)) {
+			break;
+		}
+		handle_pending_reply(xwm, pending, reply, error);
+		count++;
+	}
+	return count;
+}
+
+bool xwm_has_pending_replies(struct wlr_xwm *xwm, xcb_window_t window) {
+	struct xwm_pending_reply *pending;
+	wl_list_for_each(pending, &xwm->pending_replies, link) {
+		if (pending->window == window) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void xwm_discard_replies(struct wlr_xwm *xwm, xcb_window_t window) {
+	struct wl_list discarded;
+	wl_list_init(&discarded);
+
+	struct xwm_pending_reply *pending, *tmp;
+	wl_list_for_each_safe(pending, tmp, &xwm->pending_replies, link) {
+		if (window == XCB_WINDOW_NONE || pending->window == window) {
+			xcb_discard_reply(xwm->xcb_conn, pending->sequence);
+			wl_list_remove(&pending->link);
+			wl_list_insert(discarded.prev, &pending->link);
+		}
+	}
+
+	while (!wl_list_empty(&discarded)) {
+		pending = wl_container_of(discarded.next, pending, link);
+		handle_pending_reply(xwm, pending, NULL, NULL);
+	}
+}
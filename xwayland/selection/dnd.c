@@ -1,6 +1,7 @@
 #define _XOPEN_SOURCE 700
 #include <assert.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -59,39 +60,51 @@ static void xwm_dnd_send_event(struct wlr_xwm *xwm, xcb_atom_t type,
 	xcb_flush(xwm->xcb_conn);
 }
 
-static void xwm_dnd_send_enter(struct wlr_xwm *xwm) {
+static void xwm_dnd_send_position(struct wlr_xwm *xwm, uint32_t time, int16_t x,
+		int16_t y) {
 	struct wlr_drag *drag = xwm->drag;
 	assert(drag != NULL);
-	struct wl_array *mime_types = &drag->source->mime_types;
+
+	if (xwm->dnd_enter.pending) {
+		xwm->dnd_enter.position = true;
+		xwm->dnd_enter.time = time;
+		xwm->dnd_enter.x = x;
+		xwm->dnd_enter.y = y;
+		return;
+	}
 
 	xcb_client_message_data_t data = { 0 };
 	data.data32[0] = xwm->dnd_window;
-	data.data32[1] = XDND_VERSION << 24;
+	data.data32[2] = (x << 16) | y;
+	data.data32[3] = time;
+	data.data32[4] =
+		data_device_manager_dnd_action_to_atom(xwm, drag->source->actions);
+
+	xwm_dnd_send_event(xwm, xwm->atoms[DND_POSITION], &data);
+}
+
+static void handle_dnd_enter_atoms(struct wlr_xwm *xwm, xcb_atom_t *atoms,
+		size_t n, void *data) {
+	uint32_t serial = (uintptr_t)data;
+	if (atoms == NULL || !xwm->dnd_enter.pending ||
+			serial != xwm->dnd_enter.serial) {
+		// The drag left the window or another one was entered meanwhile
+		return;
+	}
+	xwm->dnd_enter.pending = false;
+
+	xcb_client_message_data_t message = { 0 };
+	message.data32[0] = xwm->dnd_window;
+	message.data32[1] = XDND_VERSION << 24;
 
 	// If we have 3 MIME types or less, we can send them directly in the
 	// DND_ENTER message
-	size_t n = mime_types->size / sizeof(char *);
 	if (n <= 3) {
-		size_t i = 0;
-		char **mime_type_ptr;
-		wl_array_for_each(mime_type_ptr, mime_types) {
-			char *mime_type = *mime_type_ptr;
-			data.data32[2+i] = xwm_mime_type_to_atom(xwm, mime_type);
-			++i;
-		}
+		memcpy(&message.data32[2], atoms, n * sizeof(xcb_atom_t));
 	} else {
 		// Let the client know that targets are not contained in the message
 		// data and must be retrieved with the DND_TYPE_LIST property
-		data.data32[1] |= 1;
-
-		xcb_atom_t targets[n];
-		size_t i = 0;
-		char **mime_type_ptr;
-		wl_array_for_each(mime_type_ptr, mime_types) {
-			char *mime_type = *mime_type_ptr;
-			targets[i] = xwm_mime_type_to_atom(xwm, mime_type);
-			++i;
-		}
+		message.data32[1] |= 1;
 
 		xcb_change_property(xwm->xcb_conn,
 			XCB_PROP_MODE_REPLACE,
@@ -99,25 +112,26 @@ static void xwm_dnd_send_enter(struct wlr_xwm *xwm) {
 			xwm->atoms[DND_TYPE_LIST],
 			XCB_ATOM_ATOM,
 			32, // format
-			n, targets);
+			n, atoms);
 	}
 
-	xwm_dnd_send_event(xwm, xwm->atoms[DND_ENTER], &data);
+	xwm_dnd_send_event(xwm, xwm->atoms[DND_ENTER], &message);
+
+	if (xwm->dnd_enter.position) {
+		xwm_dnd_send_position(xwm, xwm->dnd_enter.time, xwm->dnd_enter.x,
+			xwm->dnd_enter.y);
+	}
 }
 
-static void xwm_dnd_send_position(struct wlr_xwm *xwm, uint32_t time, int16_t x,
-		int16_t y) {
+static void xwm_dnd_send_enter(struct wlr_xwm *xwm) {
 	struct wlr_drag *drag = xwm->drag;
 	assert(drag != NULL);
 
-	xcb_client_message_data_t data = { 0 };
-	data.data32[0] = xwm->dnd_window;
-	data.data32[2] = (x << 16) | y;
-	data.data32[3] = time;
-	data.data32[4] =
-		data_device_manager_dnd_action_to_atom(xwm, drag->source->actions);
-
-	xwm_dnd_send_event(xwm, xwm->atoms[DND_POSITION], &data);
+	xwm->dnd_enter.pending = true;
+	xwm->dnd_enter.serial++;
+	xwm->dnd_enter.position = false;
+	xwm_mime_types_to_atoms(xwm, &drag->source->mime_types,
+		handle_dnd_enter_atoms, (void *)(uintptr_t)xwm->dnd_enter.serial);
 }
 
 static void xwm_dnd_send_drop(struct wlr_xwm *xwm, uint32_t time) {
@@ -126,6 +140,12 @@ static void xwm_dnd_send_drop(struct wlr_xwm *xwm, uint32_t time) {
 	struct wlr_xwayland_surface *dest = xwm->drag_focus;
 	assert(dest != NULL);
 
+	if (xwm->dnd_enter.pending) {
+		// The window doesn't know about the drag yet, it can't accept it
+		wlr_log(L_DEBUG, "Wayland drag dropped before XdndEnter was sent");
+		return;
+	}
+
 	xcb_client_message_data_t data = { 0 };
 	data.data32[0] = xwm->dnd_window;
 	data.data32[2] = time;
@@ -139,6 +159,12 @@ static void xwm_dnd_send_leave(struct wlr_xwm *xwm) {
 	struct wlr_xwayland_surface *dest = xwm->drag_focus;
 	assert(dest != NULL);
 
+	if (xwm->dnd_enter.pending) {
+		// XdndEnter was never sent
+		xwm->dnd_enter.pending = false;
+		return;
+	}
+
 	xcb_client_message_data_t data = { 0 };
 	data.data32[0] = xwm->dnd_window;
 
@@ -308,6 +334,7 @@ static void seat_handle_drag_destroy(struct wl_listener *listener, void *data) {
 	wl_list_remove(&xwm->seat_drag_drop.link);
 	wl_list_remove(&xwm->seat_drag_destroy.link);
 	xwm->drag = NULL;
+	xwm->dnd_enter.pending = false;
 }
 
 static void seat_handle_drag_source_destroy(struct wl_listener *listener,
@@ -317,6 +344,7 @@ static void seat_handle_drag_source_destroy(struct wl_listener *listener,
 
 	wl_list_remove(&xwm->seat_drag_source_destroy.link);
 	xwm->drag_focus = NULL;
+	xwm->dnd_enter.pending = false;
 }
 
 void xwm_seat_handle_start_drag(struct wlr_xwm *xwm, struct wlr_drag *drag) {
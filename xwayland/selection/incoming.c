@@ -11,12 +11,43 @@
 #include "xwayland/xwm.h"
 #include "xwayland/selection.h"
 
+static void handle_incr_chunk_reply(struct wlr_xwm *xwm, void *reply,
+	xcb_generic_error_t *error, void *data);
+
+/**
+ * Requests the next chunk of an INCR transfer, once the owner has set it and
+ * the previous chunk has been written to the Wayland client. The property is
+ * deleted as it's read, so that the owner prepares the following chunk while
+ * this one is being written. At most one chunk is held by the XWM.
+ */
+static void xwm_request_incr_chunk(
+		struct wlr_xwm_selection_transfer *transfer) {
+	struct wlr_xwm *xwm = transfer->selection->xwm;
+	if (!transfer->incr_chunk_ready || transfer->incr_chunk_requested ||
+			transfer->property_reply != NULL) {
+		return;
+	}
+	transfer->incr_chunk_ready = false;
+	transfer->incr_chunk_requested = true;
+
+	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn,
+		1, // delete
+		transfer->selection->window,
+		xwm->atoms[WL_SELECTION],
+		XCB_GET_PROPERTY_TYPE_ANY,
+		0, // offset
+		0x1fffffff // length
+		);
+	xwm_queue_reply(xwm, cookie.sequence, XCB_WINDOW_NONE,
+		handle_incr_chunk_reply, transfer);
+	xcb_flush(xwm->xcb_conn);
+}
+
 /**
  * Write the X11 selection to a Wayland client.
  */
 static int xwm_data_source_write(int fd, uint32_t mask, void *data) {
 	struct wlr_xwm_selection_transfer *transfer = data;
-	struct wlr_xwm *xwm = transfer->selection->xwm;
 
 	char *property = xcb_get_property_value(transfer->property_reply);
 	int remainder = xcb_get_property_value_length(transfer->property_reply) -
@@ -31,20 +62,13 @@ static int xwm_data_source_write(int fd, uint32_t mask, void *data) {
 		return 1;
 	}
 
-	wlr_log(L_DEBUG, "wrote %zd (chunk size %zd) of %d bytes",
-		transfer->property_start + len,
-		len, xcb_get_property_value_length(transfer->property_reply));
-
 	transfer->property_start += len;
 	if (len == remainder) {
 		xwm_selection_transfer_destroy_property_reply(transfer);
 		xwm_selection_transfer_remove_source(transfer);
 
 		if (transfer->incr) {
-			wlr_log(L_DEBUG, "deleting property");
-			xcb_delete_property(xwm->xcb_conn, transfer->selection->window,
-				xwm->atoms[WL_SELECTION]);
-			xcb_flush(xwm->xcb_conn);
+			xwm_request_incr_chunk(transfer);
 		} else {
 			wlr_log(L_DEBUG, "transfer complete");
 			xwm_selection_transfer_close_source_fd(transfer);
@@ -72,69 +96,71 @@ static void xwm_write_property(struct wlr_xwm_selection_transfer *transfer,
 	}
 }
 
-void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
-	struct wlr_xwm *xwm = transfer->selection->xwm;
-	wlr_log(L_DEBUG, "xwm_get_incr_chunk");
-
-	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn,
-		0, // delete
-		transfer->selection->window,
-		xwm->atoms[WL_SELECTION],
-		XCB_GET_PROPERTY_TYPE_ANY,
-		0, // offset
-		0x1fffffff // length
-		);
-
-	xcb_get_property_reply_t *reply =
-		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
-	if (reply == NULL) {
+static void handle_incr_chunk_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	struct wlr_xwm_selection_transfer *transfer = data;
+	xcb_get_property_reply_t *property_reply = reply;
+	free(error);
+	transfer->incr_chunk_requested = false;
+	if (property_reply == NULL) {
 		wlr_log(L_ERROR, "cannot get selection property");
 		return;
 	}
-	//dump_property(xwm, xwm->atoms[WL_SELECTION], reply);
+	//dump_property(xwm, xwm->atoms[WL_SELECTION], property_reply);
 
-	if (xcb_get_property_value_length(reply) > 0) {
+	if (xcb_get_property_value_length(property_reply) > 0) {
 		/* Reply's ownership is transferred to xwm, which is responsible
 		 * for freeing it */
-		xwm_write_property(transfer, reply);
+		xwm_write_property(transfer, property_reply);
 	} else {
 		wlr_log(L_DEBUG, "transfer complete");
 		xwm_selection_transfer_close_source_fd(transfer);
-		free(reply);
+		free(property_reply);
 	}
 }
 
-static void xwm_selection_get_data(struct wlr_xwm_selection *selection) {
-	struct wlr_xwm *xwm = selection->xwm;
-
-	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn,
-		1, // delete
-		selection->window,
-		xwm->atoms[WL_SELECTION],
-		XCB_GET_PROPERTY_TYPE_ANY,
-		0, // offset
-		0x1fffffff // length
-		);
+void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
+	transfer->incr_chunk_ready = true;
+	xwm_request_incr_chunk(transfer);
+}
 
-	xcb_get_property_reply_t *reply =
-		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
-	if (reply == NULL) {
+static void handle_selection_data_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	struct wlr_xwm_selection *selection = data;
+	xcb_get_property_reply_t *property_reply = reply;
+	free(error);
+	if (property_reply == NULL) {
 		wlr_log(L_ERROR, "Cannot get selection property");
 		return;
 	}
 
 	struct wlr_xwm_selection_transfer *transfer = &selection->incoming;
-	if (reply->type == xwm->atoms[INCR]) {
+	if (property_reply->type == xwm->atoms[INCR]) {
 		transfer->incr = true;
-		free(reply);
+		free(property_reply);
 	} else {
 		transfer->incr = false;
 		// reply's ownership is transferred to wm, which is responsible
 		// for freeing it
-		xwm_write_property(transfer, reply);
+		xwm_write_property(transfer, property_reply);
 	}
 }
 
+static void xwm_selection_get_data(struct wlr_xwm_selection *selection) {
+	struct wlr_xwm *xwm = selection->xwm;
+
+	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn,
+		1, // delete
+		selection->window,
+		xwm->atoms[WL_SELECTION],
+		XCB_GET_PROPERTY_TYPE_ANY,
+		0, // offset
+		0x1fffffff // length
+		);
+	xwm_queue_reply(xwm, cookie.sequence, XCB_WINDOW_NONE,
+		handle_selection_data_reply, selection);
+}
+
 static void source_send(struct wlr_xwm_selection *selection,
 		struct wl_array *mime_types, struct wl_array *mime_types_atoms,
 		const char *requested_mime_type, int32_t fd) {
@@ -172,6 +198,7 @@ static void source_send(struct wlr_xwm_selection *selection,
 
 	fcntl(fd, F_SETFL, O_WRONLY | O_NONBLOCK);
 	transfer->source_fd = fd;
+	transfer->incr_chunk_ready = false;
 }
 
 struct x11_data_source {
@@ -250,91 +277,73 @@ static void primary_selection_source_cancel(
 	free(source);
 }
 
-static bool source_get_targets(struct wlr_xwm_selection *selection,
-		struct wl_array *mime_types, struct wl_array *mime_types_atoms) {
-	struct wlr_xwm *xwm = selection->xwm;
-
-	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn,
-		1, // delete
-		selection->window,
-		xwm->atoms[WL_SELECTION],
-		XCB_GET_PROPERTY_TYPE_ANY,
-		0, // offset
-		4096 // length
-		);
+struct x11_selection_target {
+	xcb_atom_t atom;
+	bool needs_name;
+	char *mime_type; // NULL if the target isn't a MIME type
+};
 
-	xcb_get_property_reply_t *reply =
-		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
-	if (reply == NULL) {
-		return false;
-	}
+/**
+ * The targets offered by an X11 selection owner. The targets which aren't
+ * well-known MIME types are named after their atom, these names are fetched
+ * asynchronously and received in request order.
+ */
+struct x11_selection_targets {
+	struct wlr_xwm_selection *selection;
+	size_t pending, next;
+	bool failed;
+	size_t len;
+	struct x11_selection_target targets[];
+};
 
-	if (reply->type != XCB_ATOM_ATOM) {
-		free(reply);
-		return false;
+static void selection_targets_destroy(struct x11_selection_targets *targets) {
+	for (size_t i = 0; i < targets->len; ++i) {
+		free(targets->targets[i].mime_type);
 	}
+	free(targets);
+}
 
-	xcb_atom_t *value = xcb_get_property_value(reply);
-	for (uint32_t i = 0; i < reply->value_len; i++) {
-		char *mime_type = NULL;
-
-		if (value[i] == xwm->atoms[UTF8_STRING]) {
-			mime_type = strdup("text/plain;charset=utf-8");
-		} else if (value[i] == xwm->atoms[TEXT]) {
-			mime_type = strdup("text/plain");
-		} else if (value[i] != xwm->atoms[TARGETS] &&
-				value[i] != xwm->atoms[TIMESTAMP]) {
-			xcb_get_atom_name_cookie_t name_cookie =
-				xcb_get_atom_name(xwm->xcb_conn, value[i]);
-			xcb_get_atom_name_reply_t *name_reply =
-				xcb_get_atom_name_reply(xwm->xcb_conn, name_cookie, NULL);
-			if (name_reply == NULL) {
-				continue;
-			}
-			size_t len = xcb_get_atom_name_name_length(name_reply);
-			char *name = xcb_get_atom_name_name(name_reply); // not a C string
-			if (memchr(name, '/', len) != NULL) {
-				mime_type = malloc((len + 1) * sizeof(char));
-				if (mime_type == NULL) {
-					free(name_reply);
-					continue;
-				}
-				memcpy(mime_type, name, len);
-				mime_type[len] = '\0';
-			}
-			free(name_reply);
+static bool source_add_targets(struct x11_selection_targets *targets,
+		struct wl_array *mime_types, struct wl_array *mime_types_atoms) {
+	for (size_t i = 0; i < targets->len; ++i) {
+		struct x11_selection_target *target = &targets->targets[i];
+		if (target->mime_type == NULL) {
+			continue;
 		}
 
-		if (mime_type != NULL) {
-			char **mime_type_ptr =
-				wl_array_add(mime_types, sizeof(*mime_type_ptr));
-			if (mime_type_ptr == NULL) {
-				free(mime_type);
-				break;
-			}
-			*mime_type_ptr = mime_type;
+		char **mime_type_ptr =
+			wl_array_add(mime_types, sizeof(*mime_type_ptr));
+		if (mime_type_ptr == NULL) {
+			return false;
+		}
+		*mime_type_ptr = target->mime_type;
+		target->mime_type = NULL;
 
-			xcb_atom_t *atom_ptr =
-				wl_array_add(mime_types_atoms, sizeof(*atom_ptr));
-			if (atom_ptr == NULL) {
-				break;
-			}
-			*atom_ptr = value[i];
+		xcb_atom_t *atom_ptr =
+			wl_array_add(mime_types_atoms, sizeof(*atom_ptr));
+		if (atom_ptr == NULL) {
+			return false;
 		}
+		*atom_ptr = target->atom;
 	}
-
-	free(reply);
 	return true;
 }
 
-static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
+static void xwm_selection_set_targets(struct x11_selection_targets *targets) {
 	// set the wayland selection to the X11 selection
+	struct wlr_xwm_selection *selection = targets->selection;
 	struct wlr_xwm *xwm = selection->xwm;
 
+	if (targets->failed) {
+		selection_targets_destroy(targets);
+		return;
+	}
+
 	if (selection == &xwm->clipboard_selection) {
 		struct x11_data_source *source =
 			calloc(1, sizeof(struct x11_data_source));
 		if (source == NULL) {
+			selection_targets_destroy(targets);
 			return;
 		}
 		wlr_data_source_init(&source->base, &data_source_impl);
@@ -342,7 +351,7 @@ static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
 		source->selection = selection;
 		wl_array_init(&source->mime_types_atoms);
 
-		bool ok = source_get_targets(selection, &source->base.mime_types,
+		bool ok = source_add_targets(targets, &source->base.mime_types,
 			&source->mime_types_atoms);
 		if (ok) {
 			wlr_seat_set_selection(xwm->seat, &source->base,
@@ -354,6 +363,7 @@ static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
 		struct x11_primary_selection_source *source =
 			calloc(1, sizeof(struct x11_primary_selection_source));
 		if (source == NULL) {
+			selection_targets_destroy(targets);
 			return;
 		}
 		wlr_primary_selection_source_init(&source->base);
@@ -363,7 +373,7 @@ static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
 		source->selection = selection;
 		wl_array_init(&source->mime_types_atoms);
 
-		bool ok = source_get_targets(selection, &source->base.mime_types,
+		bool ok = source_add_targets(targets, &source->base.mime_types,
 			&source->mime_types_atoms);
 		if (ok) {
 			wlr_seat_set_primary_selection(xwm->seat, &source->base,
@@ -374,6 +384,107 @@ static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
 	} else if (selection == &xwm->dnd_selection) {
 		// TODO
 	}
+
+	selection_targets_destroy(targets);
+}
+
+static void handle_target_name_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	struct x11_selection_targets *targets = data;
+	xcb_get_atom_name_reply_t *name_reply = reply;
+
+	// Find the next target waiting for its name
+	while (!targets->targets[targets->next].needs_name) {
+		targets->next++;
+	}
+	struct x11_selection_target *target = &targets->targets[targets->next];
+	targets->next++;
+
+	if (name_reply != NULL) {
+		size_t len = xcb_get_atom_name_name_length(name_reply);
+		char *name = xcb_get_atom_name_name(name_reply); // not a C string
+		if (memchr(name, '/', len) != NULL) {
+			target->mime_type = strndup(name, len);
+		}
+	} else if (error == NULL) {
+		// The request has been discarded
+		targets->failed = true;
+	}
+
+	free(name_reply);
+	free(error);
+
+	if (--targets->pending == 0) {
+		xwm_selection_set_targets(targets);
+	}
+}
+
+static void handle_targets_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	struct wlr_xwm_selection *selection = data;
+	xcb_get_property_reply_t *property_reply = reply;
+	free(error);
+	if (property_reply == NULL) {
+		return;
+	}
+	if (property_reply->type != XCB_ATOM_ATOM) {
+		free(property_reply);
+		return;
+	}
+
+	xcb_atom_t *value = xcb_get_property_value(property_reply);
+	size_t len = property_reply->value_len;
+	struct x11_selection_targets *targets = calloc(1,
+		sizeof(struct x11_selection_targets) +
+		len * sizeof(struct x11_selection_target));
+	if (targets == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		free(property_reply);
+		return;
+	}
+	targets->selection = selection;
+	targets->len = len;
+	// Held until all requests have been sent, so that a handler called right
+	// away can't complete the targets
+	targets->pending = 1;
+
+	for (size_t i = 0; i < len; i++) {
+		struct x11_selection_target *target = &targets->targets[i];
+		target->atom = value[i];
+
+		const char *mime_type = xwm_mime_type_from_known_atom(xwm, value[i]);
+		if (mime_type != NULL) {
+			target->mime_type = strdup(mime_type);
+		} else if (value[i] != xwm->atoms[TARGETS] &&
+				value[i] != xwm->atoms[TIMESTAMP]) {
+			target->needs_name = true;
+			targets->pending++;
+			xcb_get_atom_name_cookie_t name_cookie =
+				xcb_get_atom_name(xwm->xcb_conn, value[i]);
+			xwm_queue_reply(xwm, name_cookie.sequence, XCB_WINDOW_NONE,
+				handle_target_name_reply, targets);
+		}
+	}
+	free(property_reply);
+
+	if (--targets->pending == 0) {
+		xwm_selection_set_targets(targets);
+	}
+}
+
+static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
+	struct wlr_xwm *xwm = selection->xwm;
+
+	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn,
+		1, // delete
+		selection->window,
+		xwm->atoms[WL_SELECTION],
+		XCB_GET_PROPERTY_TYPE_ANY,
+		0, // offset
+		4096 // length
+		);
+	xwm_queue_reply(xwm, cookie.sequence, XCB_WINDOW_NONE,
+		handle_targets_reply, selection);
 }
 
 void xwm_handle_selection_notify(struct wlr_xwm *xwm,
@@ -1,6 +1,7 @@
 #define _XOPEN_SOURCE 700
 #include <assert.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -8,6 +9,7 @@
 #include <wlr/types/wlr_primary_selection.h>
 #include <wlr/util/log.h>
 #include <xcb/xfixes.h>
+#include "util/time.h"
 #include "xwayland/xwm.h"
 #include "xwayland/selection.h"
 
@@ -49,9 +51,28 @@ static int xwm_selection_flush_source_data(
 	transfer->property_set = true;
 	size_t length = transfer->source_data.size;
 	transfer->source_data.size = 0;
+	transfer->sent += length;
+
+	// Large transfers need fewer round-trips with larger chunks
+	if (transfer->incr) {
+		size_t max = transfer->selection->xwm->incr_chunk_size_max;
+		transfer->chunk_size =
+			transfer->chunk_size < max / 2 ? 2 * transfer->chunk_size : max;
+	}
 	return length;
 }
 
+static void xwm_selection_transfer_log_complete(
+		struct wlr_xwm_selection_transfer *transfer) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double elapsed =
+		(timespec_to_nsec(&now) - transfer->start_nsec) / 1000000000.0;
+	wlr_log(L_DEBUG, "Sent %zu bytes to X11 window %u in %.3f s (%.1f MiB/s)",
+		transfer->sent, transfer->request.requestor, elapsed,
+		elapsed > 0 ? transfer->sent / elapsed / (1024 * 1024) : 0.0);
+}
+
 static void xwm_selection_transfer_start_outgoing(
 		struct wlr_xwm_selection_transfer *transfer);
 
@@ -69,7 +90,7 @@ static void xwm_selection_transfer_destroy_outgoing(
 
 	xwm_selection_transfer_remove_source(transfer);
 	xwm_selection_transfer_close_source_fd(transfer);
-	wl_array_release(&transfer->source_data);
+	xwm_selection_buffer_put(transfer->selection->xwm, &transfer->source_data);
 	free(transfer);
 }
 
@@ -77,35 +98,31 @@ static int xwm_data_source_read(int fd, uint32_t mask, void *data) {
 	struct wlr_xwm_selection_transfer *transfer = data;
 	struct wlr_xwm *xwm = transfer->selection->xwm;
 
-	void *p;
+	// Never read past the current chunk, the buffer is only reallocated
+	// when the chunk size grows
 	size_t current = transfer->source_data.size;
-	if (transfer->source_data.size < INCR_CHUNK_SIZE) {
-		p = wl_array_add(&transfer->source_data, INCR_CHUNK_SIZE);
-		if (p == NULL) {
-			wlr_log(L_ERROR, "Could not allocate selection source_data");
-			goto error_out;
-		}
-	} else {
-		p = (char *)transfer->source_data.data + transfer->source_data.size;
+	assert(current < transfer->chunk_size);
+	size_t available = transfer->chunk_size - current;
+	if (wl_array_add(&transfer->source_data, available) == NULL) {
+		wlr_log(L_ERROR, "Could not allocate selection source_data");
+		goto error_out;
 	}
+	char *p = (char *)transfer->source_data.data + current;
 
-	size_t available = transfer->source_data.alloc - current;
 	ssize_t len = read(fd, p, available);
 	if (len == -1) {
+		transfer->source_data.size = current;
 		wlr_log(L_ERROR, "read error from data source: %m");
 		goto error_out;
 	}
 
-	wlr_log(L_DEBUG, "read %zd bytes (available %zu, mask 0x%x)", len,
-		available, mask);
-
 	transfer->source_data.size = current + len;
-	if (transfer->source_data.size >= INCR_CHUNK_SIZE) {
+	if (transfer->source_data.size >= transfer->chunk_size) {
 		if (!transfer->incr) {
 			wlr_log(L_DEBUG, "got %zu bytes, starting incr",
 				transfer->source_data.size);
 
-			size_t incr_chunk_size = INCR_CHUNK_SIZE;
+			uint32_t incr_chunk_size = transfer->chunk_size;
 			xcb_change_property(xwm->xcb_conn,
 				XCB_PROP_MODE_REPLACE,
 				transfer->request.requestor,
@@ -119,37 +136,26 @@ static int xwm_data_source_read(int fd, uint32_t mask, void *data) {
 			xwm_selection_transfer_remove_source(transfer);
 			xwm_selection_send_notify(xwm, &transfer->request, true);
 		} else if (transfer->property_set) {
-			wlr_log(L_DEBUG, "got %zu bytes, waiting for property delete",
-				transfer->source_data.size);
-
+			// Wait for the requestor to delete the property
 			transfer->flush_property_on_delete = true;
 			xwm_selection_transfer_remove_source(transfer);
 		} else {
-			wlr_log(L_DEBUG, "got %zu bytes, property deleted, setting new "
-				"property", transfer->source_data.size);
 			xwm_selection_flush_source_data(transfer);
 		}
 	} else if (len == 0 && !transfer->incr) {
-		wlr_log(L_DEBUG, "non-incr transfer complete");
 		xwm_selection_flush_source_data(transfer);
 		xwm_selection_send_notify(xwm, &transfer->request, true);
+		xwm_selection_transfer_log_complete(transfer);
 		xwm_selection_transfer_destroy_outgoing(transfer);
 	} else if (len == 0 && transfer->incr) {
-		wlr_log(L_DEBUG, "incr transfer complete");
+		wlr_log(L_DEBUG, "incr transfer read complete");
 
 		transfer->flush_property_on_delete = true;
-		if (transfer->property_set) {
-			wlr_log(L_DEBUG, "got %zu bytes, waiting for property delete",
-				transfer->source_data.size);
-		} else {
-			wlr_log(L_DEBUG, "got %zu bytes, property deleted, setting new "
-				"property", transfer->source_data.size);
+		if (!transfer->property_set) {
 			xwm_selection_flush_source_data(transfer);
 		}
 		xwm_selection_transfer_remove_source(transfer);
 		xwm_selection_transfer_close_source_fd(transfer);
-	} else {
-		wlr_log(L_DEBUG, "nothing happened, buffered the bytes");
 	}
 
 	return 1;
@@ -161,12 +167,8 @@ error_out:
 }
 
 void xwm_send_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
-	wlr_log(L_DEBUG, "property deleted");
-
 	transfer->property_set = false;
 	if (transfer->flush_property_on_delete) {
-		wlr_log(L_DEBUG, "setting new property, %zu bytes",
-			transfer->source_data.size);
 		transfer->flush_property_on_delete = false;
 		int length = xwm_selection_flush_source_data(transfer);
 
@@ -178,9 +180,10 @@ void xwm_send_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
 			 * the 0 sized property to signal the end of
 			 * the transfer. */
 			transfer->flush_property_on_delete = true;
-			wl_array_release(&transfer->source_data);
-			wl_array_init(&transfer->source_data);
+			xwm_selection_buffer_put(transfer->selection->xwm,
+				&transfer->source_data);
 		} else {
+			xwm_selection_transfer_log_complete(transfer);
 			xwm_selection_transfer_destroy_outgoing(transfer);
 		}
 	}
@@ -285,7 +288,14 @@ static void xwm_selection_send_data(struct wlr_xwm_selection *selection,
 	}
 	transfer->selection = selection;
 	transfer->request = *req;
-	wl_array_init(&transfer->source_data);
+	transfer->chunk_size = INCR_CHUNK_SIZE;
+	if (transfer->chunk_size > selection->xwm->incr_chunk_size_max) {
+		transfer->chunk_size = selection->xwm->incr_chunk_size_max;
+	}
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	transfer->start_nsec = timespec_to_nsec(&now);
+	xwm_selection_buffer_get(selection->xwm, &transfer->source_data);
 
 	int p[2];
 	if (pipe(p) == -1) {
@@ -312,6 +322,66 @@ static void xwm_selection_send_data(struct wlr_xwm_selection *selection,
 	}
 }
 
+/**
+ * The atoms of the Wayland MIME types which need to be interned are received
+ * asynchronously, in request order.
+ */
+struct xwm_targets_request {
+	struct wlr_xwm_selection *selection;
+	xcb_selection_request_event_t request;
+	size_t len, next;
+	size_t pending;
+	bool failed;
+	xcb_atom_t targets[];
+};
+
+static void xwm_selection_finish_send_targets(
+		struct xwm_targets_request *targets_req) {
+	struct wlr_xwm *xwm = targets_req->selection->xwm;
+
+	if (targets_req->failed) {
+		xwm_selection_send_notify(xwm, &targets_req->request, false);
+		free(targets_req);
+		return;
+	}
+
+	xcb_change_property(xwm->xcb_conn,
+		XCB_PROP_MODE_REPLACE,
+		targets_req->request.requestor,
+		targets_req->request.property,
+		XCB_ATOM_ATOM,
+		32, // format
+		targets_req->len, targets_req->targets);
+
+	xwm_selection_send_notify(xwm, &targets_req->request, true);
+	free(targets_req);
+}
+
+static void handle_target_atom_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	struct xwm_targets_request *targets_req = data;
+	xcb_intern_atom_reply_t *atom_reply = reply;
+
+	// Find the next target waiting for its atom
+	while (targets_req->targets[targets_req->next] != XCB_ATOM_NONE) {
+		targets_req->next++;
+	}
+	if (atom_reply != NULL) {
+		targets_req->targets[targets_req->next] = atom_reply->atom;
+	} else if (error == NULL) {
+		// The request has been discarded
+		targets_req->failed = true;
+	}
+	targets_req->next++;
+
+	free(atom_reply);
+	free(error);
+
+	if (--targets_req->pending == 0) {
+		xwm_selection_finish_send_targets(targets_req);
+	}
+}
+
 static void xwm_selection_send_targets(struct wlr_xwm_selection *selection,
 		xcb_selection_request_event_t *req) {
 	struct wlr_xwm *xwm = selection->xwm;
@@ -326,27 +396,41 @@ static void xwm_selection_send_targets(struct wlr_xwm_selection *selection,
 	}
 
 	size_t n = 2 + mime_types->size / sizeof(char *);
-	xcb_atom_t targets[n];
-	targets[0] = xwm->atoms[TIMESTAMP];
-	targets[1] = xwm->atoms[TARGETS];
+	struct xwm_targets_request *targets_req =
+		calloc(1, sizeof(struct xwm_targets_request) + n * sizeof(xcb_atom_t));
+	if (targets_req == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		xwm_selection_send_notify(selection->xwm, req, false);
+		return;
+	}
+	targets_req->selection = selection;
+	targets_req->request = *req;
+	targets_req->len = n;
+	targets_req->targets[0] = xwm->atoms[TIMESTAMP];
+	targets_req->targets[1] = xwm->atoms[TARGETS];
+
+	// Held until all requests have been sent, so that a handler called right
+	// away can't complete the request
+	targets_req->pending = 1;
 
-	size_t i = 0;
+	size_t i = 2;
 	char **mime_type_ptr;
 	wl_array_for_each(mime_type_ptr, mime_types) {
 		char *mime_type = *mime_type_ptr;
-		targets[2+i] = xwm_mime_type_to_atom(xwm, mime_type);
+		targets_req->targets[i] = xwm_mime_type_to_known_atom(xwm, mime_type);
+		if (targets_req->targets[i] == XCB_ATOM_NONE) {
+			targets_req->pending++;
+			xcb_intern_atom_cookie_t cookie = xcb_intern_atom(xwm->xcb_conn,
+				0, strlen(mime_type), mime_type);
+			xwm_queue_reply(xwm, cookie.sequence, XCB_WINDOW_NONE,
+				handle_target_atom_reply, targets_req);
+		}
 		++i;
 	}
 
-	xcb_change_property(xwm->xcb_conn,
-		XCB_PROP_MODE_REPLACE,
-		req->requestor,
-		req->property,
-		XCB_ATOM_ATOM,
-		32, // format
-		n, targets);
-
-	xwm_selection_send_notify(selection->xwm, req, true);
+	if (--targets_req->pending == 0) {
+		xwm_selection_finish_send_targets(targets_req);
+	}
 }
 
 static void xwm_selection_send_timestamp(struct wlr_xwm_selection *selection,
@@ -362,6 +446,36 @@ static void xwm_selection_send_timestamp(struct wlr_xwm_selection *selection,
 	xwm_selection_send_notify(selection->xwm, req, true);
 }
 
+struct xwm_data_request {
+	struct wlr_xwm_selection *selection;
+	xcb_selection_request_event_t request;
+};
+
+static void handle_data_target_name_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	struct xwm_data_request *data_req = data;
+	xcb_get_atom_name_reply_t *name_reply = reply;
+
+	char *mime_type = NULL;
+	if (name_reply != NULL) {
+		mime_type = strndup(xcb_get_atom_name_name(name_reply),
+			xcb_get_atom_name_name_length(name_reply));
+	}
+	if (mime_type != NULL) {
+		xwm_selection_send_data(data_req->selection, &data_req->request,
+			mime_type);
+	} else {
+		wlr_log(L_ERROR, "ignoring selection request: unknown atom %u",
+			data_req->request.target);
+		xwm_selection_send_notify(xwm, &data_req->request, false);
+	}
+
+	free(mime_type);
+	free(name_reply);
+	free(error);
+	free(data_req);
+}
+
 void xwm_handle_selection_request(struct wlr_xwm *xwm,
 		xcb_selection_request_event_t *req) {
 	wlr_log(L_DEBUG, "XCB_SELECTION_REQUEST (time=%u owner=%u, requestor=%u "
@@ -391,10 +505,10 @@ void xwm_handle_selection_request(struct wlr_xwm *xwm,
 
 	// No xwayland surface focused, deny access to clipboard
 	if (xwm->focus_surface == NULL && xwm->drag_focus == NULL) {
-		char *selection_name = xwm_get_atom_name(xwm, selection->atom);
-		wlr_log(L_DEBUG, "denying read access to selection %u (%s): "
-			"no xwayland surface focused", selection->atom, selection_name);
-		free(selection_name);
+		char message[64];
+		snprintf(message, sizeof(message), "denying read access to "
+			"selection %u: no xwayland surface focused", selection->atom);
+		xwm_log_atom_name(xwm, message, selection->atom);
 		xwm_selection_send_notify(xwm, req, false);
 		return;
 	}
@@ -407,14 +521,25 @@ void xwm_handle_selection_request(struct wlr_xwm *xwm,
 		xwm_selection_send_notify(selection->xwm, req, true);
 	} else {
 		// Send data
-		char *mime_type = xwm_mime_type_from_atom(xwm, req->target);
-		if (mime_type == NULL) {
-			wlr_log(L_ERROR, "ignoring selection request: unknown atom %u",
-				req->target);
+		const char *mime_type = xwm_mime_type_from_known_atom(xwm, req->target);
+		if (mime_type != NULL) {
+			xwm_selection_send_data(selection, req, mime_type);
+			return;
+		}
+
+		// The MIME type is the name of the target atom
+		struct xwm_data_request *data_req =
+			calloc(1, sizeof(struct xwm_data_request));
+		if (data_req == NULL) {
+			wlr_log(L_ERROR, "Allocation failed");
 			xwm_selection_send_notify(xwm, req, false);
 			return;
 		}
-		xwm_selection_send_data(selection, req, mime_type);
-		free(mime_type);
+		data_req->selection = selection;
+		data_req->request = *req;
+		xcb_get_atom_name_cookie_t cookie =
+			xcb_get_atom_name(xwm->xcb_conn, req->target);
+		xwm_queue_reply(xwm, cookie.sequence, XCB_WINDOW_NONE,
+			handle_data_target_name_reply, data_req);
 	}
 }
@@ -33,35 +33,115 @@ void xwm_selection_transfer_destroy_property_reply(
 	transfer->property_reply = NULL;
 }
 
-xcb_atom_t xwm_mime_type_to_atom(struct wlr_xwm *xwm, char *mime_type) {
+xcb_atom_t xwm_mime_type_to_known_atom(struct wlr_xwm *xwm,
+		const char *mime_type) {
 	if (strcmp(mime_type, "text/plain;charset=utf-8") == 0) {
 		return xwm->atoms[UTF8_STRING];
 	} else if (strcmp(mime_type, "text/plain") == 0) {
 		return xwm->atoms[TEXT];
 	}
-
-	xcb_intern_atom_cookie_t cookie =
-		xcb_intern_atom(xwm->xcb_conn, 0, strlen(mime_type), mime_type);
-	xcb_intern_atom_reply_t *reply =
-		xcb_intern_atom_reply(xwm->xcb_conn, cookie, NULL);
-	if (reply == NULL) {
-		return XCB_ATOM_NONE;
-	}
-	xcb_atom_t atom = reply->atom;
-	free(reply);
-	return atom;
+	return XCB_ATOM_NONE;
 }
 
-char *xwm_mime_type_from_atom(struct wlr_xwm *xwm, xcb_atom_t atom) {
+const char *xwm_mime_type_from_known_atom(struct wlr_xwm *xwm,
+		xcb_atom_t atom) {
 	if (atom == xwm->atoms[UTF8_STRING]) {
-		return strdup("text/plain;charset=utf-8");
+		return "text/plain;charset=utf-8";
 	} else if (atom == xwm->atoms[TEXT]) {
-		return strdup("text/plain");
-	} else {
-		return xwm_get_atom_name(xwm, atom);
+		return "text/plain";
+	}
+	return NULL;
+}
+
+struct xwm_atoms_request {
+	xwm_atoms_handler_t handler;
+	void *data;
+	bool failed;
+	size_t remaining; // replies not received yet
+	size_t next; // atoms before this one are known
+	size_t n;
+	xcb_atom_t atoms[];
+};
+
+static void atoms_request_finish(struct wlr_xwm *xwm,
+		struct xwm_atoms_request *req) {
+	req->handler(xwm, req->failed ? NULL : req->atoms, req->n, req->data);
+	free(req);
+}
+
+static void handle_mime_type_atom_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	struct xwm_atoms_request *req = data;
+	xcb_intern_atom_reply_t *intern_reply = reply;
+
+	// Replies come in request order, which is the order of the atoms that
+	// aren't predefined
+	while (req->atoms[req->next] != XCB_ATOM_NONE) {
+		req->next++;
+	}
+	if (intern_reply != NULL) {
+		req->atoms[req->next] = intern_reply->atom;
+	} else if (error == NULL) {
+		// Discarded
+		req->failed = true;
+	}
+	req->next++;
+	free(intern_reply);
+	free(error);
+
+	if (--req->remaining == 0) {
+		atoms_request_finish(xwm, req);
 	}
 }
 
+void xwm_mime_types_to_atoms(struct wlr_xwm *xwm, struct wl_array *mime_types,
+		xwm_atoms_handler_t handler, void *data) {
+	size_t n = mime_types->size / sizeof(char *);
+	struct xwm_atoms_request *req =
+		calloc(1, sizeof(struct xwm_atoms_request) + n * sizeof(xcb_atom_t));
+	if (req == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		handler(xwm, NULL, n, data);
+		return;
+	}
+	req->handler = handler;
+	req->data = data;
+	req->n = n;
+
+	size_t i = 0;
+	char **mime_type_ptr;
+	wl_array_for_each(mime_type_ptr, mime_types) {
+		req->atoms[i] = xwm_mime_type_to_known_atom(xwm, *mime_type_ptr);
+		if (req->atoms[i] == XCB_ATOM_NONE) {
+			req->remaining++;
+		}
+		++i;
+	}
+	if (req->remaining == 0) {
+		atoms_request_finish(xwm, req);
+		return;
+	}
+
+	// Queue all requests first, the handler may be called right away if one
+	// fails
+	size_t remaining = req->remaining;
+	wl_array_for_each(mime_type_ptr, mime_types) {
+		const char *mime_type = *mime_type_ptr;
+		if (xwm_mime_type_to_known_atom(xwm, mime_type) != XCB_ATOM_NONE) {
+			continue;
+		}
+		xcb_intern_atom_cookie_t cookie = xcb_intern_atom(xwm->xcb_conn, 0,
+			strlen(mime_type), mime_type);
+		xwm_queue_reply(xwm, cookie.sequence, XCB_WINDOW_NONE,
+			handle_mime_type_atom_reply, req);
+		if (--remaining == 0) {
+			// req may have been freed
+			break;
+		}
+	}
+	xcb_flush(xwm->xcb_conn);
+}
+
 struct wlr_xwm_selection *xwm_get_selection(struct wlr_xwm *xwm,
 		xcb_atom_t selection_atom) {
 	if (selection_atom == xwm->atoms[CLIPBOARD]) {
@@ -75,6 +155,41 @@ struct wlr_xwm_selection *xwm_get_selection(struct wlr_xwm *xwm,
 	}
 }
 
+void xwm_selection_buffer_get(struct wlr_xwm *xwm, struct wl_array *buffer) {
+	struct wlr_xwm_selection_buffer_pool *pool = &xwm->selection_buffers;
+	if (pool->len == 0) {
+		wl_array_init(buffer);
+		return;
+	}
+	*buffer = pool->buffers[--pool->len];
+	buffer->size = 0;
+}
+
+void xwm_selection_buffer_put(struct wlr_xwm *xwm, struct wl_array *buffer) {
+	struct wlr_xwm_selection_buffer_pool *pool = &xwm->selection_buffers;
+	if (buffer->alloc == 0 || pool->len == SELECTION_BUFFER_POOL_SIZE) {
+		wl_array_release(buffer);
+		wl_array_init(buffer);
+		return;
+	}
+
+	if (buffer->alloc > INCR_CHUNK_SIZE) {
+		// Don't hold on to the memory of large transfers, the next one starts
+		// with a small chunk anyway
+		void *data = realloc(buffer->data, INCR_CHUNK_SIZE);
+		if (data == NULL) {
+			wl_array_release(buffer);
+			wl_array_init(buffer);
+			return;
+		}
+		buffer->data = data;
+		buffer->alloc = INCR_CHUNK_SIZE;
+	}
+
+	pool->buffers[pool->len++] = *buffer;
+	wl_array_init(buffer);
+}
+
 static int xwm_handle_selection_property_notify(struct wlr_xwm *xwm,
 		xcb_property_notify_event_t *event) {
 	struct wlr_xwm_selection *selections[] = {
@@ -159,6 +274,18 @@ static void selection_init(struct wlr_xwm *xwm,
 }
 
 void xwm_selection_init(struct wlr_xwm *xwm) {
+	// The length is in 4-byte units and includes the ChangeProperty header
+	size_t max_request_size =
+		4 * (size_t)xcb_get_maximum_request_length(xwm->xcb_conn);
+	size_t header_size = sizeof(xcb_change_property_request_t);
+	xwm->incr_chunk_size_max = INCR_CHUNK_SIZE_MAX;
+	if (max_request_size > header_size &&
+			max_request_size - header_size < xwm->incr_chunk_size_max) {
+		xwm->incr_chunk_size_max = max_request_size - header_size;
+	}
+	wlr_log(L_DEBUG, "Using INCR chunks of up to %zu bytes",
+		xwm->incr_chunk_size_max);
+
 	// Clipboard and primary selection
 	uint32_t selection_values[] = {
 		XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE
@@ -221,6 +348,10 @@ void xwm_selection_finish(struct wlr_xwm *xwm) {
 	if (xwm->dnd_window) {
 		xcb_destroy_window(xwm->xcb_conn, xwm->dnd_window);
 	}
+	for (size_t i = 0; i < xwm->selection_buffers.len; ++i) {
+		wl_array_release(&xwm->selection_buffers.buffers[i]);
+	}
+	xwm->selection_buffers.len = 0;
 	if (xwm->seat) {
 		if (xwm->seat->selection_source &&
 				data_source_is_xwayland(
@@ -9,7 +9,7 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -20,6 +20,7 @@
 #include <wlr/xwayland.h>
 #include "sockets.h"
 #include "util/signal.h"
+#include "util/time.h"
 #include "xwayland/xwm.h"
 
 #ifdef __FreeBSD__
@@ -39,6 +40,16 @@ struct wlr_xwayland_cursor {
 	int32_t hotspot_y;
 };
 
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+static double elapsed_msec(int64_t since_nsec) {
+	return (get_current_time_nsec() - since_nsec) / 1000000.0;
+}
+
 static void safe_close(int fd) {
 	if (fd >= 0) {
 		close(fd);
@@ -139,6 +150,10 @@ static void xwayland_finish_server(struct wlr_xwayland *wlr_xwayland) {
 
 		wlr_xwayland->x_fd_read_event[0] = wlr_xwayland->x_fd_read_event[1] = NULL;
 	}
+	if (wlr_xwayland->prestart_source) {
+		wl_event_source_remove(wlr_xwayland->prestart_source);
+		wlr_xwayland->prestart_source = NULL;
+	}
 
 	if (wlr_xwayland->cursor != NULL) {
 		free(wlr_xwayland->cursor);
@@ -244,13 +259,16 @@ static int xserver_handle_ready(int signal_number, void *data) {
 		wlr_log(L_ERROR, "Xwayland startup failed, not setting up xwm");
 		return 1;
 	}
-	wlr_log(L_DEBUG, "Xserver is ready");
+	wlr_log(L_DEBUG, "Xserver is ready (started in %.1f ms)",
+		elapsed_msec(wlr_xwayland->start_nsec));
 
+	int64_t xwm_start_nsec = get_current_time_nsec();
 	wlr_xwayland->xwm = xwm_create(wlr_xwayland);
 	if (!wlr_xwayland->xwm) {
 		xwayland_finish_server(wlr_xwayland);
 		return 1;
 	}
+	wlr_log(L_DEBUG, "xwm created in %.1f ms", elapsed_msec(xwm_start_nsec));
 
 	if (wlr_xwayland->seat) {
 		xwm_set_seat(wlr_xwayland->xwm, wlr_xwayland->seat);
@@ -268,6 +286,9 @@ static int xserver_handle_ready(int signal_number, void *data) {
 	}
 
 
+	wlr_log(L_INFO, "Xwayland is ready, %.1f ms after start",
+		elapsed_msec(wlr_xwayland->start_nsec));
+
 	wlr_signal_emit_safe(&wlr_xwayland->events.ready, wlr_xwayland);
 	/* ready is a one-shot signal, fire and forget */
 	wl_signal_init(&wlr_xwayland->events.ready);
@@ -283,11 +304,71 @@ static int xwayland_socket_connected(int fd, uint32_t mask, void* data){
 
 	wlr_xwayland->x_fd_read_event[0] = wlr_xwayland->x_fd_read_event[1] = NULL;
 
+	if (wlr_xwayland->prestart_source) {
+		wl_event_source_remove(wlr_xwayland->prestart_source);
+		wlr_xwayland->prestart_source = NULL;
+	}
+
+	wlr_log(L_DEBUG, "X11 client connected, starting Xwayland");
+	xwayland_start_server(wlr_xwayland);
+
+	return 0;
+}
+
+static int xwayland_handle_prestart_timer(void *data) {
+	struct wlr_xwayland *wlr_xwayland = data;
+
+	wl_event_source_remove(wlr_xwayland->prestart_source);
+	wlr_xwayland->prestart_source = NULL;
+
+	if (wlr_xwayland->x_fd_read_event[0] == NULL) {
+		// Already started
+		return 0;
+	}
+	wl_event_source_remove(wlr_xwayland->x_fd_read_event[0]);
+	wl_event_source_remove(wlr_xwayland->x_fd_read_event[1]);
+	wlr_xwayland->x_fd_read_event[0] = wlr_xwayland->x_fd_read_event[1] = NULL;
+
+	wlr_log(L_DEBUG, "Prestarting Xwayland");
 	xwayland_start_server(wlr_xwayland);
 
 	return 0;
 }
 
+static void xwayland_handle_prestart_idle(void *data) {
+	struct wlr_xwayland *wlr_xwayland = data;
+
+	// Idle sources are destroyed after being dispatched
+	wlr_xwayland->prestart_source = NULL;
+
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(wlr_xwayland->wl_display);
+	wlr_xwayland->prestart_source = wl_event_loop_add_timer(loop,
+		xwayland_handle_prestart_timer, wlr_xwayland);
+	if (wlr_xwayland->prestart_source == NULL) {
+		wlr_log(L_ERROR, "Failed to create Xwayland prestart timer");
+		return;
+	}
+	wl_event_source_timer_update(wlr_xwayland->prestart_source,
+		wlr_xwayland->prestart_delay > 0 ? wlr_xwayland->prestart_delay : 1);
+}
+
+static void xwayland_schedule_prestart(struct wlr_xwayland *wlr_xwayland) {
+	if (!wlr_xwayland->prestart || wlr_xwayland->prestart_source != NULL ||
+			wlr_xwayland->x_fd_read_event[0] == NULL) {
+		return;
+	}
+
+	// Wait for the compositor to be done with its own startup
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(wlr_xwayland->wl_display);
+	wlr_xwayland->prestart_source = wl_event_loop_add_idle(loop,
+		xwayland_handle_prestart_idle, wlr_xwayland);
+	if (wlr_xwayland->prestart_source == NULL) {
+		wlr_log(L_ERROR, "Failed to schedule Xwayland prestart");
+	}
+}
+
 static bool xwayland_start_display(struct wlr_xwayland *wlr_xwayland,
 		struct wl_display *wl_display) {
 
@@ -316,6 +397,7 @@ static bool xwayland_start_server(struct wlr_xwayland *wlr_xwayland) {
 		return false;
 	}
 	wlr_xwayland->server_start = time(NULL);
+	wlr_xwayland->start_nsec = get_current_time_nsec();
 
 	if (!(wlr_xwayland->client = wl_client_create(wlr_xwayland->wl_display, wlr_xwayland->wl_fd[0]))) {
 		wlr_log_errno(L_ERROR, "wl_client_create failed");
@@ -386,9 +468,17 @@ static bool xwayland_start_server_lazy(struct wlr_xwayland *wlr_xwayland) {
 		wl_event_loop_add_fd(loop, wlr_xwayland->x_fd[1], WL_EVENT_READABLE,
 				xwayland_socket_connected, wlr_xwayland);
 
+	xwayland_schedule_prestart(wlr_xwayland);
+
 	return true;
 }
 
+void wlr_xwayland_prestart(struct wlr_xwayland *wlr_xwayland, uint32_t delay) {
+	wlr_xwayland->prestart = true;
+	wlr_xwayland->prestart_delay = delay;
+	xwayland_schedule_prestart(wlr_xwayland);
+}
+
 void wlr_xwayland_destroy(struct wlr_xwayland *wlr_xwayland) {
 	wlr_xwayland_set_seat(wlr_xwayland, NULL);
 	xwayland_finish_server(wlr_xwayland);
@@ -438,6 +528,15 @@ error_alloc:
 	return NULL;
 }
 
+void wlr_xwayland_get_event_stats(struct wlr_xwayland *wlr_xwayland,
+		struct wlr_xwayland_event_stats *stats) {
+	if (wlr_xwayland->xwm != NULL) {
+		*stats = wlr_xwayland->xwm->event_stats;
+	} else {
+		memset(stats, 0, sizeof(*stats));
+	}
+}
+
 void wlr_xwayland_set_cursor(struct wlr_xwayland *wlr_xwayland,
 		uint8_t *pixels, uint32_t stride, uint32_t width, uint32_t height,
 		int32_t hotspot_x, int32_t hotspot_y) {
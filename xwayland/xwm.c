@@ -2,7 +2,9 @@
 #define _POSIX_C_SOURCE 200809L
 #endif
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <wlr/config.h>
 #include <wlr/types/wlr_surface.h>
@@ -92,16 +94,27 @@ struct wlr_xwayland_surface *wlr_xwayland_surface_from_wlr_surface(
 	return (struct wlr_xwayland_surface *)surface->role_data;
 }
 
-// TODO: replace this with hash table?
 static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
 		xcb_window_t window_id) {
-	struct wlr_xwayland_surface *surface;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
-		if (surface->window_id == window_id) {
-			return surface;
-		}
+	return hash_table_get(&xwm->surfaces_by_window, window_id);
+}
+
+/**
+ * Records that the window waits for the wl_surface with the given ID to be
+ * created, or stops waiting if `surface_id` is zero.
+ */
+static void xsurface_set_unpaired(struct wlr_xwayland_surface *xsurface,
+		uint32_t surface_id) {
+	struct hash_table *unpaired = &xsurface->xwm->unpaired_surfaces;
+	if (xsurface->surface_id &&
+			hash_table_get(unpaired, xsurface->surface_id) == xsurface) {
+		hash_table_remove(unpaired, xsurface->surface_id);
+	}
+	xsurface->surface_id = 0;
+
+	if (surface_id && hash_table_set(unpaired, surface_id, xsurface)) {
+		xsurface->surface_id = surface_id;
 	}
-	return NULL;
 }
 
 static int xwayland_surface_handle_ping_timeout(void *data) {
@@ -112,6 +125,39 @@ static int xwayland_surface_handle_ping_timeout(void *data) {
 	return 1;
 }
 
+static void xsurface_map(struct wlr_xwayland_surface *xsurface) {
+	xsurface->map_pending = false;
+	xsurface->mapped = true;
+	wlr_signal_emit_safe(&xsurface->events.map, xsurface);
+}
+
+/**
+ * Called after a reply for the window has been handled. Maps its surface if
+ * it was waiting for the last of them.
+ */
+static void xsurface_handle_reply_done(struct wlr_xwm *xwm,
+		xcb_window_t window_id) {
+	struct wlr_xwayland_surface *xsurface = lookup_surface(xwm, window_id);
+	if (xsurface == NULL || !xsurface->map_pending ||
+			xwm_has_pending_replies(xwm, window_id)) {
+		return;
+	}
+	xsurface_map(xsurface);
+}
+
+static void handle_surface_geometry_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	xcb_get_geometry_reply_t *geometry_reply = reply;
+	xcb_window_t window_id = (uintptr_t)data;
+	struct wlr_xwayland_surface *surface = lookup_surface(xwm, window_id);
+	if (geometry_reply != NULL && surface != NULL) {
+		surface->has_alpha = geometry_reply->depth == 32;
+	}
+	free(geometry_reply);
+	free(error);
+	xsurface_handle_reply_done(xwm, window_id);
+}
+
 static struct wlr_xwayland_surface *xwayland_surface_create(
 		struct wlr_xwm *xwm, xcb_window_t window_id, int16_t x, int16_t y,
 		uint16_t width, uint16_t height, bool override_redirect) {
@@ -121,9 +167,10 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 		wlr_log(L_ERROR, "Could not allocate wlr xwayland surface");
 		return NULL;
 	}
-
-	xcb_get_geometry_cookie_t geometry_cookie =
-		xcb_get_geometry(xwm->xcb_conn, window_id);
+	if (!hash_table_set(&xwm->surfaces_by_window, window_id, surface)) {
+		free(surface);
+		return NULL;
+	}
 
 	uint32_t values[1];
 	values[0] =
@@ -140,6 +187,9 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	surface->height = height;
 	surface->override_redirect = override_redirect;
 	wl_list_insert(&xwm->surfaces, &surface->link);
+	// New windows are created on top of their siblings
+	wl_list_insert(xwm->stack.prev, &surface->stack_link);
+	wl_list_init(&surface->configure_link);
 	wl_list_init(&surface->children);
 	wl_list_init(&surface->parent_link);
 	wl_signal_init(&surface->events.destroy);
@@ -157,28 +207,117 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	wl_signal_init(&surface->events.set_window_type);
 	wl_signal_init(&surface->events.ping_timeout);
 
-	xcb_get_geometry_reply_t *geometry_reply =
-		xcb_get_geometry_reply(xwm->xcb_conn, geometry_cookie, NULL);
-	if (geometry_reply != NULL) {
-		surface->has_alpha = geometry_reply->depth == 32;
-	}
-	free(geometry_reply);
-
 	struct wl_display *display = xwm->xwayland->wl_display;
 	struct wl_event_loop *loop = wl_display_get_event_loop(display);
 	surface->ping_timer = wl_event_loop_add_timer(loop,
 		xwayland_surface_handle_ping_timeout, surface);
 	if (surface->ping_timer == NULL) {
+		hash_table_remove(&xwm->surfaces_by_window, window_id);
+		wl_list_remove(&surface->link);
+		wl_list_remove(&surface->stack_link);
 		free(surface);
 		wlr_log(L_ERROR, "Could not add timer to event loop");
 		return NULL;
 	}
 
+	xcb_get_geometry_cookie_t geometry_cookie =
+		xcb_get_geometry(xwm->xcb_conn, window_id);
+	xwm_queue_reply(xwm, geometry_cookie.sequence, window_id,
+		handle_surface_geometry_reply, (void *)(uintptr_t)window_id);
+
 	wlr_signal_emit_safe(&xwm->xwayland->events.new_surface, surface);
 
 	return surface;
 }
 
+static void xsurface_send_configure(struct wlr_xwayland_surface *xsurface) {
+	struct wlr_xwm *xwm = xsurface->xwm;
+	uint32_t mask = xsurface->pending_configure;
+	if (mask == 0) {
+		return;
+	}
+
+	// Values are in the order of the mask bits
+	uint32_t values[6];
+	size_t i = 0;
+	if (mask & XCB_CONFIG_WINDOW_X) {
+		values[i++] = xsurface->x;
+	}
+	if (mask & XCB_CONFIG_WINDOW_Y) {
+		values[i++] = xsurface->y;
+	}
+	if (mask & XCB_CONFIG_WINDOW_WIDTH) {
+		values[i++] = xsurface->width;
+	}
+	if (mask & XCB_CONFIG_WINDOW_HEIGHT) {
+		values[i++] = xsurface->height;
+	}
+	if (mask & XCB_CONFIG_WINDOW_BORDER_WIDTH) {
+		values[i++] = 0;
+	}
+	if (mask & XCB_CONFIG_WINDOW_STACK_MODE) {
+		values[i++] = XCB_STACK_MODE_ABOVE;
+	}
+	xcb_configure_window(xwm->xcb_conn, xsurface->window_id, mask, values);
+
+	xsurface->pending_configure = 0;
+	wl_list_remove(&xsurface->configure_link);
+	wl_list_init(&xsurface->configure_link);
+}
+
+static void xwm_send_configures(struct wlr_xwm *xwm) {
+	while (!wl_list_empty(&xwm->pending_configures)) {
+		struct wlr_xwayland_surface *xsurface = wl_container_of(
+			xwm->pending_configures.next, xsurface, configure_link);
+		xsurface_send_configure(xsurface);
+	}
+	xcb_flush(xwm->xcb_conn);
+}
+
+static void handle_configure_idle(void *data) {
+	struct wlr_xwm *xwm = data;
+	xwm->configure_idle = NULL;
+	xwm_send_configures(xwm);
+}
+
+/**
+ * Configure requests are sent once per event loop iteration, so that
+ * interactive moves and resizes don't send one request per pointer event. The
+ * last geometry set wins.
+ */
+static void xsurface_queue_configure(struct wlr_xwayland_surface *xsurface,
+		uint32_t mask) {
+	struct wlr_xwm *xwm = xsurface->xwm;
+	if (xsurface->pending_configure == 0) {
+		wl_list_insert(xwm->pending_configures.prev,
+			&xsurface->configure_link);
+	}
+	xsurface->pending_configure |= mask;
+
+	if (xwm->configure_idle != NULL) {
+		return;
+	}
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(xwm->xwayland->wl_display);
+	xwm->configure_idle =
+		wl_event_loop_add_idle(loop, handle_configure_idle, xwm);
+	if (xwm->configure_idle == NULL) {
+		wlr_log(L_ERROR, "Could not add idle source to event loop");
+		xwm_send_configures(xwm);
+	}
+}
+
+static void xsurface_raise(struct wlr_xwayland_surface *xsurface) {
+	struct wlr_xwm *xwm = xsurface->xwm;
+	if (xwm->stack.prev == &xsurface->stack_link) {
+		return;
+	}
+
+	wl_list_remove(&xsurface->stack_link);
+	wl_list_insert(xwm->stack.prev, &xsurface->stack_link);
+	xsurface_queue_configure(xsurface, XCB_CONFIG_WINDOW_STACK_MODE);
+}
+
 static void xwm_set_net_active_window(struct wlr_xwm *xwm,
 		xcb_window_t window) {
 	xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_REPLACE,
@@ -235,10 +374,7 @@ static void xwm_send_focus_window(struct wlr_xwm *xwm,
 			xsurface->window_id, XCB_CURRENT_TIME);
 	}
 
-	uint32_t values[1];
-	values[0] = XCB_STACK_MODE_ABOVE;
-	xcb_configure_window(xwm->xcb_conn, xsurface->window_id,
-		XCB_CONFIG_WINDOW_STACK_MODE, values);
+	xsurface_raise(xsurface);
 }
 
 
@@ -299,7 +435,14 @@ static void xwayland_surface_destroy(
 		xwm_surface_activate(xsurface->xwm, NULL);
 	}
 
+	if (lookup_surface(xsurface->xwm, xsurface->window_id) == xsurface) {
+		hash_table_remove(&xsurface->xwm->surfaces_by_window,
+			xsurface->window_id);
+		xwm_discard_replies(xsurface->xwm, xsurface->window_id);
+	}
 	wl_list_remove(&xsurface->link);
+	wl_list_remove(&xsurface->stack_link);
+	wl_list_remove(&xsurface->configure_link);
 	wl_list_remove(&xsurface->parent_link);
 
 	struct wlr_xwayland_surface *child, *next;
@@ -308,9 +451,7 @@ static void xwayland_surface_destroy(
 		wl_list_init(&child->parent_link);
 	}
 
-	if (xsurface->surface_id) {
-		wl_list_remove(&xsurface->unpaired_link);
-	}
+	xsurface_set_unpaired(xsurface, 0);
 
 	if (xsurface->surface) {
 		wl_list_remove(&xsurface->surface_destroy.link);
@@ -584,31 +725,38 @@ static void read_surface_net_wm_state(struct wlr_xwm *xwm,
 	}
 }
 
-char *xwm_get_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom) {
-	xcb_get_atom_name_cookie_t name_cookie =
-		xcb_get_atom_name(xwm->xcb_conn, atom);
-	xcb_get_atom_name_reply_t *name_reply =
-		xcb_get_atom_name_reply(xwm->xcb_conn, name_cookie, NULL);
-	if (name_reply == NULL) {
-		return NULL;
+static void handle_atom_name_log_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	char *message = data;
+	xcb_get_atom_name_reply_t *name_reply = reply;
+	if (name_reply != NULL) {
+		wlr_log(L_DEBUG, "%s (%.*s)", message,
+			xcb_get_atom_name_name_length(name_reply),
+			xcb_get_atom_name_name(name_reply));
+	} else {
+		wlr_log(L_DEBUG, "%s", message);
 	}
-	size_t len = xcb_get_atom_name_name_length(name_reply);
-	char *buf = xcb_get_atom_name_name(name_reply); // not a C string
-	char *name = strndup(buf, len);
 	free(name_reply);
-	return name;
+	free(error);
+	free(message);
 }
 
-static void read_surface_property(struct wlr_xwm *xwm,
-		struct wlr_xwayland_surface *xsurface, xcb_atom_t property) {
-	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn, 0,
-		xsurface->window_id, property, XCB_ATOM_ANY, 0, 2048);
-	xcb_get_property_reply_t *reply = xcb_get_property_reply(xwm->xcb_conn,
-		cookie, NULL);
-	if (reply == NULL) {
+void xwm_log_atom_name(struct wlr_xwm *xwm, const char *message,
+		xcb_atom_t atom) {
+	char *message_copy = strdup(message);
+	if (message_copy == NULL) {
+		wlr_log(L_DEBUG, "%s", message);
 		return;
 	}
+	xcb_get_atom_name_cookie_t name_cookie =
+		xcb_get_atom_name(xwm->xcb_conn, atom);
+	xwm_queue_reply(xwm, name_cookie.sequence, XCB_WINDOW_NONE,
+		handle_atom_name_log_reply, message_copy);
+}
 
+static void handle_surface_property_reply(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface, xcb_atom_t property,
+		xcb_get_property_reply_t *reply) {
 	if (property == XCB_ATOM_WM_CLASS) {
 		read_surface_class(xwm, xsurface, reply);
 	} else if (property == XCB_ATOM_WM_NAME ||
@@ -631,22 +779,69 @@ static void read_surface_property(struct wlr_xwm *xwm,
 	} else if (property == xwm->atoms[MOTIF_WM_HINTS]) {
 		read_surface_motif_hints(xwm, xsurface, reply);
 	} else {
-		char *prop_name = xwm_get_atom_name(xwm, property);
-		wlr_log(L_DEBUG, "unhandled X11 property %u (%s) for window %u",
-			property, prop_name, xsurface->window_id);
-		free(prop_name);
+		char message[64];
+		snprintf(message, sizeof(message),
+			"unhandled X11 property %u for window %u", property,
+			xsurface->window_id);
+		xwm_log_atom_name(xwm, message, property);
 	}
+}
+
+struct xwm_property_request {
+	xcb_window_t window;
+	xcb_atom_t atom;
+};
 
+static void handle_property_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	struct xwm_property_request *req = data;
+	xcb_window_t window_id = req->window;
+	// The window may have been destroyed meanwhile, in which case the
+	// request fails with BadWindow
+	struct wlr_xwayland_surface *xsurface = lookup_surface(xwm, window_id);
+	if (reply != NULL && xsurface != NULL) {
+		handle_surface_property_reply(xwm, xsurface, req->atom, reply);
+	}
 	free(reply);
+	free(error);
+	free(req);
+	xsurface_handle_reply_done(xwm, window_id);
+}
+
+/**
+ * Sends a GetProperty request without waiting for the reply, which is handled
+ * later from the event loop. Requests are only sent to the server on the next
+ * flush, so that all the properties of a window go out together.
+ */
+static void xwm_request_property(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface, xcb_atom_t property) {
+	struct xwm_property_request *req =
+		calloc(1, sizeof(struct xwm_property_request));
+	if (req == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return;
+	}
+	req->window = xsurface->window_id;
+	req->atom = property;
+	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn, 0,
+		xsurface->window_id, property, XCB_ATOM_ANY, 0, 2048);
+	xwm_queue_reply(xwm, cookie.sequence, xsurface->window_id,
+		handle_property_reply, req);
 }
 
 static void handle_surface_commit(struct wlr_surface *wlr_surface,
 		void *role_data) {
 	struct wlr_xwayland_surface *surface = role_data;
 
-	if (!surface->mapped && wlr_surface_has_buffer(surface->surface)) {
-		wlr_signal_emit_safe(&surface->events.map, surface);
-		surface->mapped = true;
+	if (!surface->mapped && !surface->map_pending &&
+			wlr_surface_has_buffer(surface->surface)) {
+		// Compositors expect the window properties to be known when it's
+		// mapped, wait for the replies still pending if any
+		if (xwm_has_pending_replies(surface->xwm, surface->window_id)) {
+			surface->map_pending = true;
+		} else {
+			xsurface_map(surface);
+		}
 	}
 }
 
@@ -660,7 +855,8 @@ static void xwm_map_shell_surface(struct wlr_xwm *xwm,
 		struct wlr_xwayland_surface *xsurface, struct wlr_surface *surface) {
 	xsurface->surface = surface;
 
-	// read all surface properties
+	// request all surface properties at once, replies are handled
+	// asynchronously
 	const xcb_atom_t props[] = {
 		XCB_ATOM_WM_CLASS,
 		XCB_ATOM_WM_NAME,
@@ -675,7 +871,7 @@ static void xwm_map_shell_surface(struct wlr_xwm *xwm,
 		xwm->atoms[NET_WM_PID],
 	};
 	for (size_t i = 0; i < sizeof(props)/sizeof(xcb_atom_t); i++) {
-		read_surface_property(xwm, xsurface, props[i]);
+		xwm_request_property(xwm, xsurface, props[i]);
 	}
 
 	wlr_surface_set_role(xsurface->surface, wlr_xwayland_surface_role, NULL, 0);
@@ -687,18 +883,16 @@ static void xwm_map_shell_surface(struct wlr_xwm *xwm,
 }
 
 static void xsurface_unmap(struct wlr_xwayland_surface *surface) {
+	surface->map_pending = false;
 	if (surface->mapped) {
 		surface->mapped = false;
 		wlr_signal_emit_safe(&surface->events.unmap, surface);
 	}
 
-	if (surface->surface_id) {
-		// Make sure we're not on the unpaired surface list or we
-		// could be assigned a surface during surface creation that
-		// was mapped before this unmap request.
-		wl_list_remove(&surface->unpaired_link);
-		surface->surface_id = 0;
-	}
+	// Make sure we're not waiting for a surface anymore or we could be
+	// assigned a surface during surface creation that was mapped before
+	// this unmap request.
+	xsurface_set_unpaired(surface, 0);
 
 	if (surface->surface) {
 		wlr_surface_set_role_committed(surface->surface, NULL, NULL);
@@ -762,10 +956,28 @@ static void xwm_handle_configure_notify(struct wlr_xwm *xwm,
 		return;
 	}
 
-	xsurface->x = ev->x;
-	xsurface->y = ev->y;
-	xsurface->width = ev->width;
-	xsurface->height = ev->height;
+	// Our pending requests are more recent than this event
+	uint32_t geometry_mask = XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+		XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT;
+	if (!(xsurface->pending_configure & geometry_mask)) {
+		xsurface->x = ev->x;
+		xsurface->y = ev->y;
+		xsurface->width = ev->width;
+		xsurface->height = ev->height;
+	}
+
+	if (!(xsurface->pending_configure & XCB_CONFIG_WINDOW_STACK_MODE)) {
+		wl_list_remove(&xsurface->stack_link);
+		struct wlr_xwayland_surface *sibling =
+			lookup_surface(xwm, ev->above_sibling);
+		if (sibling != NULL && sibling != xsurface) {
+			wl_list_insert(&sibling->stack_link, &xsurface->stack_link);
+		} else {
+			// Either at the bottom or above one of the XWM's own windows, which
+			// are created before any client window and never raised
+			wl_list_insert(&xwm->stack, &xsurface->stack_link);
+		}
+	}
 }
 
 #define ICCCM_WITHDRAWN_STATE	0
@@ -799,6 +1011,8 @@ static void xwm_handle_map_request(struct wlr_xwm *xwm,
 
 	xsurface_set_wm_state(xsurface, ICCCM_NORMAL_STATE);
 	xsurface_set_net_wm_state(xsurface);
+	// Map the window with the geometry set by the compositor, if any
+	xsurface_send_configure(xsurface);
 	xcb_map_window(xwm->xcb_conn, ev->window);
 }
 
@@ -827,7 +1041,23 @@ static void xwm_handle_property_notify(struct wlr_xwm *xwm,
 		return;
 	}
 
-	read_surface_property(xwm, xsurface, ev->atom);
+	// A pending request sent after the change was processed by the server
+	// will already return the new value. This coalesces bursts of updates
+	// to the same property into a single round-trip.
+	uint32_t event_sequence = ((xcb_generic_event_t *)ev)->full_sequence;
+	struct xwm_pending_reply *pending;
+	wl_list_for_each_reverse(pending, &xwm->pending_replies, link) {
+		struct xwm_property_request *req = pending->data;
+		if (pending->handler == handle_property_reply &&
+				req->window == ev->window && req->atom == ev->atom) {
+			if ((int32_t)(pending->sequence - event_sequence) > 0) {
+				return;
+			}
+			break;
+		}
+	}
+
+	xwm_request_property(xwm, xsurface, ev->atom);
 }
 
 static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
@@ -845,11 +1075,10 @@ static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
 		wl_client_get_object(xwm->xwayland->client, id);
 	if (resource) {
 		struct wlr_surface *surface = wlr_surface_from_resource(resource);
-		xsurface->surface_id = 0;
+		xsurface_set_unpaired(xsurface, 0);
 		xwm_map_shell_surface(xwm, xsurface, surface);
 	} else {
-		xsurface->surface_id = id;
-		wl_list_insert(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
+		xsurface_set_unpaired(xsurface, id);
 	}
 }
 
@@ -1039,10 +1268,10 @@ static void xwm_handle_wm_protocols_message(struct wlr_xwm *xwm,
 		wl_event_source_timer_update(surface->ping_timer, 0);
 		surface->pinging = false;
 	} else {
-		char *type_name = xwm_get_atom_name(xwm, type);
-		wlr_log(L_DEBUG, "unhandled WM_PROTOCOLS client message %u (%s)",
-			type, type_name);
-		free(type_name);
+		char message[64];
+		snprintf(message, sizeof(message),
+			"unhandled WM_PROTOCOLS client message %u", type);
+		xwm_log_atom_name(xwm, message, type);
 	}
 }
 
@@ -1059,10 +1288,10 @@ static void xwm_handle_client_message(struct wlr_xwm *xwm,
 	} else if (ev->type == xwm->atoms[WM_PROTOCOLS]) {
 		xwm_handle_wm_protocols_message(xwm, ev);
 	} else if (!xwm_handle_selection_client_message(xwm, ev)) {
-		char *type_name = xwm_get_atom_name(xwm, ev->type);
-		wlr_log(L_DEBUG, "unhandled x11 client message %u (%s)", ev->type,
-			type_name);
-		free(type_name);
+		char message[64];
+		snprintf(message, sizeof(message), "unhandled x11 client message %u",
+			ev->type);
+		xwm_log_atom_name(xwm, message, ev->type);
 	}
 }
 
@@ -1137,73 +1366,173 @@ static void xwm_handle_unhandled_event(struct wlr_xwm *xwm, xcb_generic_event_t
 #endif
 }
 
-static int x11_event_handler(int fd, uint32_t mask, void *data) {
-	int count = 0;
-	xcb_generic_event_t *event;
-	struct wlr_xwm *xwm = data;
+static void xwm_handle_event(struct wlr_xwm *xwm, xcb_generic_event_t *event) {
+	if (xwm->xwayland->user_event_handler &&
+			xwm->xwayland->user_event_handler(xwm, event)) {
+		free(event);
+		return;
+	}
 
-	while ((event = xcb_poll_for_event(xwm->xcb_conn))) {
-		count++;
+	if (xwm_handle_selection_event(xwm, event)) {
+		free(event);
+		return;
+	}
+
+	switch (event->response_type & XCB_EVENT_RESPONSE_TYPE_MASK) {
+	case XCB_CREATE_NOTIFY:
+		xwm_handle_create_notify(xwm, (xcb_create_notify_event_t *)event);
+		break;
+	case XCB_DESTROY_NOTIFY:
+		xwm_handle_destroy_notify(xwm, (xcb_destroy_notify_event_t *)event);
+		break;
+	case XCB_CONFIGURE_REQUEST:
+		xwm_handle_configure_request(xwm,
+			(xcb_configure_request_event_t *)event);
+		break;
+	case XCB_CONFIGURE_NOTIFY:
+		xwm_handle_configure_notify(xwm,
+			(xcb_configure_notify_event_t *)event);
+		break;
+	case XCB_MAP_REQUEST:
+		xwm_handle_map_request(xwm, (xcb_map_request_event_t *)event);
+		break;
+	case XCB_MAP_NOTIFY:
+		xwm_handle_map_notify(xwm, (xcb_map_notify_event_t *)event);
+		break;
+	case XCB_UNMAP_NOTIFY:
+		xwm_handle_unmap_notify(xwm, (xcb_unmap_notify_event_t *)event);
+		break;
+	case XCB_PROPERTY_NOTIFY:
+		xwm_handle_property_notify(xwm,
+			(xcb_property_notify_event_t *)event);
+		break;
+	case XCB_CLIENT_MESSAGE:
+		xwm_handle_client_message(xwm, (xcb_client_message_event_t *)event);
+		break;
+	case XCB_FOCUS_IN:
+		xwm_handle_focus_in(xwm, (xcb_focus_in_event_t *)event);
+		break;
+	case 0:
+		xwm_handle_xcb_error(xwm, (xcb_value_error_t *)event);
+		break;
+	default:
+		xwm_handle_unhandled_event(xwm, event);
+		break;
+	}
+	free(event);
+}
+
+/**
+ * Returns true if handling `next` makes handling `event` useless: both are
+ * ConfigureNotify events for the same window, or PropertyNotify events with
+ * the same window, atom and state.
+ */
+static bool xwm_event_is_superseded(xcb_generic_event_t *event,
+		xcb_generic_event_t *next) {
+	uint8_t type = event->response_type & XCB_EVENT_RESPONSE_TYPE_MASK;
+	if (type != (next->response_type & XCB_EVENT_RESPONSE_TYPE_MASK)) {
+		return false;
+	}
+
+	if (type == XCB_CONFIGURE_NOTIFY) {
+		xcb_configure_notify_event_t *a =
+			(xcb_configure_notify_event_t *)event;
+		xcb_configure_notify_event_t *b =
+			(xcb_configure_notify_event_t *)next;
+		return a->window == b->window;
+	} else if (type == XCB_PROPERTY_NOTIFY) {
+		xcb_property_notify_event_t *a = (xcb_property_notify_event_t *)event;
+		xcb_property_notify_event_t *b = (xcb_property_notify_event_t *)next;
+		return a->window == b->window && a->atom == b->atom &&
+			a->state == b->state;
+	}
+	return false;
+}
 
-		if (xwm->xwayland->user_event_handler &&
-				xwm->xwayland->user_event_handler(xwm, event)) {
+/**
+ * Handles at most `max` events, skipping those superseded by the next one.
+ * With `queued`, only the events already read from the socket are handled.
+ */
+static size_t xwm_handle_events(struct wlr_xwm *xwm, size_t max,
+		bool queued) {
+	xcb_generic_event_t *events[XWM_EVENT_BATCH_SIZE];
+	size_t len = 0;
+	while (len < max) {
+		events[len] = queued ? xcb_poll_for_queued_event(xwm->xcb_conn) :
+			xcb_poll_for_event(xwm->xcb_conn);
+		if (events[len] == NULL) {
 			break;
 		}
+		len++;
+	}
 
-		if (xwm_handle_selection_event(xwm, event)) {
-			free(event);
+	for (size_t i = 0; i < len; ++i) {
+		if (i + 1 < len && xwm_event_is_superseded(events[i], events[i + 1])) {
+			free(events[i]);
+			xwm->event_stats.coalesced++;
 			continue;
 		}
+		xwm_handle_event(xwm, events[i]);
+	}
+	return len;
+}
 
-		switch (event->response_type & XCB_EVENT_RESPONSE_TYPE_MASK) {
-		case XCB_CREATE_NOTIFY:
-			xwm_handle_create_notify(xwm, (xcb_create_notify_event_t *)event);
-			break;
-		case XCB_DESTROY_NOTIFY:
-			xwm_handle_destroy_notify(xwm, (xcb_destroy_notify_event_t *)event);
-			break;
-		case XCB_CONFIGURE_REQUEST:
-			xwm_handle_configure_request(xwm,
-				(xcb_configure_request_event_t *)event);
-			break;
-		case XCB_CONFIGURE_NOTIFY:
-			xwm_handle_configure_notify(xwm,
-				(xcb_configure_notify_event_t *)event);
-			break;
-		case XCB_MAP_REQUEST:
-			xwm_handle_map_request(xwm, (xcb_map_request_event_t *)event);
-			break;
-		case XCB_MAP_NOTIFY:
-			xwm_handle_map_notify(xwm, (xcb_map_notify_event_t *)event);
-			break;
-		case XCB_UNMAP_NOTIFY:
-			xwm_handle_unmap_notify(xwm, (xcb_unmap_notify_event_t *)event);
-			break;
-		case XCB_PROPERTY_NOTIFY:
-			xwm_handle_property_notify(xwm,
-				(xcb_property_notify_event_t *)event);
-			break;
-		case XCB_CLIENT_MESSAGE:
-			xwm_handle_client_message(xwm, (xcb_client_message_event_t *)event);
-			break;
-		case XCB_FOCUS_IN:
-			xwm_handle_focus_in(xwm, (xcb_focus_in_event_t *)event);
-			break;
-		case 0:
-			xwm_handle_xcb_error(xwm, (xcb_value_error_t *)event);
+/**
+ * Handles at most XWM_EVENT_BATCH_SIZE events per event loop dispatch. If
+ * there are more, the rest of the event loop runs before the next batch, so
+ * that a flood of X11 events doesn't hold up Wayland clients.
+ */
+static int x11_event_handler(int fd, uint32_t mask, void *data) {
+	struct wlr_xwm *xwm = data;
+
+	size_t len = xwm_handle_events(xwm, XWM_EVENT_BATCH_SIZE, false);
+	int count = len;
+
+	// Reading replies reads the socket, which may queue events in xcb
+	// without leaving the socket readable: handle them too
+	while (true) {
+		int replies = xwm_dispatch_replies(xwm);
+		count += replies;
+		if (len == XWM_EVENT_BATCH_SIZE) {
 			break;
-		default:
-			xwm_handle_unhandled_event(xwm, event);
+		}
+		size_t queued =
+			xwm_handle_events(xwm, XWM_EVENT_BATCH_SIZE - len, true);
+		len += queued;
+		count += queued;
+		if (replies == 0 && queued == 0) {
 			break;
 		}
-		free(event);
+	}
+
+	if (len > 0) {
+		xwm->event_stats.batches++;
+		xwm->event_stats.events += len;
+		if (len > xwm->event_stats.max_batch) {
+			xwm->event_stats.max_batch = len;
+		}
 	}
 
 	if (count) {
 		xcb_flush(xwm->xcb_conn);
 	}
 
-	return count;
+	if (len == XWM_EVENT_BATCH_SIZE && xwm->event_batch_timer != NULL) {
+		// More events or replies may be queued in xcb, the socket won't wake
+		// us up
+		xwm->event_stats.deferred++;
+		wl_event_source_timer_update(xwm->event_batch_timer, 1);
+	}
+
+	// Returning non-zero would make the event loop call us again right away,
+	// before dispatching anything else
+	return 0;
+}
+
+static int handle_event_batch_timer(void *data) {
+	struct wlr_xwm *xwm = data;
+	x11_event_handler(-1, 0, xwm);
+	return 0;
 }
 
 static void handle_compositor_new_surface(struct wl_listener *listener,
@@ -1218,15 +1547,12 @@ static void handle_compositor_new_surface(struct wl_listener *listener,
 	wlr_log(L_DEBUG, "New xwayland surface: %p", surface);
 
 	uint32_t surface_id = wl_resource_get_id(surface->resource);
-	struct wlr_xwayland_surface *xsurface;
-	wl_list_for_each(xsurface, &xwm->unpaired_surfaces, unpaired_link) {
-		if (xsurface->surface_id == surface_id) {
-			xwm_map_shell_surface(xwm, xsurface, surface);
-			xsurface->surface_id = 0;
-			wl_list_remove(&xsurface->unpaired_link);
-			xcb_flush(xwm->xcb_conn);
-			return;
-		}
+	struct wlr_xwayland_surface *xsurface =
+		hash_table_get(&xwm->unpaired_surfaces, surface_id);
+	if (xsurface != NULL) {
+		xsurface_set_unpaired(xsurface, 0);
+		xwm_map_shell_surface(xwm, xsurface, surface);
+		xcb_flush(xwm->xcb_conn);
 	}
 }
 
@@ -1257,13 +1583,9 @@ void wlr_xwayland_surface_configure(struct wlr_xwayland_surface *xsurface,
 	xsurface->width = width;
 	xsurface->height = height;
 
-	struct wlr_xwm *xwm = xsurface->xwm;
-	uint32_t mask = XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
-		XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT |
-		XCB_CONFIG_WINDOW_BORDER_WIDTH;
-	uint32_t values[] = {x, y, width, height, 0};
-	xcb_configure_window(xwm->xcb_conn, xsurface->window_id, mask, values);
-	xcb_flush(xwm->xcb_conn);
+	xsurface_queue_configure(xsurface, XCB_CONFIG_WINDOW_X |
+		XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH |
+		XCB_CONFIG_WINDOW_HEIGHT | XCB_CONFIG_WINDOW_BORDER_WIDTH);
 }
 
 void wlr_xwayland_surface_close(struct wlr_xwayland_surface *xsurface) {
@@ -1288,13 +1610,36 @@ void wlr_xwayland_surface_close(struct wlr_xwayland_surface *xsurface) {
 	}
 }
 
+#define XWM_CURSOR_CACHE_SIZE 16
+
+struct xwm_cursor {
+	uint64_t hash;
+	uint8_t *pixels;
+	uint32_t stride, width, height;
+	int32_t hotspot_x, hotspot_y;
+	xcb_cursor_t cursor;
+	struct wl_list link; // wlr_xwm::cursors
+};
+
+static void xwm_cursor_destroy(struct wlr_xwm *xwm,
+		struct xwm_cursor *cursor) {
+	// The X server keeps the cursor while it's in use
+	xcb_free_cursor(xwm->xcb_conn, cursor->cursor);
+	wl_list_remove(&cursor->link);
+	xwm->cursors_len--;
+	free(cursor->pixels);
+	free(cursor);
+}
+
 void xwm_destroy(struct wlr_xwm *xwm) {
 	if (!xwm) {
 		return;
 	}
+	xwm_discard_replies(xwm, XCB_WINDOW_NONE);
 	xwm_selection_finish(xwm);
-	if (xwm->cursor) {
-		xcb_free_cursor(xwm->xcb_conn, xwm->cursor);
+	struct xwm_cursor *cursor, *cursor_tmp;
+	wl_list_for_each_safe(cursor, cursor_tmp, &xwm->cursors, link) {
+		xwm_cursor_destroy(xwm, cursor);
 	}
 	if (xwm->colormap) {
 		xcb_free_colormap(xwm->xcb_conn, xwm->colormap);
@@ -1305,6 +1650,12 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 	if (xwm->event_source) {
 		wl_event_source_remove(xwm->event_source);
 	}
+	if (xwm->configure_idle) {
+		wl_event_source_remove(xwm->configure_idle);
+	}
+	if (xwm->event_batch_timer) {
+		wl_event_source_remove(xwm->event_batch_timer);
+	}
 #ifdef WLR_HAS_XCB_ERRORS
 	if (xwm->errors_context) {
 		xcb_errors_context_free(xwm->errors_context);
@@ -1314,19 +1665,32 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 	wl_list_for_each_safe(xsurface, tmp, &xwm->surfaces, link) {
 		xwayland_surface_destroy(xsurface);
 	}
-	wl_list_for_each_safe(xsurface, tmp, &xwm->unpaired_surfaces, link) {
-		xwayland_surface_destroy(xsurface);
-	}
 	wl_list_remove(&xwm->compositor_new_surface.link);
 	wl_list_remove(&xwm->compositor_destroy.link);
 	xcb_disconnect(xwm->xcb_conn);
 
+	hash_table_finish(&xwm->surfaces_by_window);
+	hash_table_finish(&xwm->unpaired_surfaces);
 	free(xwm);
 }
 
+static void handle_xfixes_version_reply(struct wlr_xwm *xwm, void *reply,
+		xcb_generic_error_t *error, void *data) {
+	xcb_xfixes_query_version_reply_t *xfixes_reply = reply;
+	if (xfixes_reply != NULL) {
+		wlr_log(L_DEBUG, "xfixes version: %d.%d",
+			xfixes_reply->major_version, xfixes_reply->minor_version);
+	} else {
+		wlr_log(L_DEBUG, "Failed to query xfixes version");
+	}
+	free(xfixes_reply);
+	free(error);
+}
+
 static void xwm_get_resources(struct wlr_xwm *xwm) {
 	xcb_prefetch_extension_data(xwm->xcb_conn, &xcb_xfixes_id);
 	xcb_prefetch_extension_data(xwm->xcb_conn, &xcb_composite_id);
+	xcb_prefetch_maximum_request_length(xwm->xcb_conn);
 
 	size_t i;
 	xcb_intern_atom_cookie_t cookies[ATOM_LAST];
@@ -1358,18 +1722,11 @@ static void xwm_get_resources(struct wlr_xwm *xwm) {
 		wlr_log(L_DEBUG, "xfixes not available");
 	}
 
-	xcb_xfixes_query_version_cookie_t xfixes_cookie;
-	xcb_xfixes_query_version_reply_t *xfixes_reply;
-	xfixes_cookie =
+	xcb_xfixes_query_version_cookie_t xfixes_cookie =
 		xcb_xfixes_query_version(xwm->xcb_conn, XCB_XFIXES_MAJOR_VERSION,
 			XCB_XFIXES_MINOR_VERSION);
-	xfixes_reply =
-		xcb_xfixes_query_version_reply(xwm->xcb_conn, xfixes_cookie, NULL);
-
-	wlr_log(L_DEBUG, "xfixes version: %d.%d",
-		xfixes_reply->major_version, xfixes_reply->minor_version);
-
-	free(xfixes_reply);
+	xwm_queue_reply(xwm, xfixes_cookie.sequence, XCB_WINDOW_NONE,
+		handle_xfixes_version_reply, NULL);
 }
 
 static void xwm_create_wm_window(struct wlr_xwm *xwm) {
@@ -1486,16 +1843,16 @@ static void xwm_get_render_format(struct wlr_xwm *xwm) {
 	free(reply);
 }
 
-void xwm_set_cursor(struct wlr_xwm *xwm, const uint8_t *pixels, uint32_t stride,
+static uint64_t hash_cursor(const uint8_t *pixels, size_t size,
 		uint32_t width, uint32_t height, int32_t hotspot_x, int32_t hotspot_y) {
-	if (!xwm->render_format_id) {
-		wlr_log(L_ERROR, "Cannot set xwm cursor: no render format available");
-		return;
-	}
-	if (xwm->cursor) {
-		xcb_free_cursor(xwm->xcb_conn, xwm->cursor);
-	}
+	uint32_t metadata[] = {width, height, hotspot_x, hotspot_y};
+	uint64_t hash = hash_bytes(HASH_BYTES_INIT, metadata, sizeof(metadata));
+	return hash_bytes(hash, pixels, size);
+}
 
+static xcb_cursor_t xwm_create_cursor(struct wlr_xwm *xwm,
+		const uint8_t *pixels, uint32_t stride, uint32_t width,
+		uint32_t height, int32_t hotspot_x, int32_t hotspot_y) {
 	int depth = 32;
 
 	xcb_pixmap_t pix = xcb_generate_id(xwm->xcb_conn);
@@ -1514,10 +1871,83 @@ void xwm_set_cursor(struct wlr_xwm *xwm, const uint8_t *pixels, uint32_t stride,
 		pixels);
 	xcb_free_gc(xwm->xcb_conn, gc);
 
-	xwm->cursor = xcb_generate_id(xwm->xcb_conn);
-	xcb_render_create_cursor(xwm->xcb_conn, xwm->cursor, pic, hotspot_x,
+	xcb_cursor_t cursor = xcb_generate_id(xwm->xcb_conn);
+	xcb_render_create_cursor(xwm->xcb_conn, cursor, pic, hotspot_x,
 		hotspot_y);
+	xcb_render_free_picture(xwm->xcb_conn, pic);
 	xcb_free_pixmap(xwm->xcb_conn, pix);
+	return cursor;
+}
+
+/**
+ * Looks up the X cursor for an image, creating it if needed. Cursors are kept
+ * for the lifetime of the XWM, up to XWM_CURSOR_CACHE_SIZE of them, so that
+ * switching between the usual cursor images doesn't upload them again.
+ */
+static struct xwm_cursor *xwm_get_cursor(struct wlr_xwm *xwm,
+		const uint8_t *pixels, uint32_t stride, uint32_t width,
+		uint32_t height, int32_t hotspot_x, int32_t hotspot_y) {
+	size_t size = (size_t)stride * height;
+	uint64_t hash =
+		hash_cursor(pixels, size, width, height, hotspot_x, hotspot_y);
+
+	struct xwm_cursor *cursor;
+	wl_list_for_each(cursor, &xwm->cursors, link) {
+		if (cursor->hash == hash && cursor->stride == stride &&
+				cursor->width == width && cursor->height == height &&
+				cursor->hotspot_x == hotspot_x &&
+				cursor->hotspot_y == hotspot_y &&
+				memcmp(cursor->pixels, pixels, size) == 0) {
+			wl_list_remove(&cursor->link);
+			wl_list_insert(&xwm->cursors, &cursor->link);
+			return cursor;
+		}
+	}
+
+	cursor = calloc(1, sizeof(struct xwm_cursor));
+	if (cursor == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return NULL;
+	}
+	cursor->pixels = malloc(size);
+	if (cursor->pixels == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		free(cursor);
+		return NULL;
+	}
+	memcpy(cursor->pixels, pixels, size);
+	cursor->hash = hash;
+	cursor->stride = stride;
+	cursor->width = width;
+	cursor->height = height;
+	cursor->hotspot_x = hotspot_x;
+	cursor->hotspot_y = hotspot_y;
+	cursor->cursor = xwm_create_cursor(xwm, pixels, stride, width, height,
+		hotspot_x, hotspot_y);
+	wl_list_insert(&xwm->cursors, &cursor->link);
+	xwm->cursors_len++;
+
+	while (xwm->cursors_len > XWM_CURSOR_CACHE_SIZE) {
+		struct xwm_cursor *lru =
+			wl_container_of(xwm->cursors.prev, lru, link);
+		xwm_cursor_destroy(xwm, lru);
+	}
+	return cursor;
+}
+
+void xwm_set_cursor(struct wlr_xwm *xwm, const uint8_t *pixels, uint32_t stride,
+		uint32_t width, uint32_t height, int32_t hotspot_x, int32_t hotspot_y) {
+	if (!xwm->render_format_id) {
+		wlr_log(L_ERROR, "Cannot set xwm cursor: no render format available");
+		return;
+	}
+
+	struct xwm_cursor *cursor = xwm_get_cursor(xwm, pixels, stride, width,
+		height, hotspot_x, hotspot_y);
+	if (cursor == NULL || cursor->cursor == xwm->cursor) {
+		return;
+	}
+	xwm->cursor = cursor->cursor;
 
 	uint32_t values[] = {xwm->cursor};
 	xcb_change_window_attributes(xwm->xcb_conn, xwm->screen->root,
@@ -1533,7 +1963,12 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *wlr_xwayland) {
 
 	xwm->xwayland = wlr_xwayland;
 	wl_list_init(&xwm->surfaces);
-	wl_list_init(&xwm->unpaired_surfaces);
+	hash_table_init(&xwm->surfaces_by_window);
+	hash_table_init(&xwm->unpaired_surfaces);
+	wl_list_init(&xwm->pending_replies);
+	wl_list_init(&xwm->stack);
+	wl_list_init(&xwm->pending_configures);
+	wl_list_init(&xwm->cursors);
 	xwm->ping_timeout = 10000;
 
 	xwm->xcb_conn = xcb_connect_to_fd(wlr_xwayland->wm_fd[0], NULL);
@@ -1566,6 +2001,8 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *wlr_xwayland) {
 			x11_event_handler,
 			xwm);
 	wl_event_source_check(xwm->event_source);
+	xwm->event_batch_timer = wl_event_loop_add_timer(event_loop,
+		handle_event_batch_timer, xwm);
 
 	xwm_get_resources(xwm);
 	xwm_get_visual_and_colormap(xwm);